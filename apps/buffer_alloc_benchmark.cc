@@ -0,0 +1,83 @@
+#include "tcp_receiver.hh"
+#include "tcp_sender.hh"
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+
+using namespace std;
+
+//! \name Global allocation counters (every operator new in the program goes through here)
+//!@{
+static size_t allocation_count = 0;
+static size_t allocation_bytes = 0;
+//!@}
+
+void *operator new(size_t size) {
+    allocation_count++;
+    allocation_bytes += size;
+    if (void *ptr = malloc(size)) {
+        return ptr;
+    }
+    throw bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept { free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { free(ptr); }
+
+//! Send segments from a TCPSender to a TCPReceiver through serialize and parse, `count` times in all
+static size_t send_segments(TCPSender &sender, TCPReceiver &receiver, const size_t count) {
+    static const string chunk(TCPConfig::MAX_PAYLOAD_SIZE, 'x');
+    size_t sent = 0;
+    while (sent < count) {
+        sender.stream_in().write(chunk);
+        sender.fill_window();
+
+        while (not sender.segments_out().empty()) {
+            const TCPSegment &seg = sender.segments_out().front();
+            string wire = seg.serialize_packet().concatenate();  // what a read() of the network would return
+            sender.segments_out().pop();
+
+            TCPSegment received;
+            if (received.parse(Buffer(move(wire))) != ParseResult::NoError) {
+                throw runtime_error("segment failed to parse");
+            }
+            receiver.segment_received(received);
+            receiver.stream_out().pop_output(receiver.stream_out().buffer_size());
+            sender.ack_received(receiver.ackno().value(), receiver.window_size());
+            sent++;
+        }
+    }
+    return sent;
+}
+
+int main() {
+    try {
+        constexpr size_t WARMUP_SEGMENTS = 10'000;
+        constexpr size_t MEASURED_SEGMENTS = 200'000;
+
+        TCPSender sender{TCPConfig::DEFAULT_CAPACITY, TCPConfig::TIMEOUT_DFLT, WrappingInt32{0}};
+        TCPReceiver receiver{TCPConfig::DEFAULT_CAPACITY};
+        send_segments(sender, receiver, WARMUP_SEGMENTS);
+
+        const size_t count_before = allocation_count;
+        const size_t bytes_before = allocation_bytes;
+        const auto start = chrono::steady_clock::now();
+        const size_t sent = send_segments(sender, receiver, MEASURED_SEGMENTS);
+        const auto elapsed = chrono::steady_clock::now() - start;
+
+        const double per_segment = 1.0 / sent;
+        cout << fixed << setprecision(2);
+        cout << "segments:            " << sent << "\n";
+        cout << "allocations/segment: " << (allocation_count - count_before) * per_segment << "\n";
+        cout << "bytes/segment:       " << (allocation_bytes - bytes_before) * per_segment << "\n";
+        cout << "ns/segment:          " << chrono::duration<double, nano>(elapsed).count() * per_segment << "\n";
+    } catch (const exception &e) {
+        cerr << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
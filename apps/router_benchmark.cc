@@ -0,0 +1,156 @@
+#include "router.hh"
+#include "router_test_harness.hh"
+#include "util.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+static constexpr size_t ROUTES = 500'000;
+static constexpr size_t LOOKUPS = 4'000'000;
+static constexpr size_t DATAGRAMS = 200'000;
+static constexpr size_t INTERFACES = 4;
+static constexpr size_t NEXT_HOPS = 16;
+static constexpr size_t HOT_DESTINATIONS = 1024;
+
+//! A random prefix, with lengths spread roughly like a full Internet routing table's
+static pair<uint32_t, uint8_t> random_prefix(mt19937 &rd) {
+    static const vector<uint8_t> lengths{16, 18, 19, 20, 21, 22, 22, 23, 23, 24, 24, 24, 24, 24, 24, 28, 32};
+    const uint8_t length = lengths[rd() % lengths.size()];
+    return {static_cast<uint32_t>(rd()) & LpmTable::mask(length), length};
+}
+
+//! Seconds taken by `f`
+template <typename F>
+static double time_it(F &&f) {
+    const auto start = chrono::steady_clock::now();
+    f();
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+//! Look up random addresses in a big table, one at a time and then in batches
+static void benchmark_lookups(mt19937 &rd) {
+    LpmTable table;
+    for (uint32_t value = 0; value < ROUTES; value++) {
+        const auto [prefix, length] = random_prefix(rd);
+        table.insert(prefix, length, value);
+    }
+
+    vector<uint32_t> addresses(LOOKUPS);
+    for (auto &address : addresses) {
+        address = rd();
+    }
+    vector<optional<uint32_t>> values(LOOKUPS);
+
+    const double one_at_a_time = time_it([&] {
+        for (size_t i = 0; i < LOOKUPS; i++) {
+            values[i] = table.lookup(addresses[i]);
+        }
+    });
+    const double batched = time_it([&] {
+        for (size_t i = 0; i < LOOKUPS; i += Router::DEFAULT_BATCH_SIZE) {
+            table.lookup(&addresses[i], min(Router::DEFAULT_BATCH_SIZE, LOOKUPS - i), &values[i]);
+        }
+    });
+
+    cout << "LPM table:        " << table.size() << " prefixes, " << table.memory_usage() / (1 << 20) << " MiB\n";
+    cout << "lookups/s, one at a time: " << LOOKUPS / one_at_a_time / 1e6 << " M\n";
+    cout << "lookups/s, batched:       " << LOOKUPS / batched / 1e6 << " M\n";
+}
+
+//! A router with a big table, whose interfaces have learned the Ethernet addresses of every next hop
+static unique_ptr<Router> make_router(mt19937 rd,
+                                      const size_t batch_size,
+                                      const size_t cache_capacity,
+                                      const size_t threads) {
+    auto router = make_test_router(INTERFACES, NEXT_HOPS);
+    router->set_batch_size(batch_size);
+    router->set_route_cache(cache_capacity);
+    router->set_threads(threads);
+
+    for (size_t i = 0; i < ROUTES; i++) {
+        const auto [prefix, length] = random_prefix(rd);
+        const size_t hop = rd() % NEXT_HOPS;
+        const Address next_hop = Address::from_ipv4_numeric(router_next_hop_ip(hop));
+        router->route_table().add({prefix, length, LpmTable::mask(length), next_hop, hop % INTERFACES});
+    }
+    router->route_table().publish();
+    return router;
+}
+
+//! Datagrams per second routed (and sent) by a router that routes `batch_size` at a time, on `threads` threads
+static double benchmark_router(const mt19937 &rd,
+                               const vector<InternetDatagram> &datagrams,
+                               const size_t batch_size,
+                               const size_t cache_capacity = 0,
+                               const size_t threads = 1) {
+    const auto router = make_router(rd, batch_size, cache_capacity, threads);
+    double elapsed = 0;
+    for (unsigned round = 0; round < 3; round++) {
+        for (size_t i = 0; i < datagrams.size(); i++) {
+            router->interface(i % INTERFACES).queue_datagram(InternetDatagram{datagrams[i]});
+        }
+        elapsed += time_it([&] { router->route(); });
+        for (size_t i = 0; i < INTERFACES; i++) {
+            auto &frames = router->interface(i).frames_out();
+            while (not frames.empty()) {
+                frames.pop();
+            }
+        }
+    }
+    return 3 * datagrams.size() / elapsed;
+}
+
+int main() {
+    try {
+        auto rd = get_random_generator();
+        cout << fixed << setprecision(2);
+        benchmark_lookups(rd);
+
+        // datagrams to random destinations, and to a few hot ones
+        vector<InternetDatagram> datagrams(DATAGRAMS), hot_datagrams(DATAGRAMS);
+        vector<uint32_t> hot_destinations(HOT_DESTINATIONS);
+        for (auto &dst : hot_destinations) {
+            dst = rd();
+        }
+        for (size_t i = 0; i < DATAGRAMS; i++) {
+            for (auto [dgram, dst] : {pair<InternetDatagram *, uint32_t>{&datagrams[i], rd()},
+                                      {&hot_datagrams[i], hot_destinations[rd() % HOT_DESTINATIONS]}}) {
+                dgram->header().src = 0x01020304;
+                dgram->header().dst = dst;
+                dgram->payload() = string(64, 'x');
+                dgram->header().len = dgram->header().hlen * 4 + dgram->payload().size();
+            }
+        }
+
+        const size_t batch = Router::DEFAULT_BATCH_SIZE;
+        cout << "\nrouter:           " << ROUTES << " routes, " << INTERFACES << " interfaces\n";
+        cout << "datagrams/s, one at a time: " << benchmark_router(rd, datagrams, 1) / 1e6 << " M\n";
+        cout << "datagrams/s, batches of " << batch << ": " << benchmark_router(rd, datagrams, batch) / 1e6 << " M\n";
+
+        cout << "\n" << HOT_DESTINATIONS << " hot destinations, batches of " << batch << "\n";
+        cout << "datagrams/s, no route cache:     " << benchmark_router(rd, hot_datagrams, batch) / 1e6 << " M\n";
+        cout << "datagrams/s, " << RouteCache::DEFAULT_CAPACITY << "-entry route cache: "
+             << benchmark_router(rd, hot_datagrams, batch, RouteCache::DEFAULT_CAPACITY) / 1e6 << " M\n";
+
+        // (each thread routes its share of the flows, and sends for its share of the interfaces)
+        const size_t cores = max(1U, thread::hardware_concurrency());
+        cout << "\nthreads, batches of " << batch << " (" << cores << " cores)\n";
+        for (size_t threads = 1; threads <= max(size_t{4}, cores); threads *= 2) {
+            cout << "datagrams/s, " << setw(2) << threads << " thread(s): "
+                 << benchmark_router(rd, datagrams, batch, 0, threads) / 1e6 << " M\n";
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,37 @@
+#include "file_descriptor.hh"
+#include "tracepoint.hh"
+#include "util.hh"
+
+#include <cstdlib>
+#include <fcntl.h>
+#include <iostream>
+
+using namespace std;
+
+int main(int argc, char *argv[]) {
+    try {
+        if (argc <= 0) {
+            abort();  // For sticklers: don't try to access argv[0] if argc <= 0.
+        }
+
+        if (argc != 2) {
+            cerr << "Usage: " << argv[0] << " TRACE_FILE\n";
+            return EXIT_FAILURE;
+        }
+
+        FileDescriptor trace_file{SystemCall("open", open(argv[1], O_RDONLY))};
+        string contents;
+        while (not trace_file.eof()) {
+            contents.append(trace_file.read());
+        }
+
+        for (const auto &rec : trace_load(contents)) {
+            cout << rec.to_string() << "\n";
+        }
+    } catch (const exception &e) {
+        cerr << argv[1] << ": " << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -18,3 +18,15 @@ endif ()
 set (CMAKE_CXX_FLAGS_DEBUG "${CMAKE_CXX_FLAGS_DEBUG} -ggdb3 -Og")
 set (CMAKE_CXX_FLAGS_DEBUGASAN "${CMAKE_CXX_FLAGS_DEBUG} -fsanitize=undefined -fsanitize=address")
 set (CMAKE_CXX_FLAGS_RELASAN "${CMAKE_CXX_FLAGS_RELEASE} -fsanitize=undefined -fsanitize=address")
+
+# compile in the binary event-ring tracepoints (see libsponge/util/tracepoint.hh)
+option (SPONGE_TRACE "Record TCP/IP events in per-thread trace rings" OFF)
+if (SPONGE_TRACE)
+    add_definitions (-DSPONGE_TRACE)
+endif ()
+
+# make Buffer reference counts plain integers (see libsponge/util/buffer_pool.hh)
+option (SPONGE_SINGLE_THREADED_BUFFERS "Use non-atomic reference counts for Buffer storage" OFF)
+if (SPONGE_SINGLE_THREADED_BUFFERS)
+    add_definitions (-DSPONGE_SINGLE_THREADED_BUFFERS)
+endif ()
@@ -7,6 +7,26 @@ add_test(NAME t_wrapping_ints_unwrap      COMMAND wrapping_integers_unwrap)
 add_test(NAME t_wrapping_ints_wrap        COMMAND wrapping_integers_wrap)
 add_test(NAME t_wrapping_ints_roundtrip   COMMAND wrapping_integers_roundtrip)
 
+add_test(NAME t_checksum_kernels         COMMAND internet_checksum_kernels)
+add_test(NAME t_checksum_update          COMMAND internet_checksum_update)
+add_test(NAME t_packet_buffer            COMMAND packet_buffer)
+add_test(NAME t_buffer_pool              COMMAND buffer_pool)
+add_test(NAME t_buffer_list              COMMAND buffer_list)
+add_test(NAME t_eventloop                COMMAND eventloop)
+add_test(NAME t_trace_ring               COMMAND trace_ring)
+add_test(NAME t_pcap_writer              COMMAND pcap_writer)
+add_test(NAME t_batched_io               COMMAND batched_io)
+add_test(NAME t_udp_batch                COMMAND udp_batch)
+add_test(NAME t_lpm_table                COMMAND lpm_table)
+add_test(NAME t_neighbor_table           COMMAND neighbor_table)
+add_test(NAME t_arp_pending              COMMAND arp_pending)
+add_test(NAME t_send_cache               COMMAND send_cache)
+add_test(NAME t_qdisc                    COMMAND qdisc)
+add_test(NAME t_route_table              COMMAND route_table)
+add_test(NAME t_router_batch             COMMAND router_batch)
+add_test(NAME t_router_parallel          COMMAND router_parallel)
+add_test(NAME t_router_ecmp              COMMAND router_ecmp)
+
 add_test(NAME t_recv_connect         COMMAND recv_connect)
 add_test(NAME t_recv_transmit        COMMAND recv_transmit)
 add_test(NAME t_recv_window          COMMAND recv_window)
@@ -1,5 +1,9 @@
 #include "byte_stream.hh"
 
+#include "util.hh"
+
+#include <algorithm>
+
 // Dummy implementation of a flow-controlled in-memory byte stream.
 
 // For Lab 0, please replace with a real implementation that passes the
@@ -18,27 +22,61 @@ ByteStream::ByteStream(const size_t capacity)
     return;
 }
 
+//! \details The ring starts small and doubles (unwrapping its contents) when it fills, so a stream
+//! with a large capacity only pays for the bytes it actually buffers.
+void ByteStream::reserve(const size_t len) {
+    if (buffer_used + len <= buffer.size()) {
+        return;
+    }
+
+    const auto [first, second] = contiguous_output(buffer_used);
+    string grown(min(max_capacity, max({buffer.size() * 2, buffer_used + len, size_t{64}})), 0);
+    copy(first.begin(), first.end(), grown.begin());
+    copy(second.begin(), second.end(), grown.begin() + first.size());
+    buffer = move(grown);
+    buffer_start = 0;
+}
+
 size_t ByteStream::write(const string &data) {
     size_t bytes_written = min(data.length(), remaining_capacity());
-    for (size_t i = 0; i < bytes_written; i++)
-    {
-        buffer.push_back(data[i]);
+    if (bytes_written == 0) {
+        return 0;
     }
+    reserve(bytes_written);
+
+    const size_t end = (buffer_start + buffer_used) % buffer.size();
+    const size_t first_part = min(bytes_written, buffer.size() - end);
+    copy_n(data.begin(), first_part, buffer.begin() + end);
+    copy_n(data.begin() + first_part, bytes_written - first_part, buffer.begin());
+
+    buffer_used += bytes_written;
     total_bytes_written += bytes_written;
     return bytes_written;
 }
 
+pair<string_view, string_view> ByteStream::contiguous_output(const size_t len) const {
+    const size_t peek_len = min(len, buffer_used);
+    const size_t first_part = min(peek_len, buffer.size() - buffer_start);
+    return {string_view(buffer.data() + buffer_start, first_part),
+            string_view(buffer.data(), peek_len - first_part)};
+}
+
 //! \param[in] len bytes will be copied from the output side of the buffer
 string ByteStream::peek_output(const size_t len) const {
-    size_t peek_len = min(len, buffer.size());
-    return string(buffer.begin(), buffer.begin()+peek_len);
+    const auto [first, second] = contiguous_output(len);
+    string output;
+    output.reserve(first.size() + second.size());
+    output.append(first);
+    output.append(second);
+    return output;
 }
 
 //! \param[in] len bytes will be removed from the output side of the buffer
 void ByteStream::pop_output(const size_t len) {
-    size_t pop_len = min(len, buffer.size());
+    size_t pop_len = min(len, buffer_used);
     total_bytes_read += pop_len;
-    buffer.erase(buffer.begin(), buffer.begin()+pop_len);
+    buffer_used -= pop_len;
+    buffer_start = buffer_used == 0 ? 0 : (buffer_start + pop_len) % buffer.size();
     return;
 }
 
@@ -51,6 +89,18 @@ std::string ByteStream::read(const size_t len) {
     return output;
 }
 
+//! \param[in] len bytes will be popped and returned
+//! \param[in,out] check has the returned bytes added to it (in the same pass that copies them)
+//! \returns a Buffer
+Buffer ByteStream::read(const size_t len, InternetChecksum &check) {
+    const auto [first, second] = contiguous_output(len);
+    Buffer output = Buffer::allocate(first.size() + second.size());
+    check.add_copy(first, output.mutable_data());
+    check.add_copy(second, output.mutable_data() + first.size());
+    pop_output(output.size());
+    return output;
+}
+
 void ByteStream::end_input() {
     ended = true;
 }
@@ -60,15 +110,15 @@ bool ByteStream::input_ended() const {
 }
 
 size_t ByteStream::buffer_size() const {
-    return buffer.size();
+    return buffer_used;
 }
 
 bool ByteStream::buffer_empty() const {
-    return buffer.empty();
+    return buffer_used == 0;
 }
 
 bool ByteStream::eof() const {
-    return buffer.empty() && ended;
+    return buffer_empty() && ended;
 }
 
 size_t ByteStream::bytes_written() const {
@@ -80,5 +130,5 @@ size_t ByteStream::bytes_read() const {
 }
 
 size_t ByteStream::remaining_capacity() const {
-    return max_capacity - buffer.size();
+    return max_capacity - buffer_used;
 }
@@ -1,11 +1,16 @@
 #ifndef SPONGE_LIBSPONGE_BYTE_STREAM_HH
 #define SPONGE_LIBSPONGE_BYTE_STREAM_HH
 
+#include "buffer.hh"
+
 #include <string>
-#include <queue>
+#include <string_view>
+#include <utility>
 
 using namespace std;
 
+class InternetChecksum;
+
 //! \brief An in-order byte stream.
 
 //! Bytes are written on the "input" side and read from the "output"
@@ -20,13 +25,21 @@ class ByteStream {
     // that's a sign that you probably want to keep exploring
     // different approaches.
     size_t max_capacity = 0;
-    deque<char> buffer = {};
+    string buffer = {};       //!< Ring of unread bytes (grown on demand, up to max_capacity)
+    size_t buffer_start = 0;  //!< Index in `buffer` of the next byte to read
+    size_t buffer_used = 0;   //!< Number of unread bytes in `buffer`
     bool ended = false;
     size_t total_bytes_written = 0;
     size_t total_bytes_read = 0;
 
     bool _error = false;  //!< Flag indicating that the stream suffered an error.
 
+    //! The next `len` unread bytes, as the (at most two) contiguous pieces of the ring they occupy
+    pair<string_view, string_view> contiguous_output(const size_t len) const;
+
+    //! Make room in the ring for `len` more bytes (which must fit in the remaining capacity)
+    void reserve(const size_t len);
+
   public:
     //! Construct a stream with room for `capacity` bytes.
     ByteStream(const size_t capacity);
@@ -63,6 +76,10 @@ class ByteStream {
     //! \returns a string
     std::string read(const size_t len);
 
+    //! Read the next "len" bytes of the stream into pooled storage, adding them to `check` as they are copied
+    //! \returns a Buffer
+    Buffer read(const size_t len, InternetChecksum &check);
+
     //! \returns `true` if the stream input has ended
     bool input_ended() const;
 
@@ -0,0 +1,68 @@
+#include "flow_hash.hh"
+
+using namespace std;
+
+//! \param[in] key is the secret key
+FlowHash::FlowHash(const array<uint8_t, KEY_SIZE> &key) {
+    for (size_t byte = 0; byte < _tables.size(); byte++) {
+        // each set input bit XORs in the 32 key bits starting at its own position
+        array<uint32_t, 8> windows{};
+        for (unsigned bit = 0; bit < 8; bit++) {
+            const size_t start = byte * 8 + bit;
+            for (size_t i = start; i < start + 32; i++) {
+                windows[bit] = (windows[bit] << 1) | ((key[i / 8] >> (7 - i % 8)) & 1);
+            }
+        }
+        for (unsigned value = 0; value < 256; value++) {
+            for (unsigned bit = 0; bit < 8; bit++) {
+                if (value & (0x80 >> bit)) {
+                    _tables[byte][value] ^= windows[bit];
+                }
+            }
+        }
+    }
+}
+
+//! \param[in] input is the bytes to hash (in network order)
+//! \param[in] length is the number of bytes, at most 12
+uint32_t FlowHash::toeplitz(const uint8_t *input, const size_t length) const {
+    uint32_t hash = 0;
+    for (size_t byte = 0; byte < length; byte++) {
+        hash ^= _tables[byte][input[byte]];
+    }
+    return hash;
+}
+
+//! \param[in] dgram is the datagram whose flow to hash
+uint32_t FlowHash::operator()(const InternetDatagram &dgram) const {
+    static constexpr uint8_t PROTO_UDP = 17;
+
+    // source address, destination address, source port, destination port (as RSS lays them out)
+    array<uint8_t, 12> input{};
+    const auto &header = dgram.header();
+    for (unsigned i = 0; i < 4; i++) {
+        input[i] = header.src >> (24 - 8 * i);
+        input[4 + i] = header.dst >> (24 - 8 * i);
+    }
+
+    // a flow that may be fragmented hashes without ports throughout, so its fragments go its way too
+    const bool unfragmentable = header.df and not header.mf and header.offset == 0;
+    if (not unfragmentable or (header.proto != IPv4Header::PROTO_TCP and header.proto != PROTO_UDP)) {
+        return toeplitz(input.data(), 8);
+    }
+
+    // the ports are the first four bytes of the payload, wherever its pieces split them
+    size_t length = 8;
+    for (const auto &buffer : dgram.payload().buffers()) {
+        const auto piece = buffer.str();
+        for (size_t i = 0; i < piece.size() and length < input.size(); i++) {
+            input[length++] = piece[i];
+        }
+    }
+    return toeplitz(input.data(), length == input.size() ? length : 8);
+}
+
+const FlowHash &FlowHash::shared() {
+    static const FlowHash hash{};
+    return hash;
+}
@@ -0,0 +1,44 @@
+#ifndef SPONGE_LIBSPONGE_FLOW_HASH_HH
+#define SPONGE_LIBSPONGE_FLOW_HASH_HH
+
+#include "ipv4_datagram.hh"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+//! \brief Receive-side-scaling (RSS) style hashing of a datagram's flow, for spreading flows across threads
+class FlowHash {
+  public:
+    static constexpr size_t KEY_SIZE = 40;  //!< Bytes of secret key (enough for a 36-byte input)
+
+    //! The key most NICs ship with (from Microsoft's RSS specification)
+    static constexpr std::array<uint8_t, KEY_SIZE> DEFAULT_KEY{
+        0x6d, 0x5a, 0x56, 0xda, 0x25, 0x5b, 0x0e, 0xc2, 0x41, 0x67, 0x25, 0x3d, 0x43, 0xa3,
+        0x8f, 0xb0, 0xd0, 0xca, 0x2b, 0xcb, 0xae, 0x7b, 0x30, 0xb4, 0x77, 0xcb, 0x2d, 0xa3,
+        0x80, 0x30, 0xf2, 0x0c, 0x6a, 0x42, 0xb7, 0x3b, 0xbe, 0xac, 0x01, 0xfa};
+
+  private:
+    //! For each input byte position and value, that byte's contribution to the hash
+    std::array<std::array<uint32_t, 256>, 12> _tables{};
+
+  public:
+    //! \brief A hash with the given key
+    explicit FlowHash(const std::array<uint8_t, KEY_SIZE> &key = DEFAULT_KEY);
+
+    //! \brief The Toeplitz hash of `input` (at most 12 bytes)
+    uint32_t toeplitz(const uint8_t *input, const size_t length) const;
+
+    //! \brief The hash of a datagram's flow
+    //! \details TCP and UDP datagrams with the Don't Fragment flag set hash their addresses and ports.
+    //! Any other datagram hashes just its addresses, as it may be fragmented, and a fragment after the
+    //! first lacks the ports. So every datagram of a flow hashes the same, as long as its sender sets
+    //! DF on all or none of them (as TCP, with path MTU discovery, does).
+    uint32_t operator()(const InternetDatagram &dgram) const;
+
+    //! \brief The hash with the default key, built on first use (it picks receive queues, multipath next hops
+    //! and qdisc flow buckets)
+    static const FlowHash &shared();
+};
+
+#endif  // SPONGE_LIBSPONGE_FLOW_HASH_HH
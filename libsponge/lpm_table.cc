@@ -0,0 +1,144 @@
+#include "lpm_table.hh"
+
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+
+using namespace std;
+
+LpmTable::LpmTable() : _root(size_t{1} << ROOT_BITS) {}
+
+void LpmTable::_cover(uint32_t &entry, const uint32_t leaf, const uint8_t length) {
+    if (entry & CHILD) {
+        const size_t first = (entry & ~CHILD) * GROUP_SIZE;
+        for (size_t i = 0; i < GROUP_SIZE; i++) {
+            _cover(_groups[first + i], leaf, length);
+        }
+    } else if (entry == 0 or (entry >> LENGTH_SHIFT) < length) {
+        entry = leaf;
+    }
+}
+
+uint32_t LpmTable::_child(const size_t entry_index, const bool in_root) {
+    const uint32_t entry = in_root ? _root[entry_index] : _groups[entry_index];
+    if (entry & CHILD) {
+        return entry & ~CHILD;
+    }
+
+    // the new group starts out covered by whatever covered the entry
+    const uint32_t group = _groups.size() / GROUP_SIZE;
+    _groups.resize(_groups.size() + GROUP_SIZE, entry);
+    (in_root ? _root[entry_index] : _groups[entry_index]) = CHILD | group;
+    return group;
+}
+
+//! \returns the entries at the level where a prefix ends, which it covers (creating groups if necessary)
+pair<uint32_t *, size_t> LpmTable::_entries(const uint32_t prefix, const uint8_t prefix_length) {
+    if (prefix_length <= ROOT_BITS) {
+        return {&_root[prefix >> 16], size_t{1} << (ROOT_BITS - prefix_length)};
+    }
+
+    const size_t middle = _child(prefix >> 16, true) * GROUP_SIZE + ((prefix >> 8) & 0xff);
+    if (prefix_length <= ROOT_BITS + GROUP_BITS) {
+        return {&_groups[middle], size_t{1} << (ROOT_BITS + GROUP_BITS - prefix_length)};
+    }
+    return {&_groups[_child(middle, false) * GROUP_SIZE + (prefix & 0xff)], size_t{1} << (32 - prefix_length)};
+}
+
+void LpmTable::_uncover(uint32_t &entry, const uint32_t old_leaf, const uint32_t new_leaf) {
+    if (entry & CHILD) {
+        const size_t first = (entry & ~CHILD) * GROUP_SIZE;
+        for (size_t i = 0; i < GROUP_SIZE; i++) {
+            _uncover(_groups[first + i], old_leaf, new_leaf);
+        }
+    } else if (entry == old_leaf) {
+        entry = new_leaf;
+    }
+}
+
+//! \param[in] prefix is the prefix (only its top `prefix_length` bits may be set)
+//! \param[in] prefix_length is the number of bits of `prefix` an address must match (0 through 32)
+//! \param[in] value is returned by lookup() for addresses matching this prefix and no longer one
+bool LpmTable::insert(const uint32_t prefix, const uint8_t prefix_length, const uint32_t value) {
+    if (prefix_length > 32) {
+        throw runtime_error("LpmTable: prefix length is longer than 32 bits");
+    }
+    if (value > MAX_VALUE) {
+        throw runtime_error("LpmTable: value is too large");
+    }
+    if (prefix & ~mask(prefix_length)) {
+        throw runtime_error("LpmTable: prefix has bits set beyond its length");
+    }
+
+    if (not _prefixes.emplace(_key(prefix, prefix_length), value).second) {
+        return false;
+    }
+
+    const auto [first, count] = _entries(prefix, prefix_length);
+    for (size_t i = 0; i < count; i++) {
+        _cover(first[i], _leaf(prefix_length, value), prefix_length);
+    }
+    return true;
+}
+
+//! \param[in] prefix is the prefix to remove
+//! \param[in] prefix_length is its length
+bool LpmTable::erase(const uint32_t prefix, const uint8_t prefix_length) {
+    const auto it = prefix_length <= 32 ? _prefixes.find(_key(prefix, prefix_length)) : _prefixes.end();
+    if (it == _prefixes.end()) {
+        return false;
+    }
+    const uint32_t old_leaf = _leaf(prefix_length, it->second);
+    _prefixes.erase(it);
+
+    // the entries go back to the longest prefix that covers this one, if any
+    uint32_t new_leaf = 0;
+    for (int length = prefix_length - 1; length >= 0; length--) {
+        const auto parent = _prefixes.find(_key(prefix & mask(length), length));
+        if (parent != _prefixes.end()) {
+            new_leaf = _leaf(length, parent->second);
+            break;
+        }
+    }
+
+    const auto [first, count] = _entries(prefix, prefix_length);
+    for (size_t i = 0; i < count; i++) {
+        _uncover(first[i], old_leaf, new_leaf);
+    }
+    return true;
+}
+
+//! \param[in] addresses are the addresses to look up
+//! \param[in] count is the number of addresses
+//! \param[out] values receives the value of each address's longest matching prefix, if any
+void LpmTable::lookup(const uint32_t *addresses, const size_t count, optional<uint32_t> *values) const {
+    array<uint32_t, CHUNK_SIZE> entries;
+    for (size_t start = 0; start < count; start += CHUNK_SIZE) {
+        const uint32_t *chunk = addresses + start;
+        const size_t n = min(CHUNK_SIZE, count - start);
+
+        for (size_t i = 0; i < n; i++) {
+            __builtin_prefetch(&_root[chunk[i] >> 16]);
+        }
+        for (size_t i = 0; i < n; i++) {
+            entries[i] = _root[chunk[i] >> 16];
+            if (entries[i] & CHILD) {
+                __builtin_prefetch(&_groups[(entries[i] & ~CHILD) * GROUP_SIZE + ((chunk[i] >> 8) & 0xff)]);
+            }
+        }
+        for (size_t i = 0; i < n; i++) {
+            if (entries[i] & CHILD) {
+                entries[i] = _groups[(entries[i] & ~CHILD) * GROUP_SIZE + ((chunk[i] >> 8) & 0xff)];
+                if (entries[i] & CHILD) {
+                    __builtin_prefetch(&_groups[(entries[i] & ~CHILD) * GROUP_SIZE + (chunk[i] & 0xff)]);
+                }
+            }
+        }
+        for (size_t i = 0; i < n; i++) {
+            if (entries[i] & CHILD) {
+                entries[i] = _groups[(entries[i] & ~CHILD) * GROUP_SIZE + (chunk[i] & 0xff)];
+            }
+            values[start + i] = entries[i] ? optional<uint32_t>{(entries[i] & VALUE_MASK) - 1} : nullopt;
+        }
+    }
+}
@@ -0,0 +1,120 @@
+#ifndef SPONGE_LIBSPONGE_LPM_TABLE_HH
+#define SPONGE_LIBSPONGE_LPM_TABLE_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+//! \brief A longest-prefix-match table from IPv4 prefixes to small integers (e.g. indices of routes)
+class LpmTable {
+  public:
+    static constexpr uint32_t MAX_VALUE = (uint32_t{1} << 24) - 2;  //!< Largest value that can be stored
+
+  private:
+    //! \name Entry encoding
+    //! Each entry is a uint32_t: zero if no prefix covers it, CHILD plus the index of a group of
+    //! 256 entries for the next 8 bits, or else the covering prefix's length (bits 24-29) and
+    //! its value plus one (bits 0-23).
+    //!@{
+    static constexpr uint32_t CHILD = uint32_t{1} << 31;
+    static constexpr uint32_t VALUE_MASK = (uint32_t{1} << 24) - 1;
+    static constexpr unsigned LENGTH_SHIFT = 24;
+    //!@}
+
+    static constexpr unsigned ROOT_BITS = 16;              //!< The root table is indexed by the top 16 address bits
+    static constexpr unsigned GROUP_BITS = 8;              //!< Each group below it is indexed by the next 8 bits
+    static constexpr size_t GROUP_SIZE = 1 << GROUP_BITS;  //!< Entries in each group
+    static constexpr size_t CHUNK_SIZE = 32;               //!< Addresses looked up together by a batch lookup
+
+    std::vector<uint32_t> _root;      //!< 2^16 entries, one per /16
+    std::vector<uint32_t> _groups{};  //!< Groups of GROUP_SIZE entries, for /17 through /32
+
+    //! Every prefix inserted (the key is the prefix shifted left 8 bits, plus its length), and its value
+    std::unordered_map<uint64_t, uint32_t> _prefixes{};
+
+    //! Cover `entry` (and every entry below it) with `leaf`, a prefix of `length`, wherever no longer prefix does
+    void _cover(uint32_t &entry, const uint32_t leaf, const uint8_t length);
+
+    //! Where `entry` (and every entry below it) is `old_leaf`, make it `new_leaf`
+    void _uncover(uint32_t &entry, const uint32_t old_leaf, const uint32_t new_leaf);
+
+    //! The group below root (or group) entry `entry_index`, created (filled with the entry) if necessary
+    uint32_t _child(const size_t entry_index, const bool in_root);
+
+    //! The first entry covered by a prefix, and the number covered
+    std::pair<uint32_t *, size_t> _entries(const uint32_t prefix, const uint8_t prefix_length);
+
+    //! The key of a prefix in `_prefixes`
+    static uint64_t _key(const uint32_t prefix, const uint8_t prefix_length) {
+        return (uint64_t{prefix} << 8) | prefix_length;
+    }
+
+    //! The entry for addresses covered by a prefix of `prefix_length` with `value`
+    static uint32_t _leaf(const uint8_t prefix_length, const uint32_t value) {
+        return (uint32_t{prefix_length} << LENGTH_SHIFT) | (value + 1);
+    }
+
+  public:
+    //! The netmask of a prefix of `prefix_length` bits
+    static uint32_t mask(const uint8_t prefix_length) {
+        return prefix_length == 0 ? 0 : ~uint32_t{0} << (32 - prefix_length);
+    }
+
+    //! An empty table
+    LpmTable();
+
+    //! \brief Map addresses matching the top `prefix_length` bits of `prefix` to `value`
+    //! \details If the same prefix was already inserted, the value inserted first is kept.
+    //! \returns `false` if the prefix was already present
+    bool insert(const uint32_t prefix, const uint8_t prefix_length, const uint32_t value);
+
+    //! \brief Remove a prefix, so addresses it covered match the next-longest prefix (if any) instead
+    //! \returns `false` if the prefix wasn't present
+    bool erase(const uint32_t prefix, const uint8_t prefix_length);
+
+    //! The value inserted for exactly this prefix, if any
+    std::optional<uint32_t> find(const uint32_t prefix, const uint8_t prefix_length) const {
+        const auto it = _prefixes.find(_key(prefix, prefix_length));
+        return it == _prefixes.end() ? std::nullopt : std::optional<uint32_t>{it->second};
+    }
+
+    //! \brief The value of the longest prefix matching `address`, if any
+    //! \details At most three memory accesses: the root, then up to two groups.
+    std::optional<uint32_t> lookup(const uint32_t address) const {
+        uint32_t entry = _root[address >> 16];
+        if (entry & CHILD) {
+            entry = _groups[(entry & ~CHILD) * GROUP_SIZE + ((address >> 8) & 0xff)];
+            if (entry & CHILD) {
+                entry = _groups[(entry & ~CHILD) * GROUP_SIZE + (address & 0xff)];
+            }
+        }
+        if (entry == 0) {
+            return std::nullopt;
+        }
+        return (entry & VALUE_MASK) - 1;
+    }
+
+    //! \brief Look up `count` addresses at once, storing the value for `addresses[i]` in `values[i]`
+    //! \details Each level of the table is read for every address in a chunk before the next level, with
+    //! the next level's entries prefetched, so the cache misses of different addresses overlap.
+    void lookup(const uint32_t *addresses, const size_t count, std::optional<uint32_t> *values) const;
+
+    //! Number of prefixes inserted
+    size_t size() const { return _prefixes.size(); }
+
+    //! Bytes used by the root table and groups
+    size_t memory_usage() const { return (_root.size() + _groups.size()) * sizeof(uint32_t); }
+};
+
+//! \class LpmTable
+//! This is a multibit trie with strides of 16, 8 and 8 bits (a variant of DIR-24-8 that needs
+//! 256 KiB, rather than 64 MiB, before any long prefixes are added). Prefixes are expanded
+//! into every entry they cover at the level where they end: a /12 fills 16 root entries, a
+//! /20 fills 16 entries of the group below its /16, and so on. A shorter prefix never
+//! overwrites an entry filled by a longer one, so the order of insertion doesn't matter.
+//! Erasing a prefix refills its entries with the next-longest prefix; groups, once created, stay.
+
+#endif  // SPONGE_LIBSPONGE_LPM_TABLE_HH
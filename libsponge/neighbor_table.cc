@@ -0,0 +1,108 @@
+#include "neighbor_table.hh"
+
+#include <algorithm>
+#include <utility>
+
+using namespace std;
+
+NeighborTable::NeighborTable() : _slots(INITIAL_CAPACITY) {}
+
+//! \param[in] ip_address is the neighbour to look for
+size_t NeighborTable::_probe(const uint32_t ip_address) const {
+    size_t slot = _home(ip_address);
+    while (_slots[slot].in_use and _slots[slot].ip_address != ip_address) {
+        slot = (slot + 1) & (_slots.size() - 1);
+    }
+    return slot;
+}
+
+void NeighborTable::_grow() {
+    vector<Entry> old_slots(_slots.size() * 2);
+    swap(old_slots, _slots);
+    for (auto &entry : old_slots) {
+        if (entry.in_use) {
+            _slots[_probe(entry.ip_address)] = move(entry);
+        }
+    }
+}
+
+//! \param[in] ip_address is the neighbour to find or add
+NeighborTable::Entry &NeighborTable::insert(const uint32_t ip_address) {
+    size_t slot = _probe(ip_address);
+    if (_slots[slot].in_use) {
+        return _slots[slot];
+    }
+
+    // (kept at most half full, so probes stay short)
+    if (2 * (_size + 1) > _slots.size()) {
+        _grow();
+        slot = _probe(ip_address);
+    }
+    Entry &entry = _slots[slot];
+    entry.in_use = true;
+    entry.ip_address = ip_address;
+    _size++;
+    return entry;
+}
+
+//! \param[in] ip_address is the neighbour to remove
+void NeighborTable::erase(const uint32_t ip_address) {
+    size_t hole = _probe(ip_address);
+    if (not _slots[hole].in_use) {
+        return;
+    }
+    _slots[hole] = Entry{};
+    _size--;
+
+    // shift back any later entry of the same run that the hole would cut off from its home slot
+    const size_t mask = _slots.size() - 1;
+    for (size_t slot = (hole + 1) & mask; _slots[slot].in_use; slot = (slot + 1) & mask) {
+        const size_t home = _home(_slots[slot].ip_address);
+        if (((slot - home) & mask) >= ((slot - hole) & mask)) {
+            _slots[hole] = move(_slots[slot]);
+            _slots[slot] = Entry{};
+            hole = slot;
+        }
+    }
+}
+
+//! \param[in] entry is the entry whose timer to set
+//! \param[in] deadline is when the timer fires (in the same units as take_expired()'s `now`)
+void NeighborTable::set_deadline(Entry &entry, const uint64_t deadline) {
+    entry.deadline = max(deadline, _swept_until);
+    _wheel[entry.deadline / SLOT_MS % WHEEL_SLOTS].push_back({entry.ip_address, entry.deadline});
+}
+
+//! \param[in] now is the current time
+//! \param[out] expired receives the IP addresses of the entries whose deadlines have passed
+void NeighborTable::take_expired(const uint64_t now, vector<uint32_t> &expired) {
+    if (now < _swept_until) {
+        return;
+    }
+
+    const size_t first_expired = expired.size();
+    const uint64_t first_slot = _swept_until / SLOT_MS;
+    for (uint64_t slot = first_slot; slot <= now / SLOT_MS and slot < first_slot + WHEEL_SLOTS; slot++) {
+        auto &timers = _wheel[slot % WHEEL_SLOTS];
+        for (size_t i = 0; i < timers.size();) {
+            if (timers[i].deadline > now) {
+                i++;  // (due later, maybe on a later turn of the wheel)
+                continue;
+            }
+
+            const Timer timer = timers[i];
+            timers[i] = timers.back();
+            timers.pop_back();
+
+            // (a timer is stale if its entry has gone, or has been given another deadline since)
+            Entry *entry = find(timer.ip_address);
+            if (entry and entry->deadline == timer.deadline) {
+                entry->deadline = NO_DEADLINE;
+                expired.push_back(timer.ip_address);
+            }
+        }
+    }
+    _swept_until = now + 1;
+
+    sort(expired.begin() + first_expired, expired.end());
+}
@@ -0,0 +1,95 @@
+#ifndef SPONGE_LIBSPONGE_NEIGHBOR_TABLE_HH
+#define SPONGE_LIBSPONGE_NEIGHBOR_TABLE_HH
+
+#include "buffer.hh"
+#include "ethernet_header.hh"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+
+//! \brief A NetworkInterface's neighbours: an open-addressing hash table from IP address to what
+//! ARP has learned (or is still asking) about it, with a timer wheel for expiring entries
+class NeighborTable {
+  public:
+    static constexpr uint64_t NO_DEADLINE = std::numeric_limits<uint64_t>::max();  //!< An entry with no timer
+
+    //! A datagram waiting for a neighbour's address
+    struct PendingDatagram {
+        BufferList serialized{};  //!< The datagram, serialized ready to be a frame's payload
+        uint32_t flow_hash = 0;   //!< The hash of its flow (see FlowHash)
+    };
+
+    //! What is known about one neighbour
+    struct Entry {
+        bool in_use = false;                      //!< Does this slot hold a neighbour? (managed by the table)
+        bool resolved = false;                    //!< Is `ethernet_address` known? (if not, ARP is asking)
+        uint32_t ip_address = 0;                  //!< The neighbour's IP address
+        EthernetAddress ethernet_address{};       //!< The neighbour's Ethernet address, once resolved
+        EthernetHeader link_header{};             //!< The header of IPv4 frames to it, once resolved
+        std::string serialized_link_header{};     //!< `link_header`, serialized (for capture)
+        uint64_t deadline = NO_DEADLINE;          //!< When the entry's timer fires (see take_expired())
+        unsigned requests = 0;                    //!< ARP requests sent (and unanswered) for the address
+        std::vector<PendingDatagram> pending{};   //!< Datagrams waiting for the address
+    };
+
+  private:
+    static constexpr size_t INITIAL_CAPACITY = 16;  //!< Slots in a new table (a power of two)
+    static constexpr size_t WHEEL_SLOTS = 64;       //!< Slots in the timer wheel
+    static constexpr uint64_t SLOT_MS = 512;        //!< Milliseconds of deadlines each wheel slot covers
+
+    //! A deadline set for a neighbour (stale once the neighbour's deadline changes)
+    struct Timer {
+        uint32_t ip_address;  //!< The neighbour
+        uint64_t deadline;    //!< The deadline it was given
+    };
+
+    std::vector<Entry> _slots;
+    size_t _size = 0;
+    std::array<std::vector<Timer>, WHEEL_SLOTS> _wheel{};  //!< Timers, by deadline / SLOT_MS
+    uint64_t _swept_until = 0;                              //!< Every timer before this time has fired
+
+    //! The slot where a probe for `ip_address` starts
+    size_t _home(const uint32_t ip_address) const {
+        return (ip_address * uint64_t{0x9e3779b97f4a7c15}) >> 32 & (_slots.size() - 1);
+    }
+
+    //! The slot holding `ip_address`, or else the empty slot where it would go
+    size_t _probe(const uint32_t ip_address) const;
+
+    //! Double the number of slots
+    void _grow();
+
+  public:
+    //! An empty table
+    NeighborTable();
+
+    //! \brief The entry for `ip_address`, or nullptr if there is none
+    //! \note Entry pointers and references are invalidated by insert() and erase().
+    Entry *find(const uint32_t ip_address) {
+        Entry &entry = _slots[_probe(ip_address)];
+        return entry.in_use ? &entry : nullptr;
+    }
+
+    //! \brief The entry for `ip_address`, added (unresolved, with no deadline) if there was none
+    Entry &insert(const uint32_t ip_address);
+
+    //! \brief Remove the entry for `ip_address` (if any)
+    void erase(const uint32_t ip_address);
+
+    //! Number of neighbours
+    size_t size() const { return _size; }
+
+    //! \brief Give an entry a deadline (replacing any it had), after which take_expired() reports it
+    void set_deadline(Entry &entry, const uint64_t deadline);
+
+    //! \brief Append (in increasing order) the IP address of each entry whose deadline is at or before `now`,
+    //! and clear their deadlines
+    //! \details Only looks at the timers due since the last call, so its cost doesn't grow with the table.
+    void take_expired(const uint64_t now, std::vector<uint32_t> &expired);
+};
+
+#endif  // SPONGE_LIBSPONGE_NEIGHBOR_TABLE_HH
@@ -2,9 +2,14 @@
 
 #include "arp_message.hh"
 #include "ethernet_frame.hh"
+#include "flow_hash.hh"
+#include "tracepoint.hh"
 
+#include <algorithm>
+#include <array>
 #include <optional>
-#include <iostream>
+#include <stdexcept>
+#include <string>
 
 // Dummy implementation of a network interface
 // Translates from {IP datagram, next hop address} to link-layer frame, and from link-layer frame to IP datagram
@@ -19,12 +24,59 @@ void DUMMY_CODE(Targs &&... /* unused */) {}
 
 using namespace std;
 
+//! \param[in] dgram the datagram to serialize
+//! \returns its header (with the checksum filled in) followed by its payload, whose buffers are shared, not copied
+//! \details Unlike IPv4Datagram::serialize(), which encodes the header twice (once to checksum it), this
+//! encodes it once and patches the checksum in.
+static BufferList serialize_datagram(const InternetDatagram &dgram) {
+    const IPv4Header &header = dgram.header();
+    if (header.payload_length() != dgram.payload().size()) {
+        throw runtime_error("IPv4Datagram::serialize: payload is wrong size");
+    }
+
+    // encode the header with a zero checksum, then patch the checksum in (RFC 791: bytes 10 and 11)
+    IPv4Header header_out = header;
+    header_out.cksum = 0;
+    string serialized = header_out.serialize();
+    InternetChecksum check;
+    check.add(serialized);
+    const uint16_t cksum = check.value();
+    serialized[10] = static_cast<char>(cksum >> 8);
+    serialized[11] = static_cast<char>(cksum & 0xff);
+
+    BufferList ret{move(serialized)};
+    ret.append(dgram.payload());
+    return ret;
+}
+
+//! \param[in] tap the capture to add `frame` to
+//! \param[in] frame the frame to capture
+//! \details Only the 14-byte header is encoded (into a buffer on the stack); the payload is copied straight
+//! from its buffers into the capture ring.
+static void capture_frame(PcapWriter &tap, const EthernetFrame &frame) {
+    const EthernetHeader &header = frame.header();
+    array<char, EthernetHeader::LENGTH> encoded{};
+    copy(header.dst.begin(), header.dst.end(), encoded.begin());
+    copy(header.src.begin(), header.src.end(), encoded.begin() + header.dst.size());
+    encoded[12] = static_cast<char>(header.type >> 8);
+    encoded[13] = static_cast<char>(header.type & 0xff);
+    tap.capture(string_view(encoded.data(), encoded.size()), frame.payload());
+}
+
+//! Pack an Ethernet address into the low 48 bits of an integer (for trace records)
+static uint64_t ethernet_as_u64(const EthernetAddress &address) {
+    uint64_t ret = 0;
+    for (const auto byte : address) {
+        ret = (ret << 8) | byte;
+    }
+    return ret;
+}
+
 //! \param[in] ethernet_address Ethernet (what ARP calls "hardware") address of the interface
 //! \param[in] ip_address IP (what ARP calls "protocol") address of the interface
 NetworkInterface::NetworkInterface(const EthernetAddress &ethernet_address, const Address &ip_address)
     : _ethernet_address(ethernet_address), _ip_address(ip_address) {
-    cerr << "DEBUG: Network interface has Ethernet address " << to_string(_ethernet_address) << " and IP address "
-         << ip_address.ip() << "\n";
+    SPONGE_TRACEPOINT(TraceEvent::InterfaceUp, _ip_address.ipv4_numeric(), ethernet_as_u64(_ethernet_address));
 }
 
 //! \param[in] dgram the IPv4 datagram to be sent
@@ -34,41 +86,78 @@ void NetworkInterface::send_datagram(const InternetDatagram &dgram, const Addres
     // convert IP address of next hop to raw 32-bit representation (used in ARP header)
     const uint32_t next_hop_ip = next_hop.ipv4_numeric();
 
-    if (ARPTable.find(next_hop_ip) != ARPTable.end())
+    const NeighborTable::Entry *neighbor = _neighbors.find(next_hop_ip);
+    if (neighbor and neighbor->resolved)
     {
         // The link layer address of the next hop is known
         // Send it directly
         EthernetFrame new_frame;
         
-        // Frame construction
-        new_frame.header().src = _ethernet_address;
-        new_frame.header().dst = (ARPTable.find(next_hop_ip)->second).first;
-        new_frame.header().type = EthernetHeader::TYPE_IPv4;
-        new_frame.payload() = dgram.serialize();
+        // Frame construction (the neighbour's link header was built when its address was learned)
+        new_frame.header() = neighbor->link_header;
+        new_frame.payload() = serialize_datagram(dgram);
 
         // Send the frame
-        _frames_out.push(new_frame);
+        SPONGE_TRACEPOINT(TraceEvent::FrameTx, new_frame.header().type, new_frame.payload().size());
+        _send_frame(move(new_frame), _qdisc ? FlowHash::shared()(dgram) : 0, neighbor->serialized_link_header);
 
     }
     else
     {
         // Send an ARP request to get the link layer address
         // Note that two requests must be separated for at least 5s
-        if (ARP_under_going.find(next_hop_ip) == ARP_under_going.end())
+        SPONGE_TRACEPOINT(TraceEvent::ArpMiss, next_hop_ip);
+        if (not neighbor)
         {
             // The first request in the last 5s
             // Send it
             SendARPMsg(next_hop_ip, _ethernet_address, true);
-
-            // Enqueue the datagram for later transmission
-            DatagramBuffer[next_hop_ip].push(dgram);
         }
+
+        // Enqueue the datagram for later transmission (however many requests are under way)
+        _queue_pending(*_neighbors.find(next_hop_ip), {serialize_datagram(dgram), FlowHash::shared()(dgram)});
     }
     return;
 }
 
+//! \param[in] neighbor the neighbour whose address was learned
+//! \param[in] ethernet_address its Ethernet address
+void NetworkInterface::_resolve(NeighborTable::Entry &neighbor, const EthernetAddress &ethernet_address) {
+    neighbor.resolved = true;
+    neighbor.requests = 0;
+    if (neighbor.serialized_link_header.empty() or neighbor.ethernet_address != ethernet_address) {
+        neighbor.ethernet_address = ethernet_address;
+        neighbor.link_header.src = _ethernet_address;
+        neighbor.link_header.dst = ethernet_address;
+        neighbor.link_header.type = EthernetHeader::TYPE_IPv4;
+        neighbor.serialized_link_header = neighbor.link_header.serialize();
+    }
+}
+
+//! \param[in] neighbor the neighbour whose address the datagram is waiting for
+//! \param[in] dgram the datagram, serialized ready to be an Ethernet frame's payload
+void NetworkInterface::_queue_pending(NeighborTable::Entry &neighbor, NeighborTable::PendingDatagram &&dgram) {
+    if (neighbor.pending.size() >= _pending_limits.per_neighbor or _pending_total >= _pending_limits.total) {
+        _pending_counters.dropped_full++;
+        if (_pending_limits.policy == PendingDropPolicy::DropNewest or neighbor.pending.empty()) {
+            return;
+        }
+        neighbor.pending.erase(neighbor.pending.begin());
+        _pending_total--;
+    }
+
+    neighbor.pending.push_back(move(dgram));
+    _pending_total++;
+    _pending_counters.queued++;
+}
+
 //! \param[in] frame the incoming Ethernet frame
 optional<InternetDatagram> NetworkInterface::recv_frame(const EthernetFrame &frame) {
+    SPONGE_TRACEPOINT(TraceEvent::FrameRx, frame.header().type, frame.payload().size());
+    if (_pcap_tap) {
+        capture_frame(*_pcap_tap, frame);
+    }
+
     if (frame.header().dst == _ethernet_address || frame.header().dst == ETHERNET_BROADCAST)
     {
         // Only process frames destined to current ethernet address
@@ -88,41 +177,27 @@ optional<InternetDatagram> NetworkInterface::recv_frame(const EthernetFrame &fra
             
             if (arp.parse(frame.payload()) == ParseResult::NoError)
             {
-                // Update the mapping table
-                ARPTable[arp.sender_ip_address] = {arp.sender_ethernet_address, 0};
-
-                // Delete the term in under going table
-                std::map<uint32_t, size_t>::iterator iter;
-                iter = ARP_under_going.find(arp.sender_ip_address);
-                if (iter != ARP_under_going.end())
-                {
-                    ARP_under_going.erase(iter);
-                }
+                // Update the mapping table (which also ends any request under way)
+                SPONGE_TRACEPOINT(
+                    TraceEvent::ArpLearn, arp.sender_ip_address, ethernet_as_u64(arp.sender_ethernet_address));
+                NeighborTable::Entry &neighbor = _neighbors.insert(arp.sender_ip_address);
+                _resolve(neighbor, arp.sender_ethernet_address);
+                _neighbors.set_deadline(neighbor, _now + ARP_EXPIRED);
 
                 // Clear the queue 
-                std::map<uint32_t, std::queue<InternetDatagram> >::iterator iter_buffer;
-                iter_buffer = DatagramBuffer.find(arp.sender_ip_address);
-                if (iter_buffer != DatagramBuffer.end())
+                for (auto &dgram : neighbor.pending)
                 {
-                    while (!(iter_buffer->second).empty())
-                    {
-                        InternetDatagram dgram = (iter_buffer->second).front();
-
-                        // Frame construction
-                        EthernetFrame new_frame;
-                        new_frame.header().src = _ethernet_address;
-                        new_frame.header().dst = (ARPTable.find(arp.sender_ip_address)->second).first;
-                        new_frame.header().type = EthernetHeader::TYPE_IPv4;
-                        new_frame.payload() = dgram.serialize();
-
-                        (iter_buffer->second).pop();
-
-                        // Send the frame
-                        _frames_out.push(new_frame);
-                    }
-                    
-                    DatagramBuffer.erase(iter_buffer);
+                    // Frame construction
+                    EthernetFrame new_frame;
+                    new_frame.header() = neighbor.link_header;
+                    new_frame.payload() = move(dgram.serialized);
+
+                    // Send the frame
+                    _send_frame(move(new_frame), dgram.flow_hash, neighbor.serialized_link_header);
                 }
+                _pending_counters.sent += neighbor.pending.size();
+                _pending_total -= neighbor.pending.size();
+                neighbor.pending.clear();
 
                 // Send a reply if a request is received
                 if (arp.opcode == ARPMessage::OPCODE_REQUEST && arp.target_ip_address == _ip_address.ipv4_numeric())
@@ -140,37 +215,31 @@ optional<InternetDatagram> NetworkInterface::recv_frame(const EthernetFrame &fra
 //! \param[in] ms_since_last_tick the number of milliseconds since the last call to this method
 void NetworkInterface::tick(const size_t ms_since_last_tick)
 {
-    // Update the time record of two hash tables
-    std::map<uint32_t, pair <EthernetAddress, size_t> >::iterator iter_mapping;
-    std::map<uint32_t, size_t>::iterator iter_outstanding;
+    // Only the neighbours whose deadlines have passed need anything done
+    _now += ms_since_last_tick;
+    _expired.clear();
+    _neighbors.take_expired(_now, _expired);
 
-    std::queue<uint32_t> deleted_mappings;
-
-    for (iter_mapping = ARPTable.begin(); iter_mapping != ARPTable.end(); iter_mapping++)
+    for (const uint32_t ip_address : _expired)
     {
-        iter_mapping->second.second += ms_since_last_tick;
-        if (iter_mapping->second.second >= ARP_EXPIRED)
+        NeighborTable::Entry &neighbor = *_neighbors.find(ip_address);
+        if (neighbor.resolved)
         {
-            deleted_mappings.push(iter_mapping->first);
+            // The mapping has expired
+            _neighbors.erase(ip_address);
         }
-    }
-
-    for (iter_outstanding = ARP_under_going.begin(); iter_outstanding != ARP_under_going.end(); iter_outstanding++)
-    {
-        iter_outstanding->second += ms_since_last_tick;
-        if (iter_outstanding->second >= ARP_TIMEOUT)
+        else if (neighbor.requests >= ARP_MAX_REQUESTS)
         {
-            iter_outstanding->second = 0;
-
-            SendARPMsg(iter_outstanding->first, _ethernet_address, true);
+            // Give up on the neighbour, and drop what was waiting for it (the next datagram asks afresh)
+            _pending_counters.dropped_unresolved += neighbor.pending.size();
+            _pending_total -= neighbor.pending.size();
+            _neighbors.erase(ip_address);
+        }
+        else
+        {
+            // The request has gone unanswered; ask again
+            SendARPMsg(ip_address, _ethernet_address, true);
         }
-    }
-
-    // Delete if necessary
-    while (!deleted_mappings.empty())
-    {
-        ARPTable.erase(deleted_mappings.front());
-        deleted_mappings.pop();
     }
 }
 
@@ -193,8 +262,10 @@ void NetworkInterface::SendARPMsg(const uint32_t & ip_addr, const EthernetAddres
         ARP_Frame.header().type = EthernetHeader::TYPE_ARP;
         ARP_Frame.payload() = req.serialize();
 
-        _frames_out.push(ARP_Frame);
-        ARP_under_going[ip_addr] = 0;
+        _send_frame(move(ARP_Frame));
+        NeighborTable::Entry &neighbor = _neighbors.insert(ip_addr);
+        neighbor.requests++;
+        _neighbors.set_deadline(neighbor, _now + ARP_TIMEOUT);
         
     }
     else
@@ -214,6 +285,55 @@ void NetworkInterface::SendARPMsg(const uint32_t & ip_addr, const EthernetAddres
         ARP_Frame.header().type = EthernetHeader::TYPE_ARP;
         ARP_Frame.payload() = rep.serialize();
 
-        _frames_out.push(ARP_Frame);
+        _send_frame(move(ARP_Frame));
+    }
+}
+
+//! \param[in] frame the frame to send
+//! \param[in] flow_hash the hash of its flow (ARP frames all use 0)
+//! \param[in] serialized_header the frame's header, already serialized (or empty)
+void NetworkInterface::_send_frame(EthernetFrame &&frame,
+                                   const uint32_t flow_hash,
+                                   const string_view serialized_header) {
+    if (_qdisc) {
+        _qdisc->enqueue(move(frame), flow_hash, _now);
+    } else {
+        _push_frame(move(frame), serialized_header);
+    }
+}
+
+//! \param[in] config the qdisc's discipline and parameters, or nullopt for none
+void NetworkInterface::set_qdisc(const optional<Qdisc::Config> &config) {
+    transmit();
+    _qdisc.reset();
+    if (config) {
+        _qdisc.emplace(*config);
+    }
+}
+
+//! \param[in] max_frames the most frames to move
+size_t NetworkInterface::transmit(const size_t max_frames) {
+    size_t moved = 0;
+    while (_qdisc and moved < max_frames) {
+        auto frame = _qdisc->dequeue(_now);
+        if (not frame) {
+            break;
+        }
+        _push_frame(move(*frame));
+        moved++;
+    }
+    return moved;
+}
+
+//! \param[in] frame the frame to send
+//! \param[in] serialized_header the frame's header, already serialized (or empty)
+void NetworkInterface::_push_frame(EthernetFrame &&frame, const string_view serialized_header) {
+    if (_pcap_tap) {
+        if (serialized_header.empty()) {
+            capture_frame(*_pcap_tap, frame);
+        } else {
+            _pcap_tap->capture(serialized_header, frame.payload());
+        }
     }
+    _frames_out.push(move(frame));
 }
@@ -2,12 +2,18 @@
 #define SPONGE_LIBSPONGE_NETWORK_INTERFACE_HH
 
 #include "ethernet_frame.hh"
+#include "neighbor_table.hh"
+#include "pcap_writer.hh"
+#include "qdisc.hh"
 #include "tcp_over_ip.hh"
 #include "tun.hh"
 
+#include <limits>
+#include <memory>
 #include <optional>
 #include <queue>
-#include <map>
+#include <string_view>
+#include <vector>
 
 //! \brief A "network interface" that connects IP (the internet layer, or network layer)
 //! with Ethernet (the network access layer, or link layer).
@@ -31,10 +37,33 @@
 //! request or reply, the network interface processes the frame
 //! and learns or replies as necessary.
 class NetworkInterface {
+  public:
+    //! Which datagram to drop when a pending queue is full
+    enum class PendingDropPolicy {
+        DropOldest,  //!< Make room by dropping the neighbour's oldest waiting datagram
+        DropNewest   //!< Drop the datagram that didn't fit
+    };
+
+    //! \brief Limits on the datagrams waiting for ARP to resolve their next hops
+    struct PendingLimits {
+        size_t per_neighbor = 32;                                  //!< Most datagrams waiting for one neighbour
+        size_t total = 1024;                                       //!< Most datagrams waiting for all neighbours
+        PendingDropPolicy policy = PendingDropPolicy::DropOldest;  //!< What to drop when a limit is reached
+    };
+
+    //! \brief Counts of datagrams that had to wait for ARP
+    struct PendingCounters {
+        uint64_t queued = 0;              //!< Datagrams queued to wait for a neighbour's address
+        uint64_t sent = 0;                //!< Queued datagrams sent once the address was learned
+        uint64_t dropped_full = 0;        //!< Datagrams dropped because a limit was reached
+        uint64_t dropped_unresolved = 0;  //!< Queued datagrams dropped because the neighbour never answered
+    };
+
   private:
     // Time constants used
     static constexpr size_t ARP_TIMEOUT = 5000;
     static constexpr size_t ARP_EXPIRED = 30000;
+    static constexpr unsigned ARP_MAX_REQUESTS = 3;  //!< Unanswered requests before giving up on a neighbour
 
     //! Ethernet (known as hardware, network-access-layer, or link-layer) address of the interface
     EthernetAddress _ethernet_address;
@@ -45,19 +74,42 @@ class NetworkInterface {
     //! outbound queue of Ethernet frames that the NetworkInterface wants sent
     std::queue<EthernetFrame> _frames_out{};
 
-    // Hash table recording IP address to Ethernet address
-    // with time limit
-    std::map<uint32_t, std::pair<EthernetAddress, size_t> > ARPTable{};
+    //! optional queueing discipline that frames wait in until transmit() moves them to `_frames_out`
+    std::optional<Qdisc> _qdisc{};
+
+    //! What ARP has learned (or is asking) about each neighbour, and datagrams waiting on it
+    NeighborTable _neighbors{};
+
+    //! Milliseconds since the interface was created (the clock of the neighbours' deadlines)
+    uint64_t _now = 0;
 
-    // Hash table recording the ARP requests under going
-    std::map<uint32_t, size_t> ARP_under_going{};
+    //! The neighbours whose deadlines passed in the last tick (kept to reuse its storage)
+    std::vector<uint32_t> _expired{};
 
-    // Hash table to cache datagrams destined to different IPs
-    std::map<uint32_t, std::queue<InternetDatagram> > DatagramBuffer{};
+    PendingLimits _pending_limits{};
+    PendingCounters _pending_counters{};
+    size_t _pending_total = 0;  //!< Datagrams waiting, for all neighbours together
+
+    //! Hold a datagram until `neighbor`'s address is learned (or drop it, or an older one)
+    void _queue_pending(NeighborTable::Entry &neighbor, NeighborTable::PendingDatagram &&dgram);
+
+    //! optional capture of every frame sent or received (see set_pcap_tap())
+    std::shared_ptr<PcapWriter> _pcap_tap{};
+
+    //! Note that `neighbor`'s Ethernet address is `ethernet_address` (and precompute its link header)
+    void _resolve(NeighborTable::Entry &neighbor, const EthernetAddress &ethernet_address);
 
     // Function used to send an ARP message
     void SendARPMsg(const uint32_t &ip_addr, const EthernetAddress & Ethernet_addr, const bool is_request);
 
+    //! Send a frame of the flow whose hash is `flow_hash`, through the qdisc if there is one
+    void _send_frame(EthernetFrame &&frame,
+                     const uint32_t flow_hash = 0,
+                     const std::string_view serialized_header = {});
+
+    //! Queue a frame for sending (and capture it, if tapped, using `serialized_header` if not empty)
+    void _push_frame(EthernetFrame &&frame, const std::string_view serialized_header = {});
+
 
   public:
     //! \brief Construct a network interface with given Ethernet (network-access-layer) and IP (internet-layer) addresses
@@ -81,6 +133,26 @@ class NetworkInterface {
 
     //! \brief Called periodically when time elapses
     void tick(const size_t ms_since_last_tick);
+
+    //! \brief Limit the datagrams that can wait for ARP (see PendingLimits)
+    void set_pending_limits(const PendingLimits &limits) { _pending_limits = limits; }
+
+    //! \brief How many datagrams have waited for ARP, and what became of them
+    const PendingCounters &pending_counters() const { return _pending_counters; }
+
+    //! \brief Queue frames in a qdisc (see Qdisc), or (if nullopt) put them straight on frames_out(), unbounded
+    //! \details Frames waiting in the old qdisc, if any, are moved to frames_out().
+    void set_qdisc(const std::optional<Qdisc::Config> &config);
+
+    //! \brief The qdisc, if there is one (for its statistics)
+    const Qdisc *qdisc() const { return _qdisc ? &*_qdisc : nullptr; }
+
+    //! \brief Move up to `max_frames` frames from the qdisc to frames_out(), as the link is ready for them
+    //! \returns the number of frames moved (always 0 without a qdisc, which puts frames there directly)
+    size_t transmit(const size_t max_frames = std::numeric_limits<size_t>::max());
+
+    //! \brief Capture every frame sent or received to `tap` (an Ethernet PcapWriter), or stop capturing if null
+    void set_pcap_tap(std::shared_ptr<PcapWriter> tap) { _pcap_tap = std::move(tap); }
 };
 
 #endif  // SPONGE_LIBSPONGE_NETWORK_INTERFACE_HH
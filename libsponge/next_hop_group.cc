@@ -0,0 +1,118 @@
+#include "next_hop_group.hh"
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+using namespace std;
+
+//! \param[in] route is the route whose prefix the member is for
+//! \param[in] next_hop is the member's next hop
+void NextHopGroup::_add_member(const RouterEntry &route, const NextHop &next_hop) {
+    _members.push_back(
+        {route.route_prefix, route.prefix_length, route.prefix_mask, next_hop.address, next_hop.interface_num});
+}
+
+void NextHopGroup::_rebalance() {
+    vector<size_t> counts(_members.size(), 0);
+    for (const uint16_t member : _buckets) {
+        if (member != NO_MEMBER) {
+            counts[member]++;
+        }
+    }
+
+    // each member's fair share, with the buckets left over going to the members holding most already
+    vector<size_t> targets(_members.size(), BUCKETS / _members.size());
+    vector<size_t> by_count(_members.size());
+    iota(by_count.begin(), by_count.end(), 0);
+    stable_sort(
+        by_count.begin(), by_count.end(), [&](const size_t a, const size_t b) { return counts[a] > counts[b]; });
+    for (size_t i = 0; i < BUCKETS % _members.size(); i++) {
+        targets[by_count[i]]++;
+    }
+
+    // free the buckets beyond each member's share, then hand the free ones to the members short of theirs
+    vector<size_t> kept(_members.size(), 0);
+    for (uint16_t &member : _buckets) {
+        if (member != NO_MEMBER and kept[member] == targets[member]) {
+            member = NO_MEMBER;
+        } else if (member != NO_MEMBER) {
+            kept[member]++;
+        }
+    }
+    size_t short_member = 0;
+    for (uint16_t &member : _buckets) {
+        if (member == NO_MEMBER) {
+            while (kept[short_member] == targets[short_member]) {
+                short_member++;
+            }
+            member = short_member;
+            kept[short_member]++;
+        }
+    }
+}
+
+//! \param[in] route is the route whose prefix the group is for
+//! \param[in] next_hops are the members (repeats are ignored)
+NextHopGroup::NextHopGroup(const RouterEntry &route, const vector<NextHop> &next_hops) {
+    for (const auto &next_hop : next_hops) {
+        const bool repeated = any_of(_members.begin(), _members.end(), [&](const RouterEntry &member) {
+            return NextHop{member.next_hop, member.interface_num} == next_hop;
+        });
+        if (not repeated) {
+            _add_member(route, next_hop);
+        }
+    }
+    if (_members.empty() or _members.size() > MAX_MEMBERS) {
+        throw invalid_argument("a NextHopGroup needs between 1 and " + to_string(MAX_MEMBERS) + " next hops");
+    }
+
+    _buckets.assign(BUCKETS, NO_MEMBER);
+    _rebalance();
+}
+
+//! \param[in] next_hop is the member to add
+NextHopGroup NextHopGroup::with(const NextHop &next_hop) const {
+    NextHopGroup group(*this);
+    for (const auto &member : _members) {
+        if (NextHop{member.next_hop, member.interface_num} == next_hop) {
+            return group;
+        }
+    }
+    if (_members.size() == MAX_MEMBERS) {
+        throw invalid_argument("a NextHopGroup can't have more than " + to_string(MAX_MEMBERS) + " next hops");
+    }
+
+    group._add_member(_members.front(), next_hop);
+    group._rebalance();
+    return group;
+}
+
+//! \param[in] next_hop is the member to remove
+NextHopGroup NextHopGroup::without(const NextHop &next_hop) const {
+    size_t removed = 0;
+    while (removed < _members.size() and
+           not(NextHop{_members[removed].next_hop, _members[removed].interface_num} == next_hop)) {
+        removed++;
+    }
+    if (removed == _members.size()) {
+        return *this;
+    }
+    if (_members.size() == 1) {
+        throw invalid_argument("can't remove the last next hop of a NextHopGroup");
+    }
+
+    // the removed member's buckets are freed, and the members after it move down one place
+    NextHopGroup group;
+    for (size_t i = 0; i < _members.size(); i++) {
+        if (i != removed) {
+            group._members.push_back(_members[i]);
+        }
+    }
+    group._buckets = _buckets;
+    for (uint16_t &member : group._buckets) {
+        member = member == removed ? NO_MEMBER : member > removed ? member - 1 : member;
+    }
+    group._rebalance();
+    return group;
+}
@@ -0,0 +1,77 @@
+#ifndef SPONGE_LIBSPONGE_NEXT_HOP_GROUP_HH
+#define SPONGE_LIBSPONGE_NEXT_HOP_GROUP_HH
+
+#include "route_table.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+//! One of the ways a route can send a datagram
+struct NextHop {
+    std::optional<Address> address{};  //!< The next hop's IP address (empty if the network is directly attached)
+    size_t interface_num = 0;          //!< The interface to send by
+
+    //! Same next hop and interface?
+    bool operator==(const NextHop &other) const {
+        return address == other.address and interface_num == other.interface_num;
+    }
+};
+
+//! \brief The next hops of a multipath (ECMP) route, with a table of buckets that assigns each flow to one
+class NextHopGroup {
+  public:
+    static constexpr size_t BUCKETS = 256;      //!< Number of buckets flows are hashed into
+    static constexpr size_t MAX_MEMBERS = 256;  //!< Largest number of next hops (one bucket each)
+
+  private:
+    static constexpr uint16_t NO_MEMBER = UINT16_MAX;  //!< A bucket not yet assigned (while rebalancing)
+
+    std::vector<RouterEntry> _members{};  //!< One single-path route per next hop, all for the group's prefix
+    std::vector<uint16_t> _buckets{};     //!< Index in `_members` of each bucket's next hop
+
+    static_assert(BUCKETS == 256, "select() picks a bucket with the top 8 bits of a hash");
+
+    //! An empty group
+    NextHopGroup() = default;
+
+    //! Append a member for the prefix of `route`
+    void _add_member(const RouterEntry &route, const NextHop &next_hop);
+
+    //! Give unassigned buckets, and buckets beyond their members' fair shares, to members short of theirs
+    void _rebalance();
+
+  public:
+    //! \brief A group spreading flows evenly across `next_hops` (at least one, and at most MAX_MEMBERS)
+    NextHopGroup(const RouterEntry &route, const std::vector<NextHop> &next_hops);
+
+    //! \brief This group plus `next_hop`, which takes its share of buckets from the others (and no more)
+    //! \returns a copy of this group if `next_hop` is a member already
+    NextHopGroup with(const NextHop &next_hop) const;
+
+    //! \brief This group without `next_hop`, whose buckets (and only those) go to the others
+    //! \returns a copy of this group if `next_hop` isn't a member
+    NextHopGroup without(const NextHop &next_hop) const;
+
+    //! \brief The member that a flow with hash `flow_hash` (see FlowHash) is sent to
+    const RouterEntry &select(const uint32_t flow_hash) const {
+        // (the top bits of a multiplicative hash, so the choice doesn't follow the receive queue's low bits)
+        return _members[_buckets[(flow_hash * uint32_t{0x9e3779b1}) >> 24]];
+    }
+
+    //! The members (each a single-path route for the group's prefix)
+    const std::vector<RouterEntry> &members() const { return _members; }
+
+    //! Index in members() of each bucket's next hop
+    const std::vector<uint16_t> &buckets() const { return _buckets; }
+};
+
+//! \class NextHopGroup
+//! This is resilient hashing: a flow hashes to one of a fixed number of buckets, and each bucket is
+//! assigned to a member. Adding a member moves only the buckets it needs for its fair share (about
+//! 1/n of the flows), and removing one moves only the buckets it had, so every other flow stays on
+//! the same next hop, and its datagrams stay in order. A group never changes once made; a route's
+//! group is replaced, with a new version of the routes (see RouteTable), when its members change.
+
+#endif  // SPONGE_LIBSPONGE_NEXT_HOP_GROUP_HH
@@ -0,0 +1,167 @@
+#include "qdisc.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+
+using namespace std;
+
+//! \param[in] config is the discipline and its parameters
+Qdisc::Qdisc(const Config &config) : _config(config), _flows() {
+    if (_config.limit == 0 or _config.flows == 0 or _config.quantum == 0 or _config.interval_ms == 0) {
+        throw invalid_argument("Qdisc limit, flows, quantum and interval must not be zero");
+    }
+    const bool per_flow = _config.discipline == Discipline::Drr or _config.discipline == Discipline::FqCoDel;
+    _flows.resize(per_flow ? _config.flows : 1);
+}
+
+//! \param[in] frame is the frame to queue
+//! \param[in] flow_hash is the hash of its flow (which picks its bucket)
+//! \param[in] now is the time, in milliseconds
+bool Qdisc::enqueue(EthernetFrame &&frame, const uint32_t flow_hash, const uint64_t now) {
+    if (_stats.backlog >= _config.limit) {
+        // a single queue drops the arrival; with flows, the flow hogging the most room pays instead
+        _stats.dropped_overlimit++;
+        if (_flows.size() == 1) {
+            return false;
+        }
+        _drop_from_fattest();
+    }
+
+    const size_t flow_num = flow_hash % _flows.size();
+    Flow &flow = _flows[flow_num];
+    const size_t size = frame.payload().size();
+    flow.frames.push_back({move(frame), now, size});
+    flow.bytes += size;
+    if (not flow.active) {
+        flow.active = true;
+        flow.deficit = static_cast<int64_t>(_config.quantum);
+        (_config.discipline == Discipline::FqCoDel ? _new_flows : _old_flows).push_back(flow_num);
+    }
+
+    _stats.enqueued++;
+    _stats.backlog++;
+    _stats.backlog_bytes += size;
+    _stats.max_backlog = max(_stats.max_backlog, _stats.backlog);
+    return true;
+}
+
+//! \param[in] now is the time, in milliseconds
+std::optional<EthernetFrame> Qdisc::dequeue(const uint64_t now) {
+    while (not _new_flows.empty() or not _old_flows.empty()) {
+        auto &list = _new_flows.empty() ? _old_flows : _new_flows;
+        const size_t flow_num = list.front();
+        Flow &flow = _flows[flow_num];
+
+        // a flow that has used up its quantum waits for the next round
+        if (flow.deficit <= 0) {
+            flow.deficit += static_cast<int64_t>(_config.quantum);
+            list.pop_front();
+            _old_flows.push_back(flow_num);
+            continue;
+        }
+
+        auto queued = _dequeue(flow, now);
+        if (not queued) {
+            // an emptied new flow goes round once more as an old one, so it can't jump the queue again at once
+            list.pop_front();
+            if (&list == &_new_flows and not _old_flows.empty()) {
+                _old_flows.push_back(flow_num);
+            } else {
+                flow.active = false;
+            }
+            continue;
+        }
+
+        flow.deficit -= static_cast<int64_t>(queued->size);
+        const uint64_t sojourn = now - queued->enqueued_at;
+        _stats.dequeued++;
+        _stats.total_sojourn_ms += sojourn;
+        _stats.max_sojourn_ms = max(_stats.max_sojourn_ms, sojourn);
+        return move(queued->frame);
+    }
+    return nullopt;
+}
+
+//! \param[in] flow is the flow to take from
+//! \param[in] now is the time, in milliseconds
+//! \param[out] ok_to_drop is set if the sojourn time has been above target for at least an interval
+std::optional<Qdisc::Queued> Qdisc::_pop(Flow &flow, const uint64_t now, bool &ok_to_drop) {
+    ok_to_drop = false;
+    if (flow.frames.empty()) {
+        flow.first_above = 0;
+        return nullopt;
+    }
+
+    Queued queued = move(flow.frames.front());
+    flow.frames.pop_front();
+    flow.bytes -= queued.size;
+    _stats.backlog--;
+    _stats.backlog_bytes -= queued.size;
+
+    if (now - queued.enqueued_at < _config.target_ms or flow.bytes <= MAX_FRAME_BYTES) {
+        flow.first_above = 0;
+    } else if (flow.first_above == 0) {
+        flow.first_above = now + _config.interval_ms;
+    } else if (now >= flow.first_above) {
+        ok_to_drop = true;
+    }
+    return queued;
+}
+
+//! \param[in] flow is the flow to take from
+//! \param[in] now is the time, in milliseconds
+std::optional<Qdisc::Queued> Qdisc::_dequeue(Flow &flow, const uint64_t now) {
+    bool ok_to_drop = false;
+    auto queued = _pop(flow, now, ok_to_drop);
+    if (_config.discipline != Discipline::CoDel and _config.discipline != Discipline::FqCoDel) {
+        return queued;
+    }
+
+    // drops come at intervals shrinking with the square root of the drops so far (RFC 8289's control law)
+    const auto control_law = [&](const uint64_t t) {
+        return t + max(uint64_t{1}, static_cast<uint64_t>(_config.interval_ms / sqrt(flow.count)));
+    };
+
+    if (not queued) {
+        flow.dropping = false;
+    } else if (flow.dropping) {
+        if (not ok_to_drop) {
+            flow.dropping = false;
+        }
+        while (flow.dropping and now >= flow.drop_next) {
+            _stats.dropped_codel++;
+            flow.count++;
+            queued = _pop(flow, now, ok_to_drop);
+            if (not ok_to_drop) {
+                flow.dropping = false;
+            } else {
+                flow.drop_next = control_law(flow.drop_next);
+            }
+        }
+    } else if (ok_to_drop) {
+        // enter the dropping state, resuming at about the old rate if it was left only recently
+        _stats.dropped_codel++;
+        queued = _pop(flow, now, ok_to_drop);
+        flow.dropping = true;
+        const uint32_t delta = flow.count - flow.last_count;
+        const auto since_drop_next = static_cast<int64_t>(now - flow.drop_next);
+        const bool recently = since_drop_next < static_cast<int64_t>(16 * _config.interval_ms);
+        flow.count = (delta > 1 and recently) ? delta : 1;
+        flow.drop_next = control_law(now);
+        flow.last_count = flow.count;
+    }
+    return queued;
+}
+
+void Qdisc::_drop_from_fattest() {
+    const auto fattest = max_element(_flows.begin(), _flows.end(), [](const Flow &a, const Flow &b) {
+        return make_pair(a.bytes, a.frames.size()) < make_pair(b.bytes, b.frames.size());
+    });
+    const size_t size = fattest->frames.front().size;
+    fattest->frames.pop_front();
+    fattest->bytes -= size;
+    _stats.backlog--;
+    _stats.backlog_bytes -= size;
+}
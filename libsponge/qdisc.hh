@@ -0,0 +1,117 @@
+#ifndef SPONGE_LIBSPONGE_QDISC_HH
+#define SPONGE_LIBSPONGE_QDISC_HH
+
+#include "ethernet_frame.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <vector>
+
+//! \brief A queueing discipline ("qdisc"): holds the frames a NetworkInterface sends until the link takes them,
+//! deciding which goes next and which to drop
+class Qdisc {
+  public:
+    //! How frames are queued, served and dropped
+    enum class Discipline {
+        Fifo,    //!< One queue, first in first out, dropping arrivals once `limit` frames wait
+        Drr,     //!< A queue per flow bucket, served `quantum` bytes at a time by deficit round robin
+        CoDel,   //!< One queue, dropping frames while their sojourn time stays above `target_ms` (RFC 8289)
+        FqCoDel  //!< Drr with CoDel on each flow's queue, serving flows that have just started first (RFC 8290)
+    };
+
+    //! \brief The discipline and its parameters
+    struct Config {
+        Discipline discipline = Discipline::FqCoDel;
+        size_t limit = 10240;        //!< Most frames waiting, in all queues together
+        size_t flows = 1024;         //!< Flow buckets (Drr and FqCoDel; the others have one queue)
+        size_t quantum = 1514;       //!< Bytes a flow may send per round (Drr and FqCoDel)
+        uint64_t target_ms = 5;      //!< Sojourn time CoDel tolerates standing in a queue
+        uint64_t interval_ms = 100;  //!< How long the sojourn time must stay above target before CoDel drops
+    };
+
+    //! \brief Counts of what the qdisc has done, and how long frames waited in it
+    struct Stats {
+        uint64_t enqueued = 0;           //!< Frames accepted
+        uint64_t dequeued = 0;           //!< Frames handed to the link
+        uint64_t dropped_overlimit = 0;  //!< Frames dropped because `limit` frames were waiting
+        uint64_t dropped_codel = 0;      //!< Frames dropped by CoDel
+        size_t backlog = 0;              //!< Frames waiting now
+        size_t backlog_bytes = 0;        //!< Bytes (of frame payload) waiting now
+        size_t max_backlog = 0;          //!< Most frames ever waiting at once
+        uint64_t total_sojourn_ms = 0;   //!< Sum of the time each dequeued frame waited
+        uint64_t max_sojourn_ms = 0;     //!< Longest time a dequeued frame waited
+    };
+
+  private:
+    static constexpr size_t MAX_FRAME_BYTES = 1500;  //!< CoDel never drops from a queue holding at most this
+
+    //! A frame, and when it arrived
+    struct Queued {
+        EthernetFrame frame;
+        uint64_t enqueued_at;
+        size_t size;  //!< Bytes of the frame's payload
+    };
+
+    //! One flow bucket's queue, with its round-robin and CoDel state
+    struct Flow {
+        std::deque<Queued> frames{};
+        size_t bytes = 0;             //!< Bytes queued
+        int64_t deficit = 0;          //!< Bytes it may still send this round
+        bool active = false;          //!< Is it on one of the round-robin lists?
+        bool dropping = false;        //!< Is CoDel in its dropping state?
+        uint64_t first_above = 0;     //!< When the sojourn time, if it stays above target, allows dropping (or 0)
+        uint64_t drop_next = 0;       //!< When CoDel drops next, while dropping
+        uint32_t count = 0;           //!< Drops since CoDel entered the dropping state
+        uint32_t last_count = 0;      //!< `count` when it last entered the dropping state
+    };
+
+    Config _config;
+    std::vector<Flow> _flows;
+    std::deque<size_t> _new_flows{};  //!< Flows that just became active (FqCoDel serves these first)
+    std::deque<size_t> _old_flows{};  //!< The other active flows
+    Stats _stats{};
+
+    //! Take the frame at the head of `flow`, and say whether CoDel may drop it
+    std::optional<Queued> _pop(Flow &flow, const uint64_t now, bool &ok_to_drop);
+
+    //! Take the next frame from `flow` that CoDel (if enabled) doesn't drop
+    std::optional<Queued> _dequeue(Flow &flow, const uint64_t now);
+
+    //! Drop the frame at the head of the flow with the most bytes queued
+    void _drop_from_fattest();
+
+  public:
+    //! \brief An empty qdisc
+    explicit Qdisc(const Config &config);
+
+    //! \brief Queue `frame`, of the flow whose hash is `flow_hash` (see FlowHash), at time `now` (in ms)
+    //! \returns `false` if the frame was dropped instead
+    bool enqueue(EthernetFrame &&frame, const uint32_t flow_hash, const uint64_t now);
+
+    //! \brief The next frame to send at time `now` (in ms), or nothing if no frames are waiting
+    std::optional<EthernetFrame> dequeue(const uint64_t now);
+
+    //! \brief Number of frames waiting
+    size_t size() const { return _stats.backlog; }
+
+    //! \brief The discipline and its parameters
+    const Config &config() const { return _config; }
+
+    //! \brief What the qdisc has done so far
+    const Stats &stats() const { return _stats; }
+};
+
+//! \class Qdisc
+//! All four disciplines share one mechanism: frames are hashed into flow buckets (of which Fifo and
+//! CoDel have just one), and active buckets are served by deficit round robin. A bucket that becomes
+//! active joins the list of new flows (FqCoDel) or the end of the list of old flows (Drr), and leaves
+//! once its queue is empty. Each bucket may also run CoDel, which drops from the head of its queue
+//! while the sojourn time of the frames it serves has stayed above `target_ms` for `interval_ms`,
+//! more often the longer that lasts. Once `limit` frames are waiting, a single queue drops arrivals,
+//! while per-flow disciplines drop from the head of the flow with the most bytes queued.
+//!
+//! Times are the NetworkInterface's clock (advanced by tick()), so they are only as fine as its ticks.
+
+#endif  // SPONGE_LIBSPONGE_QDISC_HH
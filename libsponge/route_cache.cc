@@ -0,0 +1,12 @@
+#include "route_cache.hh"
+
+#include <stdexcept>
+
+using namespace std;
+
+//! \param[in] capacity is the number of entries
+RouteCache::RouteCache(const size_t capacity) : _entries(capacity), _mask(capacity - 1) {
+    if (capacity == 0 or (capacity & (capacity - 1)) or capacity > (size_t{1} << 31)) {
+        throw runtime_error("RouteCache: capacity must be a power of two");
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef SPONGE_LIBSPONGE_ROUTE_CACHE_HH
+#define SPONGE_LIBSPONGE_ROUTE_CACHE_HH
+
+#include "route_table.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//! \brief A small direct-mapped cache of the routes of recently seen destinations
+class RouteCache {
+    //! One cached lookup
+    struct Entry {
+        uint64_t generation = 0;             //!< RouteTable::Snapshot::generation() of the lookup (0 if unused)
+        uint32_t destination = 0;            //!< The address looked up
+        const RouterEntry *route = nullptr;  //!< Its route (nullptr if it had none)
+    };
+
+    std::vector<Entry> _entries;
+    uint32_t _mask;
+    uint64_t _hits = 0;
+    uint64_t _misses = 0;
+
+    //! The entry `destination` is cached in
+    Entry &_entry(const uint32_t destination) {
+        const uint32_t hash = destination * 0x9e3779b1;  // (spreads neighbouring addresses across the cache)
+        return _entries[(hash ^ (hash >> 16)) & _mask];
+    }
+
+  public:
+    static constexpr size_t DEFAULT_CAPACITY = 4096;  //!< Default number of entries
+
+    //! \brief An empty cache of `capacity` entries (a power of two)
+    explicit RouteCache(const size_t capacity = DEFAULT_CAPACITY);
+
+    //! \brief Look up `destination` in the cache, counting a hit or a miss
+    //! \returns `true` (and sets `route`) if `destination` was cached from the snapshot of `generation`
+    bool find(const uint32_t destination, const uint64_t generation, const RouterEntry *&route) {
+        const Entry &entry = _entry(destination);
+        if (entry.generation == generation and entry.destination == destination) {
+            _hits++;
+            route = entry.route;
+            return true;
+        }
+        _misses++;
+        return false;
+    }
+
+    //! Cache the route of `destination` in the snapshot of `generation`, replacing whatever shared its entry
+    void insert(const uint32_t destination, const uint64_t generation, const RouterEntry *route) {
+        _entry(destination) = {generation, destination, route};
+    }
+
+    //! Number of entries
+    size_t capacity() const { return _entries.size(); }
+
+    //! Number of lookups answered from the cache
+    uint64_t hits() const { return _hits; }
+
+    //! Number of lookups not answered from the cache
+    uint64_t misses() const { return _misses; }
+};
+
+//! \class RouteCache
+//! Each cached route is tagged with the generation of the RouteTable snapshot it was found in, so
+//! publishing any change to the routes invalidates the whole cache at once, and nothing else does.
+//! A route is a pointer into its snapshot, which is only reused once a newer snapshot (with a newer
+//! generation) has been published, so a cached pointer is never followed after its snapshot changes.
+
+#endif  // SPONGE_LIBSPONGE_ROUTE_CACHE_HH
@@ -0,0 +1,127 @@
+#include "route_table.hh"
+
+#include <algorithm>
+#include <array>
+#include <thread>
+
+using namespace std;
+
+void RouteTable::Snapshot::_add(const RouterEntry &route) {
+    const uint32_t slot = _free_slots.empty() ? _routes.size() : _free_slots.back();
+    if (not _lpm.insert(route.route_prefix, route.prefix_length, slot)) {
+        return;
+    }
+
+    if (slot == _routes.size()) {
+        _routes.emplace_back(route);
+    } else {
+        _free_slots.pop_back();
+        _routes[slot].emplace(route);
+    }
+}
+
+void RouteTable::Snapshot::_remove(const uint32_t route_prefix, const uint8_t prefix_length) {
+    const auto slot = _lpm.find(route_prefix, prefix_length);
+    if (slot) {
+        _lpm.erase(route_prefix, prefix_length);
+        _routes[*slot].reset();
+        _free_slots.push_back(*slot);
+    }
+}
+
+//! \param[in] addresses are the addresses to look up
+//! \param[in] count is the number of addresses
+//! \param[out] routes receives each address's route (or nullptr if it has none)
+void RouteTable::Snapshot::lookup(const uint32_t *addresses, const size_t count, const RouterEntry **routes) const {
+    array<optional<uint32_t>, 32> slots;
+    for (size_t start = 0; start < count; start += slots.size()) {
+        const size_t n = min(slots.size(), count - start);
+        _lpm.lookup(addresses + start, n, slots.data());
+        for (size_t i = 0; i < n; i++) {
+            routes[start + i] = slots[i] ? &*_routes[*slots[i]] : nullptr;
+        }
+    }
+}
+
+RouteTable::RouteTable() : _current(&_snapshots[0]) {}
+
+//! \param[in] route_prefix is the prefix of the route to remove
+//! \param[in] prefix_length is its length
+void RouteTable::remove(const uint32_t route_prefix, const uint8_t prefix_length) {
+    _pending.push_back({{route_prefix, prefix_length, LpmTable::mask(prefix_length), {}, 0}, true});
+}
+
+void RouteTable::_wait_for_readers() {
+    lock_guard<mutex> lock(_readers_mutex);
+    for (const auto &reader : _readers) {
+        // a reader that entered before the standby snapshot was retired may still be using it
+        while (true) {
+            const uint64_t epoch = reader->epoch.load(memory_order_seq_cst);
+            if (epoch == 0 or epoch >= _retired_epoch) {
+                break;
+            }
+            this_thread::yield();
+        }
+    }
+}
+
+void RouteTable::publish() {
+    if (_pending.empty()) {
+        return;
+    }
+
+    Snapshot &standby = _current.load(memory_order_relaxed) == &_snapshots[0] ? _snapshots[1] : _snapshots[0];
+    _wait_for_readers();
+
+    // catch the standby snapshot up with the current one, then make the new changes
+    for (const auto &updates : {&_unapplied, &_pending}) {
+        for (const auto &update : *updates) {
+            if (update.remove) {
+                standby._remove(update.route.route_prefix, update.route.prefix_length);
+            } else {
+                standby._add(update.route);
+            }
+        }
+    }
+
+    // a reader that enters after the epoch advances is sure to see the new snapshot
+    standby._generation = _epoch.load(memory_order_relaxed) + 1;
+    _current.store(&standby, memory_order_seq_cst);
+    _retired_epoch = _epoch.fetch_add(1, memory_order_seq_cst) + 1;
+
+    _unapplied = move(_pending);
+    _pending.clear();
+}
+
+//! \param[in] table is the table to read
+//! \param[in] slot is the reader's announcement of its epoch
+RouteTable::ReadGuard::ReadGuard(RouteTable &table, ReaderSlot &slot) : _slot(&slot), _snapshot(nullptr) {
+    // announce the epoch before taking the snapshot (see RouteTable::publish, which does the reverse)
+    _slot->epoch.store(table._epoch.load(memory_order_seq_cst), memory_order_seq_cst);
+    _snapshot = table._current.load(memory_order_seq_cst);
+}
+
+//! \param[in] table is the table to read
+RouteTable::Reader::Reader(RouteTable &table) : _table(&table), _slot(nullptr) {
+    lock_guard<mutex> lock(table._readers_mutex);
+    for (const auto &slot : table._readers) {
+        bool in_use = false;
+        if (slot->in_use.compare_exchange_strong(in_use, true)) {
+            _slot = slot.get();
+            return;
+        }
+    }
+    table._readers.push_back(make_unique<ReaderSlot>());
+    _slot = table._readers.back().get();
+}
+
+RouteTable::Reader::~Reader() {
+    if (_slot) {
+        _slot->epoch.store(0, memory_order_release);
+        _slot->in_use.store(false, memory_order_release);
+    }
+}
+
+RouteTable::Reader::Reader(Reader &&other) noexcept : _table(other._table), _slot(other._slot) {
+    other._slot = nullptr;
+}
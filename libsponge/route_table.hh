@@ -0,0 +1,195 @@
+#ifndef SPONGE_LIBSPONGE_ROUTE_TABLE_HH
+#define SPONGE_LIBSPONGE_ROUTE_TABLE_HH
+
+#include "address.hh"
+#include "lpm_table.hh"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+class NextHopGroup;
+
+// Define a struct used for entries in Router class
+struct RouterEntry
+    {
+        const uint32_t route_prefix;
+        const uint8_t prefix_length;
+        const uint32_t prefix_mask;
+        const std::optional<Address> next_hop;
+        const size_t interface_num;
+
+        //! For a multipath route, its next hops (and then `next_hop` and `interface_num` are its first one's)
+        const std::shared_ptr<const NextHopGroup> multipath{};
+    };
+
+//! \brief The routes of a Router, which can be changed while other threads look routes up
+class RouteTable {
+  public:
+    //! \brief One published version of the routes, which never changes while anyone may be reading it
+    class Snapshot {
+        LpmTable _lpm{};                                    //!< Maps each prefix to its slot in `_routes`
+        std::vector<std::optional<RouterEntry>> _routes{};  //!< The routes, by slot
+        std::vector<uint32_t> _free_slots{};                //!< Empty slots in `_routes`
+        uint64_t _generation = 1;                           //!< Changes whenever this snapshot is published
+
+        friend class RouteTable;
+
+        //! Add `route` (unless its prefix is present already)
+        void _add(const RouterEntry &route);
+
+        //! Remove the route for a prefix (if present)
+        void _remove(const uint32_t route_prefix, const uint8_t prefix_length);
+
+      public:
+        //! \brief The route with the longest prefix matching `address`, or nullptr if none does
+        const RouterEntry *lookup(const uint32_t address) const {
+            const auto slot = _lpm.lookup(address);
+            return slot ? &*_routes[*slot] : nullptr;
+        }
+
+        //! \brief The route for exactly this prefix, or nullptr if there is none
+        const RouterEntry *find(const uint32_t route_prefix, const uint8_t prefix_length) const {
+            const auto slot = _lpm.find(route_prefix, prefix_length);
+            return slot ? &*_routes[*slot] : nullptr;
+        }
+
+        //! \brief Look up `count` addresses at once (see LpmTable::lookup), storing each one's route or nullptr
+        void lookup(const uint32_t *addresses, const size_t count, const RouterEntry **routes) const;
+
+        //! Number of routes
+        size_t size() const { return _lpm.size(); }
+
+        //! \brief Identifies this version of the routes: no two published versions have the same generation
+        //! \details A route looked up in a snapshot stays valid as long as the current snapshot's generation
+        //! is the same (see RouteCache).
+        uint64_t generation() const { return _generation; }
+    };
+
+  private:
+    //! A change queued by add() or remove()
+    struct Update {
+        RouterEntry route;  //!< The route added (or, for a removal, its prefix)
+        bool remove;        //!< Is this a removal?
+    };
+
+    //! A reader thread's announcement of the epoch it entered in (0 when it isn't reading)
+    struct alignas(64) ReaderSlot {
+        std::atomic<uint64_t> epoch{0};  //!< The epoch of the reader's ReadGuard, if it has one
+        std::atomic<bool> in_use{true};  //!< Does a Reader own this slot?
+    };
+
+    std::array<Snapshot, 2> _snapshots{};    //!< The current version, and the one being updated
+    std::atomic<const Snapshot *> _current;  //!< The snapshot readers should use
+    std::atomic<uint64_t> _epoch{1};         //!< Incremented by every publish()
+    uint64_t _retired_epoch = 0;             //!< The standby snapshot was retired when `_epoch` became this
+    std::vector<Update> _pending{};          //!< Changes not yet published
+    std::vector<Update> _unapplied{};        //!< Changes published, but not yet made to the standby snapshot
+
+    std::mutex _readers_mutex{};                          //!< Guards `_readers` (not taken by lookups)
+    std::vector<std::unique_ptr<ReaderSlot>> _readers{};  //!< One slot per registered Reader
+
+    //! Wait until no reader can still be using the standby snapshot
+    void _wait_for_readers();
+
+  public:
+    //! \brief A scope in which a Reader uses the current snapshot, which stays valid until the scope ends
+    class ReadGuard {
+        ReaderSlot *_slot;
+        const Snapshot *_snapshot;
+
+      public:
+        //! Enter the current epoch, and take the current snapshot
+        ReadGuard(RouteTable &table, ReaderSlot &slot);
+
+        //! Leave the epoch, so the writer may reuse the snapshot
+        ~ReadGuard() { _slot->epoch.store(0, std::memory_order_release); }
+
+        //! The snapshot
+        const Snapshot &table() const { return *_snapshot; }
+
+        //! \name
+        //! A ReadGuard cannot be copied or moved
+        //!@{
+        ReadGuard(const ReadGuard &other) = delete;
+        ReadGuard &operator=(const ReadGuard &other) = delete;
+        //!@}
+    };
+
+    //! \brief One thread's handle for reading the table (from any thread, but by one thread at a time)
+    class Reader {
+        RouteTable *_table;
+        ReaderSlot *_slot;
+
+      public:
+        //! Register a reader of `table`
+        explicit Reader(RouteTable &table);
+
+        //! Unregister
+        ~Reader();
+
+        //! \brief Use the current snapshot until the returned guard is destroyed
+        //! \note A Reader must not hold more than one ReadGuard at a time.
+        ReadGuard read() const { return {*_table, *_slot}; }
+
+        //! \name
+        //! A Reader can be moved, but not copied
+        //!@{
+        Reader(Reader &&other) noexcept;
+        Reader &operator=(Reader &&other) = delete;
+        Reader(const Reader &other) = delete;
+        Reader &operator=(const Reader &other) = delete;
+        //!@}
+    };
+
+    //! An empty table
+    RouteTable();
+
+    //! \name Writing
+    //! Only one thread may write, but it needn't stop the readers.
+    //!@{
+
+    //! \brief Queue the addition of a route (ignored if a route for the same prefix is present when published)
+    void add(const RouterEntry &route) { _pending.push_back({route, false}); }
+
+    //! \brief Queue the removal of the route for a prefix
+    void remove(const uint32_t route_prefix, const uint8_t prefix_length);
+
+    //! \brief Make every queued change visible to readers at once
+    //! \details Waits (without blocking readers) for readers still using the previous-but-one version.
+    void publish();
+
+    //! The current snapshot, for use by the writing thread only
+    const Snapshot &current() const { return *_current.load(std::memory_order_relaxed); }
+    //!@}
+
+    //! Register a reader
+    Reader reader() { return Reader(*this); }
+
+    //! \name
+    //! A RouteTable cannot be copied or moved (its readers refer to it)
+    //!@{
+    RouteTable(const RouteTable &other) = delete;
+    RouteTable &operator=(const RouteTable &other) = delete;
+    RouteTable(RouteTable &&other) = delete;
+    RouteTable &operator=(RouteTable &&other) = delete;
+    //!@}
+};
+
+//! \class RouteTable
+//! This is read-copy-update with two copies ("left-right"): readers use the current snapshot
+//! while the writer applies changes to the standby one, then publish() swaps them with one
+//! atomic store. Nothing is rebuilt from scratch; each change is made to each copy once, the
+//! second time after the swap that follows.
+//!
+//! Reclamation is epoch-based. A ReadGuard announces the epoch it entered in, and publish()
+//! advances the epoch, so the snapshot retired at epoch E is free to change again once every
+//! reader is outside a ReadGuard or entered at E or later. Lookups take no locks and never
+//! wait; only publish() does, and only for readers already inside a ReadGuard.
+
+#endif  // SPONGE_LIBSPONGE_ROUTE_TABLE_HH
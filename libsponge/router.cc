@@ -1,6 +1,12 @@
 #include "router.hh"
 
-#include <iostream>
+#include "flow_hash.hh"
+#include "tracepoint.hh"
+#include "util.hh"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
 
 using namespace std;
 
@@ -26,17 +32,144 @@ void Router::add_route(const uint32_t route_prefix,
                        const uint8_t prefix_length,
                        const optional<Address> next_hop,
                        const size_t interface_num) {
-    cerr << "DEBUG: adding route " << Address::from_ipv4_numeric(route_prefix).ip() << "/" << int(prefix_length)
-         << " => " << (next_hop.has_value() ? next_hop->ip() : "(direct)") << " on interface " << interface_num << "\n";
-    
+    SPONGE_TRACEPOINT(TraceEvent::RouteAdd, route_prefix, prefix_length, interface_num);
+
     const uint32_t prefix_mask = prefix_length == 0 ? 0 : numeric_limits<int>::min() >> (prefix_length-1);
     RouterEntry new_entry{route_prefix, prefix_length, prefix_mask, next_hop, interface_num};
-    _routing_table.push_back(new_entry);
 
+    // (a prefix with bits set beyond its length can never match, and a repeated one never wins)
+    if ((route_prefix & ~prefix_mask) == 0) {
+        _routing_table.add(new_entry);
+        _routing_table.publish();
+    }
+}
+
+//! A route by the members of `group`, multipath unless it has just one
+static RouterEntry make_route(const NextHopGroup &group) {
+    const RouterEntry &first = group.members().front();
+    if (group.members().size() == 1) {
+        return first;
+    }
+    return {first.route_prefix,
+            first.prefix_length,
+            first.prefix_mask,
+            first.next_hop,
+            first.interface_num,
+            make_shared<const NextHopGroup>(group)};
+}
+
+//! The next hops of `route` (just its own, unless it's multipath)
+static NextHopGroup next_hops_of(const RouterEntry &route) {
+    return route.multipath ? *route.multipath : NextHopGroup(route, {{route.next_hop, route.interface_num}});
+}
+
+//! \param[in] route_prefix The "up-to-32-bit" IPv4 address prefix to match the datagram's destination address against
+//! \param[in] prefix_length The number of high-order bits of the route_prefix that must match
+//! \param[in] next_hops The next hops to spread flows across (and the interface to send to each by)
+void Router::add_route(const uint32_t route_prefix, const uint8_t prefix_length, const vector<NextHop> &next_hops) {
+    const NextHopGroup group({route_prefix, prefix_length, LpmTable::mask(prefix_length), {}, 0}, next_hops);
+    SPONGE_TRACEPOINT(TraceEvent::RouteAdd, route_prefix, prefix_length, group.members().front().interface_num);
+
+    if ((route_prefix & ~LpmTable::mask(prefix_length)) == 0) {
+        _routing_table.add(make_route(group));
+        _routing_table.publish();
+    }
+}
+
+//! \param[in] route_prefix The prefix of the route to remove
+//! \param[in] prefix_length The length of that prefix
+void Router::remove_route(const uint32_t route_prefix, const uint8_t prefix_length) {
+    _routing_table.remove(route_prefix, prefix_length);
+    _routing_table.publish();
+}
+
+//! \param[in] route_prefix The prefix of the route
+//! \param[in] prefix_length The length of that prefix
+//! \param[in] next_hop The next hop to add (and the interface to send to it by)
+void Router::add_next_hop(const uint32_t route_prefix, const uint8_t prefix_length, const NextHop &next_hop) {
+    const RouterEntry *route = _routing_table.current().find(route_prefix, prefix_length);
+    if (not route) {
+        add_route(route_prefix, prefix_length, vector<NextHop>{next_hop});
+        return;
+    }
+
+    // (replaced in one publish, so no lookup sees the prefix missing)
+    const RouterEntry replacement = make_route(next_hops_of(*route).with(next_hop));
+    _routing_table.remove(route_prefix, prefix_length);
+    _routing_table.add(replacement);
+    _routing_table.publish();
+}
+
+//! \param[in] route_prefix The prefix of the route
+//! \param[in] prefix_length The length of that prefix
+//! \param[in] next_hop The next hop to remove (and the interface it was sent to by)
+void Router::remove_next_hop(const uint32_t route_prefix, const uint8_t prefix_length, const NextHop &next_hop) {
+    const RouterEntry *route = _routing_table.current().find(route_prefix, prefix_length);
+    if (not route) {
+        return;
+    }
+
+    const NextHopGroup next_hops = next_hops_of(*route);
+    if (next_hops.members().size() == 1) {
+        if (NextHop{route->next_hop, route->interface_num} == next_hop) {
+            remove_route(route_prefix, prefix_length);
+        }
+        return;
+    }
+
+    const RouterEntry replacement = make_route(next_hops.without(next_hop));
+    _routing_table.remove(route_prefix, prefix_length);
+    _routing_table.add(replacement);
+    _routing_table.publish();
+}
+
+//! \param[in] dgram The datagram to be queued
+void AsyncNetworkInterface::queue_datagram(InternetDatagram &&dgram) {
+    const size_t queue = _datagrams_out.size() == 1 ? 0 : FlowHash::shared()(dgram) % _datagrams_out.size();
+    _datagrams_out[queue].push(move(dgram));
+}
+
+//! \param[in] count The number of queues
+void AsyncNetworkInterface::set_rx_queues(const size_t count) {
+    if (count == 0) {
+        throw invalid_argument("AsyncNetworkInterface needs at least one receive queue");
+    }
+
+    auto old_queues = move(_datagrams_out);
+    _datagrams_out = vector<queue<InternetDatagram>>(count);
+    for (auto &old_queue : old_queues) {
+        while (not old_queue.empty()) {
+            queue_datagram(move(old_queue.front()));
+            old_queue.pop();
+        }
+    }
+}
+
+//! \param[in] table The routes the lane will read
+//! \param[in] cache_capacity The number of entries in its route cache (0 for none)
+Router::Lane::Lane(RouteTable &table, const size_t cache_capacity) : reader(table), route_cache() {
+    if (cache_capacity) {
+        route_cache.emplace(cache_capacity);
+    }
+}
+
+Router::Router() { _lanes.push_back(make_unique<Lane>(_routing_table, 0)); }
+
+//! \param[in] capacity The number of entries in each thread's cache (0 for no cache)
+void Router::set_route_cache(const size_t capacity) {
+    for (auto &lane : _lanes) {
+        lane->route_cache.reset();
+        if (capacity) {
+            lane->route_cache.emplace(capacity);
+        }
+    }
+    _route_cache_capacity = capacity;
 }
 
+//! \param[in] lane The lane (and thread) routing the datagram
 //! \param[in] dgram The datagram to be routed
-void Router::route_one_datagram(InternetDatagram &dgram) {
+//! \param[in] routes The routing table, as of the start of this call to route()
+void Router::route_one_datagram(Lane &lane, InternetDatagram &dgram, const RouteTable::Snapshot &routes) {
     // Check the TTL field for expiratiion
     // Decrement if valid
     if (dgram.header().ttl <= 1)
@@ -46,48 +179,309 @@ void Router::route_one_datagram(InternetDatagram &dgram) {
 
     // Perform LPM
     uint32_t dest = dgram.header().dst;
-    int best_match_idx = -1;
-    int best_match_len = -1;
+    const RouterEntry *best_match = lookup(lane, dest, routes);
 
-    // Iterate through the table
-    for (size_t i = 0; i < _routing_table.size(); i++)
-    {
-        auto mask = _routing_table[i].prefix_mask;
+    SPONGE_TRACEPOINT(TraceEvent::RouteLookup, dest, best_match ? int64_t{best_match->prefix_length} : int64_t{-1});
 
-        if ((dest & mask) == _routing_table[i].route_prefix && best_match_len < _routing_table[i].prefix_length)
-        {
-            best_match_idx = i;
-            best_match_len = _routing_table[i].prefix_length;
-        }
-    }
-    
     // Drop packet if no match
-    if (best_match_idx == -1)
+    if (not best_match)
     {
         return;
     }
 
+    // A multipath route sends each flow to one of its next hops
+    if (best_match->multipath) {
+        best_match = &best_match->multipath->select(FlowHash::shared()(dgram));
+    }
+
     // Now to forward the packet
-    dgram.header().ttl--;
-    auto next_hop = _routing_table[best_match_idx].next_hop;
-    auto interface_num = _routing_table[best_match_idx].interface_num;
+    forward(dgram, *best_match);
+}
+
+//! \param[in] lane The lane (and thread) looking up the route
+//! \param[in] destination The address to look up
+//! \param[in] routes The routing table, as of the start of this call to route()
+const RouterEntry *Router::lookup(Lane &lane, const uint32_t destination, const RouteTable::Snapshot &routes) {
+    if (not lane.route_cache) {
+        return routes.lookup(destination);
+    }
+
+    const RouterEntry *route = nullptr;
+    if (not lane.route_cache->find(destination, routes.generation(), route)) {
+        route = routes.lookup(destination);
+        lane.route_cache->insert(destination, routes.generation(), route);
+    }
+    return route;
+}
+
+//! Decrement the TTL of `header`, patching its checksum
+static void decrement_ttl(IPv4Header &header) {
+    // (TTL shares a 16-bit header word with the protocol; patch the checksum rather than recompute it)
+    const uint16_t old_ttl_proto = (header.ttl << 8) | header.proto;
+    header.ttl--;
+    header.cksum = InternetChecksum::update_u16(header.cksum, old_ttl_proto, (header.ttl << 8) | header.proto);
+}
+
+//! \param[in] dgram The datagram to be forwarded
+//! \param[in] route The route that matched its destination
+void Router::forward(InternetDatagram &dgram, const RouterEntry &route) {
+    auto &header = dgram.header();
+    decrement_ttl(header);
+    auto next_hop = route.next_hop;
+    auto interface_num = route.interface_num;
     if (next_hop.has_value())
     {
         _interfaces[interface_num].send_datagram(dgram, next_hop.value());
     }
     else
     {
-        _interfaces[interface_num].send_datagram(dgram, Address::from_ipv4_numeric(dest));
+        _interfaces[interface_num].send_datagram(dgram, Address::from_ipv4_numeric(header.dst));
     }
 }
 
-void Router::route() {
-    // Go through all the interfaces, and route every incoming datagram to its proper outgoing interface.
+//! \param[in] lane The lane (and thread) routing `lane.batch`
+//! \param[in] routes The routing table, as of the start of this call to route()
+void Router::look_up_batch(Lane &lane, const RouteTable::Snapshot &routes) {
+    // Drop the datagrams whose TTL has expired, and look up the rest all at once
+    lane.live.clear();
+    lane.destinations.clear();
+    for (size_t i = 0; i < lane.batch.size(); i++) {
+        if (lane.batch[i].header().ttl > 1) {
+            lane.live.push_back(i);
+            lane.destinations.push_back(lane.batch[i].header().dst);
+        }
+    }
+    lane.matches.resize(lane.live.size());
+    if (not lane.route_cache) {
+        routes.lookup(lane.destinations.data(), lane.destinations.size(), lane.matches.data());
+    } else {
+        // answer what the cache can, and look up the rest together
+        lane.uncached.clear();
+        lane.uncached_destinations.clear();
+        for (size_t i = 0; i < lane.live.size(); i++) {
+            if (not lane.route_cache->find(lane.destinations[i], routes.generation(), lane.matches[i])) {
+                lane.uncached.push_back(i);
+                lane.uncached_destinations.push_back(lane.destinations[i]);
+            }
+        }
+        lane.uncached_matches.resize(lane.uncached.size());
+        routes.lookup(
+            lane.uncached_destinations.data(), lane.uncached_destinations.size(), lane.uncached_matches.data());
+        for (size_t j = 0; j < lane.uncached.size(); j++) {
+            lane.matches[lane.uncached[j]] = lane.uncached_matches[j];
+            lane.route_cache->insert(lane.uncached_destinations[j], routes.generation(), lane.uncached_matches[j]);
+        }
+    }
+
+    // A multipath route sends each flow to one of its next hops
+    for (size_t i = 0; i < lane.live.size(); i++) {
+        if (lane.matches[i] and lane.matches[i]->multipath) {
+            lane.matches[i] = &lane.matches[i]->multipath->select(FlowHash::shared()(lane.batch[lane.live[i]]));
+        }
+    }
+
+    // Group the routed datagrams by egress interface, keeping each interface's in arrival order
+    lane.egress_starts.assign(_interfaces.size() + 1, 0);
+    for (size_t i = 0; i < lane.live.size(); i++) {
+        SPONGE_TRACEPOINT(TraceEvent::RouteLookup,
+                          lane.destinations[i],
+                          lane.matches[i] ? int64_t{lane.matches[i]->prefix_length} : int64_t{-1});
+        if (lane.matches[i]) {
+            lane.egress_starts[lane.matches[i]->interface_num + 1]++;
+        }
+    }
+    for (size_t interface_num = 1; interface_num < lane.egress_starts.size(); interface_num++) {
+        lane.egress_starts[interface_num] += lane.egress_starts[interface_num - 1];
+    }
+    lane.egress_order.resize(lane.egress_starts.back());
+    for (size_t i = 0; i < lane.live.size(); i++) {
+        if (lane.matches[i]) {
+            lane.egress_order[lane.egress_starts[lane.matches[i]->interface_num]++] = i;
+        }
+    }
+}
+
+//! \param[in] threads The number of threads to route on (at least 1)
+void Router::set_threads(const size_t threads) {
+    if (threads == 0) {
+        throw invalid_argument("Router needs at least one thread");
+    }
+
+    stop_workers();
+    while (_lanes.size() > threads) {
+        _lanes.pop_back();
+    }
+    while (_lanes.size() < threads) {
+        _lanes.push_back(make_unique<Lane>(_routing_table, _route_cache_capacity));
+    }
     for (auto &interface : _interfaces) {
-        auto &queue = interface.datagrams_out();
-        while (not queue.empty()) {
-            route_one_datagram(queue.front());
-            queue.pop();
+        interface.set_rx_queues(threads);
+    }
+
+    _stopping = false;
+    for (size_t lane_num = 1; lane_num < threads; lane_num++) {
+        _workers.emplace_back(&Router::run_worker, this, lane_num, _round);
+    }
+}
+
+void Router::stop_workers() {
+    {
+        lock_guard<mutex> lock(_work_mutex);
+        _stopping = true;
+    }
+    _work_changed.notify_all();
+    for (auto &worker : _workers) {
+        worker.join();
+    }
+    _workers.clear();
+}
+
+//! \param[in] lane_num The worker's lane
+//! \param[in] round The last round before the worker started
+void Router::run_worker(const size_t lane_num, uint64_t round) {
+    while (true) {
+        {
+            unique_lock<mutex> lock(_work_mutex);
+            _work_changed.wait(lock, [&] { return _stopping or _round != round; });
+            if (_stopping) {
+                return;
+            }
+            round = _round;
+        }
+
+        route_lane(lane_num);
+
+        {
+            lock_guard<mutex> lock(_work_mutex);
+            _lanes_busy--;
         }
+        _work_changed.notify_all();
+    }
+}
+
+//! \param[in] lane_num The lane to route
+void Router::route_lane(const size_t lane_num) {
+    Lane &lane = *_lanes[lane_num];
+    const auto note_error = [&] {
+        lock_guard<mutex> lock(_work_mutex);
+        if (not _worker_error) {
+            _worker_error = current_exception();
+        }
+    };
+
+    // Route this lane's share of every interface's datagrams (its flows), handing each to its egress queue
+    try {
+        const auto guard = lane.reader.read();
+        const size_t batch_size = max(_batch_size, size_t{1});
+        for (auto &interface : _interfaces) {
+            auto &queue = interface.datagrams_out(lane_num);
+            while (not queue.empty()) {
+                lane.batch.clear();
+                while (not queue.empty() and lane.batch.size() < batch_size) {
+                    lane.batch.push_back(move(queue.front()));
+                    queue.pop();
+                }
+                look_up_batch(lane, guard.table());
+
+                for (const size_t i : lane.egress_order) {
+                    const RouterEntry &route = *lane.matches[i];
+                    Departure departure{move(lane.batch[lane.live[i]]), 0};
+                    decrement_ttl(departure.dgram.header());
+                    departure.next_hop = route.next_hop ? route.next_hop->ipv4_numeric() : departure.dgram.header().dst;
+
+                    // (while the queue is full, send what's queued for this lane's interfaces, so lanes can't deadlock)
+                    while (not _egress[route.interface_num]->try_push(departure)) {
+                        send_departures(lane_num);
+                        this_thread::yield();
+                    }
+                }
+                send_departures(lane_num);
+            }
+        }
+    } catch (...) {
+        note_error();
+    }
+
+    // Send for this lane's interfaces until every lane is done routing (and so pushing)
+    _lanes_routed.fetch_add(1, memory_order_release);
+    try {
+        while (true) {
+            const bool all_routed = _lanes_routed.load(memory_order_acquire) == _lanes.size();
+            send_departures(lane_num);
+            if (all_routed) {
+                break;
+            }
+            this_thread::yield();
+        }
+    } catch (...) {
+        note_error();
+    }
+}
+
+//! \param[in] lane_num The lane whose interfaces to send for
+void Router::send_departures(const size_t lane_num) {
+    Departure departure;
+    for (size_t interface_num = lane_num; interface_num < _interfaces.size(); interface_num += _lanes.size()) {
+        while (_egress[interface_num]->try_pop(departure)) {
+            _interfaces[interface_num].send_datagram(departure.dgram, Address::from_ipv4_numeric(departure.next_hop));
+        }
+    }
+}
+
+void Router::route() {
+    if (_lanes.size() == 1) {
+        // (routes published while this runs take effect next time)
+        Lane &lane = *_lanes[0];
+        const auto guard = lane.reader.read();
+
+        // Go through all the interfaces, and route every incoming datagram to its proper outgoing interface.
+        for (auto &interface : _interfaces) {
+            for (size_t queue_num = 0; queue_num < interface.rx_queues(); queue_num++) {
+                auto &queue = interface.datagrams_out(queue_num);
+                if (_batch_size <= 1) {
+                    while (not queue.empty()) {
+                        route_one_datagram(lane, queue.front(), guard.table());
+                        queue.pop();
+                    }
+                    continue;
+                }
+
+                while (not queue.empty()) {
+                    lane.batch.clear();
+                    while (not queue.empty() and lane.batch.size() < _batch_size) {
+                        lane.batch.push_back(move(queue.front()));
+                        queue.pop();
+                    }
+                    look_up_batch(lane, guard.table());
+
+                    // Send each interface's datagrams together
+                    for (const size_t i : lane.egress_order) {
+                        forward(lane.batch[lane.live[i]], *lane.matches[i]);
+                    }
+                }
+            }
+        }
+        return;
+    }
+
+    // Route on every lane at once, and wait for the workers to finish
+    while (_egress.size() < _interfaces.size()) {
+        _egress.push_back(make_unique<MpscQueue<Departure>>(EGRESS_QUEUE_CAPACITY));
+    }
+    _lanes_routed.store(0, memory_order_relaxed);
+    {
+        lock_guard<mutex> lock(_work_mutex);
+        _round++;
+        _lanes_busy = _workers.size();
+        _worker_error = nullptr;
+    }
+    _work_changed.notify_all();
+
+    route_lane(0);
+
+    unique_lock<mutex> lock(_work_mutex);
+    _work_changed.wait(lock, [&] { return _lanes_busy == 0; });
+    if (_worker_error) {
+        rethrow_exception(_worker_error);
     }
 }
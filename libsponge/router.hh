@@ -1,10 +1,21 @@
 #ifndef SPONGE_LIBSPONGE_ROUTER_HH
 #define SPONGE_LIBSPONGE_ROUTER_HH
 
+#include "mpsc_queue.hh"
 #include "network_interface.hh"
-
+#include "next_hop_group.hh"
+#include "route_cache.hh"
+#include "route_table.hh"
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <queue>
+#include <thread>
+#include <vector>
 
 //! \brief A wrapper for NetworkInterface that makes the host-side
 //! interface asynchronous: instead of returning received datagrams
@@ -12,7 +23,8 @@
 //! later retrieval. Otherwise, behaves identically to the underlying
 //! implementation of NetworkInterface.
 class AsyncNetworkInterface : public NetworkInterface {
-    std::queue<InternetDatagram> _datagrams_out{};
+    //! Received datagrams, spread across the queues by the hash of their flows
+    std::vector<std::queue<InternetDatagram>> _datagrams_out = std::vector<std::queue<InternetDatagram>>(1);
 
   public:
     using NetworkInterface::NetworkInterface;
@@ -30,44 +42,124 @@ class AsyncNetworkInterface : public NetworkInterface {
     void recv_frame(const EthernetFrame &frame) {
         auto optional_dgram = NetworkInterface::recv_frame(frame);
         if (optional_dgram.has_value()) {
-            _datagrams_out.push(std::move(optional_dgram.value()));
+            queue_datagram(std::move(optional_dgram.value()));
         }
     };
 
-    //! Access queue of Internet datagrams that have been received
-    std::queue<InternetDatagram> &datagrams_out() { return _datagrams_out; }
-};
+    //! \brief Push a received datagram to the queue its flow hashes to (as a NIC with RSS would)
+    void queue_datagram(InternetDatagram &&dgram);
 
+    //! \brief Spread received datagrams across `count` queues (see FlowHash)
+    //! \details Datagrams already queued are moved to the queues their flows hash to.
+    void set_rx_queues(const size_t count);
 
-// Define a struct used for entries in Router class
-struct RouterEntry
-    {
-        const uint32_t route_prefix;
-        const uint8_t prefix_length;
-        const uint32_t prefix_mask;
-        const std::optional<Address> next_hop;
-        const size_t interface_num;
-    };
+    //! Number of queues of received datagrams
+    size_t rx_queues() const { return _datagrams_out.size(); }
+
+    //! Access queue of Internet datagrams that have been received (or one of them, see set_rx_queues())
+    std::queue<InternetDatagram> &datagrams_out(const size_t queue = 0) { return _datagrams_out.at(queue); }
+};
 
 //! \brief A router that has multiple network interfaces and
 //! performs longest-prefix-match routing between them.
 class Router {
+  public:
+    static constexpr size_t DEFAULT_BATCH_SIZE = 32;       //!< Datagrams route() looks up together
+    static constexpr size_t EGRESS_QUEUE_CAPACITY = 1024;  //!< Datagrams each interface's egress queue holds
+
+  private:
     //! The router's collection of network interfaces
     std::vector<AsyncNetworkInterface> _interfaces{};
 
-    std::vector<RouterEntry> _routing_table{};
+    //! The routes (which another thread may change, see route_table())
+    RouteTable _routing_table{};
+
+    //! \brief What one thread needs to route datagrams: its own handle on the routes, cache and scratch space
+    //! \details The router has one lane per thread (see set_threads()); lane 0 is the calling thread's.
+    struct Lane {
+        RouteTable::Reader reader;              //!< This thread's handle for looking up routes
+        std::optional<RouteCache> route_cache;  //!< Recently looked-up destinations (if enabled)
+
+        //! \name Batched routing
+        //!@{
+        std::vector<InternetDatagram> batch{};                //!< The datagrams being routed together
+        std::vector<size_t> live{};                           //!< Indices in `batch` of unexpired datagrams
+        std::vector<uint32_t> destinations{};                 //!< The destination of each live datagram
+        std::vector<const RouterEntry *> matches{};           //!< The route of each live datagram (or nullptr)
+        std::vector<size_t> egress_starts{};                  //!< Each interface's first place in `egress_order`
+        std::vector<size_t> egress_order{};                   //!< Indices in `live` of routed datagrams, by interface
+        std::vector<size_t> uncached{};                       //!< Indices in `live` of datagrams not in the cache
+        std::vector<uint32_t> uncached_destinations{};        //!< The destination of each uncached datagram
+        std::vector<const RouterEntry *> uncached_matches{};  //!< The route of each uncached datagram
+        //!@}
+
+        //! A lane reading `table`, with a route cache of `cache_capacity` entries (or none if 0)
+        Lane(RouteTable &table, const size_t cache_capacity);
+    };
+
+    std::vector<std::unique_ptr<Lane>> _lanes{};  //!< One per thread
+    size_t _batch_size = DEFAULT_BATCH_SIZE;
+    size_t _route_cache_capacity = 0;
 
     //! Send a single datagram from the appropriate outbound interface to the next hop,
     //! as specified by the route with the longest prefix_length that matches the
     //! datagram's destination address.
-    void route_one_datagram(InternetDatagram &dgram);
+    void route_one_datagram(Lane &lane, InternetDatagram &dgram, const RouteTable::Snapshot &routes);
+
+    //! Decrement the TTL of a datagram and send it by `route`
+    void forward(InternetDatagram &dgram, const RouterEntry &route);
+
+    //! Look up the route to `destination`, in the lane's cache if enabled
+    static const RouterEntry *lookup(Lane &lane, const uint32_t destination, const RouteTable::Snapshot &routes);
+
+    //! Look up the route of every datagram in `lane.batch`, and list the routed ones by egress interface
+    void look_up_batch(Lane &lane, const RouteTable::Snapshot &routes);
+
+    //! \name Parallel routing
+    //!@{
+
+    //! A datagram routed by one thread, for the thread that owns its egress interface to send
+    struct Departure {
+        InternetDatagram dgram{};  //!< The datagram (its TTL decremented already)
+        uint32_t next_hop = 0;     //!< The IP address of the next hop
+    };
+
+    std::vector<std::unique_ptr<MpscQueue<Departure>>> _egress{};  //!< One per interface
+    std::vector<std::thread> _workers{};                           //!< The threads of lanes 1 and up
+    std::mutex _work_mutex{};                                      //!< Guards the next four members
+    std::condition_variable _work_changed{};                       //!< Signalled when any of them changes
+    uint64_t _round = 0;                                           //!< Incremented to start a route() on every lane
+    size_t _lanes_busy = 0;                                        //!< Workers still routing this round
+    bool _stopping = false;                                        //!< Are the workers to exit?
+    std::exception_ptr _worker_error{};                            //!< The first exception a worker threw this round
+    std::atomic<size_t> _lanes_routed{0};                          //!< Lanes done pushing to egress queues this round
+
+    //! The loop run by the thread of lane `lane_num`, which starts after `round`
+    void run_worker(const size_t lane_num, uint64_t round);
+
+    //! Route the datagrams in receive queue `lane_num` of every interface, and send those of the lane's interfaces
+    void route_lane(const size_t lane_num);
+
+    //! Send the datagrams queued for the interfaces lane `lane_num` owns
+    void send_departures(const size_t lane_num);
+
+    //! Stop and join the worker threads
+    void stop_workers();
+    //!@}
 
   public:
+    //! A router with no interfaces or routes, routing on the calling thread only
+    Router();
+
+    //! Stop the worker threads (if any)
+    ~Router() { stop_workers(); }
+
     //! Add an interface to the router
     //! \param[in] interface an already-constructed network interface
     //! \returns The index of the interface after it has been added to the router
     size_t add_interface(AsyncNetworkInterface &&interface) {
         _interfaces.push_back(std::move(interface));
+        _interfaces.back().set_rx_queues(_lanes.size());
         return _interfaces.size() - 1;
     }
 
@@ -80,8 +172,66 @@ class Router {
                    const std::optional<Address> next_hop,
                    const size_t interface_num);
 
+    //! \brief Add a multipath route, spreading flows across `next_hops` by the hash of each flow
+    //! \details Each flow sticks to one next hop (see NextHopGroup), so its datagrams aren't reordered.
+    void add_route(const uint32_t route_prefix, const uint8_t prefix_length, const std::vector<NextHop> &next_hops);
+
+    //! Remove the route for a prefix (if any)
+    void remove_route(const uint32_t route_prefix, const uint8_t prefix_length);
+
+    //! \brief Add a next hop to the route for a prefix (or add a route, if there is none)
+    //! \details Only the flows the new next hop needs for its share move to it; the others stay put.
+    void add_next_hop(const uint32_t route_prefix, const uint8_t prefix_length, const NextHop &next_hop);
+
+    //! \brief Remove a next hop from the route for a prefix (removing the route, if it was the only one)
+    //! \details Only the flows that were using the removed next hop move.
+    void remove_next_hop(const uint32_t route_prefix, const uint8_t prefix_length, const NextHop &next_hop);
+
+    //! \brief The routes, for a control thread to change (and publish) while route() runs on another thread
+    //! \details add_route() and remove_route() publish each change on their own.
+    RouteTable &route_table() { return _routing_table; }
+
+    //! \brief Route datagrams `batch_size` at a time (1 routes each datagram on its own)
+    //! \details The datagrams each interface sends, and their order, don't depend on the batch size.
+    void set_batch_size(const size_t batch_size) { _batch_size = batch_size; }
+
+    //! \brief Cache the routes of up to `capacity` (a power of two) recent destinations, or 0 for no cache
+    //! \details Any change to the routes invalidates the whole cache. Each thread has a cache of its own.
+    void set_route_cache(const size_t capacity);
+
+    //! The route cache of the calling thread's lane, if enabled (for its hit and miss counts)
+    const RouteCache *route_cache() const {
+        return _lanes[0]->route_cache ? &*_lanes[0]->route_cache : nullptr;
+    }
+
+    //! \brief Route on `threads` threads (the caller's and `threads - 1` workers), each with its own
+    //! receive queue on every interface (see AsyncNetworkInterface::set_rx_queues())
+    //! \details With more than one thread, each interface still sends the datagrams of each flow in the
+    //! order they arrived, but may interleave different flows differently than one thread would.
+    void set_threads(const size_t threads);
+
+    //! Number of threads route() uses
+    size_t threads() const { return _lanes.size(); }
+
     //! Route packets between the interfaces
     void route();
+
+    //! \name
+    //! A Router cannot be copied or moved (its workers refer to it)
+    //!@{
+    Router(const Router &other) = delete;
+    Router &operator=(const Router &other) = delete;
+    Router(Router &&other) = delete;
+    Router &operator=(Router &&other) = delete;
+    //!@}
 };
 
+//! \class Router
+//! With more than one thread, route() runs in two overlapping phases on every lane. Lane k routes
+//! receive queue k of every interface (so each flow is routed by one thread, in order), and hands each
+//! datagram to the egress queue of its outbound interface, a lock-free queue with many producers.
+//! Each interface is owned by one lane (interface i by lane i % threads), which alone pops its egress
+//! queue and calls its send_datagram(), so no NetworkInterface is ever touched by two threads at once.
+//! Every lane reads the routes through its own RouteTable::Reader, which never blocks.
+
 #endif  // SPONGE_LIBSPONGE_ROUTER_HH
@@ -1,5 +1,7 @@
 #include "tcp_connection.hh"
 
+#include "tracepoint.hh"
+
 #include <iostream>
 
 // Dummy implementation of a TCP connection
@@ -12,6 +14,12 @@ void DUMMY_CODE(Targs &&... /* unused */) {}
 
 using namespace std;
 
+//! Pack a segment's flags the way they appear on the wire (for trace records)
+static uint8_t trace_flags(const TCPHeader &header) {
+    return (header.urg ? 0b0010'0000 : 0) | (header.ack ? 0b0001'0000 : 0) | (header.psh ? 0b0000'1000 : 0) |
+           (header.rst ? 0b0000'0100 : 0) | (header.syn ? 0b0000'0010 : 0) | (header.fin ? 0b0000'0001 : 0);
+}
+
 size_t TCPConnection::remaining_outbound_capacity() const { return _sender.stream_in().remaining_capacity(); }
 
 size_t TCPConnection::bytes_in_flight() const { return _sender.bytes_in_flight(); }
@@ -21,6 +29,9 @@ size_t TCPConnection::unassembled_bytes() const { return _receiver.unassembled_b
 size_t TCPConnection::time_since_last_segment_received() const { return _time_interval; }
 
 void TCPConnection::segment_received(const TCPSegment &seg) {
+    SPONGE_TRACEPOINT(
+        TraceEvent::SegmentRx, seg.header().seqno.raw_value(), seg.payload().size(), trace_flags(seg.header()));
+
     // Reset the time interval
     _time_interval = 0;
 
@@ -154,7 +165,7 @@ void TCPConnection::connect() {
 TCPConnection::~TCPConnection() {
     try {
         if (active()) {
-            cerr << "Warning: Unclean shutdown of TCPConnection\n";
+            SPONGE_TRACEPOINT(TraceEvent::UncleanShutdown);
 
             // Your code here: need to send a RST segment to the peer
             // Send an RST segment
@@ -187,6 +198,8 @@ void TCPConnection::_send_packets()
             seg.header().ackno = _receiver.ackno().value();
             seg.header().win = _receiver.window_size();
         }
+        SPONGE_TRACEPOINT(
+            TraceEvent::SegmentTx, seg.header().seqno.raw_value(), seg.payload().size(), trace_flags(seg.header()));
         _segments_out.push(seg);
     }
 }
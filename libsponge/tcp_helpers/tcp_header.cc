@@ -1,9 +1,37 @@
 #include "tcp_header.hh"
 
+#include "header_layout.hh"
+
+#include <cstring>
 #include <sstream>
 
 using namespace std;
 
+//! Sequence and acknowledgment numbers go on the wire as their raw 32-bit values
+template <>
+struct WireValue<WrappingInt32> {
+    static uint32_t get(const WrappingInt32 &value) { return value.raw_value(); }
+    static WrappingInt32 make(const uint32_t wire) { return WrappingInt32{wire}; }
+};
+
+//! Where each field of a TCPHeader lives on the wire (see the diagram in tcp_header.hh)
+using TCPHeaderLayout = HeaderLayout<HeaderField<&TCPHeader::sport, 0, 2>,
+                                     HeaderField<&TCPHeader::dport, 2, 2>,
+                                     HeaderField<&TCPHeader::seqno, 4, 4>,
+                                     HeaderField<&TCPHeader::ackno, 8, 4>,
+                                     HeaderField<&TCPHeader::doff, 12, 1, 0b1111'0000>,
+                                     HeaderField<&TCPHeader::urg, 13, 1, 0b0010'0000>,
+                                     HeaderField<&TCPHeader::ack, 13, 1, 0b0001'0000>,
+                                     HeaderField<&TCPHeader::psh, 13, 1, 0b0000'1000>,
+                                     HeaderField<&TCPHeader::rst, 13, 1, 0b0000'0100>,
+                                     HeaderField<&TCPHeader::syn, 13, 1, 0b0000'0010>,
+                                     HeaderField<&TCPHeader::fin, 13, 1, 0b0000'0001>,
+                                     HeaderField<&TCPHeader::win, 14, 2>,
+                                     HeaderField<&TCPHeader::cksum, 16, 2>,
+                                     HeaderField<&TCPHeader::uptr, 18, 2>>;
+
+static_assert(TCPHeaderLayout::LENGTH == TCPHeader::LENGTH);
+
 //! \param[in,out] p is a NetParser from which the TCP fields will be extracted
 //! \returns a ParseResult indicating success or the reason for failure
 //! \details It is important to check for (at least) the following potential errors
@@ -15,23 +43,12 @@ using namespace std;
 //! - there is less data in the header than the `doff` field claims
 //! - the checksum is bad
 ParseResult TCPHeader::parse(NetParser &p) {
-    sport = p.u16();                 // source port
-    dport = p.u16();                 // destination port
-    seqno = WrappingInt32{p.u32()};  // sequence number
-    ackno = WrappingInt32{p.u32()};  // ack number
-    doff = p.u8() >> 4;              // data offset
-
-    const uint8_t fl_b = p.u8();                  // byte including flags
-    urg = static_cast<bool>(fl_b & 0b0010'0000);  // binary literals and ' digit separator since C++14!!!
-    ack = static_cast<bool>(fl_b & 0b0001'0000);
-    psh = static_cast<bool>(fl_b & 0b0000'1000);
-    rst = static_cast<bool>(fl_b & 0b0000'0100);
-    syn = static_cast<bool>(fl_b & 0b0000'0010);
-    fin = static_cast<bool>(fl_b & 0b0000'0001);
-
-    win = p.u16();    // window size
-    cksum = p.u16();  // checksum
-    uptr = p.u16();   // urgent pointer
+    // the fixed part of the header is bounds-checked once, then decoded without further checks
+    const auto fixed = p.take(TCPHeader::LENGTH);
+    if (not fixed) {
+        return p.get_error();
+    }
+    TCPHeaderLayout::parse(*this, fixed->data());
 
     if (doff < 5) {
         return ParseResult::HeaderTooShort;
@@ -47,33 +64,26 @@ ParseResult TCPHeader::parse(NetParser &p) {
     return ParseResult::NoError;
 }
 
-//! Serialize the TCPHeader to a string (does not recompute the checksum)
-string TCPHeader::serialize() const {
+//! \param[out] out must have room for `4 * doff` bytes (at most TCPHeader::MAX_LENGTH)
+//! \details Options are not supported, so any bytes beyond the first TCPHeader::LENGTH are zeroed.
+//! Does not recompute the checksum.
+void TCPHeader::serialize(char *out) const {
     // sanity check
     if (doff < 5) {
         throw runtime_error("TCP header too short");
     }
+    if (doff * 4 > MAX_LENGTH) {
+        throw runtime_error("TCP header too long");
+    }
 
-    string ret;
-    ret.reserve(4 * doff);
-
-    NetUnparser::u16(ret, sport);              // source port
-    NetUnparser::u16(ret, dport);              // destination port
-    NetUnparser::u32(ret, seqno.raw_value());  // sequence number
-    NetUnparser::u32(ret, ackno.raw_value());  // ack number
-    NetUnparser::u8(ret, doff << 4);           // data offset
-
-    const uint8_t fl_b = (urg ? 0b0010'0000 : 0) | (ack ? 0b0001'0000 : 0) | (psh ? 0b0000'1000 : 0) |
-                         (rst ? 0b0000'0100 : 0) | (syn ? 0b0000'0010 : 0) | (fin ? 0b0000'0001 : 0);
-    NetUnparser::u8(ret, fl_b);  // flags
-    NetUnparser::u16(ret, win);  // window size
-
-    NetUnparser::u16(ret, cksum);  // checksum
-
-    NetUnparser::u16(ret, uptr);  // urgent pointer
-
-    ret.resize(4 * doff);  // expand header to advertised size
+    TCPHeaderLayout::serialize(*this, out);
+    memset(out + LENGTH, 0, 4 * doff - LENGTH);  // expand header to advertised size
+}
 
+//! Serialize the TCPHeader to a string (does not recompute the checksum)
+string TCPHeader::serialize() const {
+    string ret(4 * doff, 0);
+    serialize(ret.data());
     return ret;
 }
 
@@ -102,7 +112,5 @@ string TCPHeader::summary() const {
 
 bool TCPHeader::operator==(const TCPHeader &other) const {
     // TODO(aozdemir) more complete check (right now we omit cksum, src, dst
-    return seqno == other.seqno && ackno == other.ackno && doff == other.doff && urg == other.urg && ack == other.ack &&
-           psh == other.psh && rst == other.rst && syn == other.syn && fin == other.fin && win == other.win &&
-           uptr == other.uptr;
+    return TCPHeaderLayout::equal<&TCPHeader::sport, &TCPHeader::dport, &TCPHeader::cksum>(*this, other);
 }
@@ -7,7 +7,8 @@
 //! \brief [TCP](\ref rfc::rfc793) segment header
 //! \note TCP options are not supported
 struct TCPHeader {
-    static constexpr size_t LENGTH = 20;  //!< [TCP](\ref rfc::rfc793) header length, not including options
+    static constexpr size_t LENGTH = 20;      //!< [TCP](\ref rfc::rfc793) header length, not including options
+    static constexpr size_t MAX_LENGTH = 60;  //!< Largest header length `doff` can describe
 
     //! \struct TCPHeader
     //! ~~~{.txt}
@@ -56,6 +57,9 @@ struct TCPHeader {
     //! Serialize the TCP fields
     std::string serialize() const;
 
+    //! Serialize the TCP fields into a preallocated span of `4 * doff` bytes
+    void serialize(char *out) const;
+
     //! Return a string containing a header in human-readable format
     std::string to_string() const;
 
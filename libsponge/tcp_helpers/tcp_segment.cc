@@ -3,6 +3,8 @@
 #include "parser.hh"
 #include "util.hh"
 
+#include <array>
+#include <cstring>
 #include <variant>
 
 using namespace std;
@@ -26,20 +28,72 @@ size_t TCPSegment::length_in_sequence_space() const {
     return payload().str().size() + (header().syn ? 1 : 0) + (header().fin ? 1 : 0);
 }
 
+//! The header as it is checksummed: serialized, with the checksum field zeroed
+static array<char, TCPHeader::MAX_LENGTH> checksummed_header(const TCPHeader &header) {
+    TCPHeader header_out = header;
+    header_out.cksum = 0;
+    array<char, TCPHeader::MAX_LENGTH> bytes;
+    header_out.serialize(bytes.data());
+    return bytes;
+}
+
+//! \details If this segment (or the one it was copied from) was checksummed before with the same
+//! payload, the old checksum is updated one changed 16-bit header word at a time as in
+//! [RFC 1624](\ref rfc::rfc1624), so patching the ackno, window or ports of a segment never
+//! requires re-reading its payload.
+uint16_t TCPSegment::_checksum_without_pseudo_header() const {
+    const bool same_payload = _cksum_cache.has_value() and _cksum_cache->payload.size() == _payload.size() and
+                              _cksum_cache->payload.str().data() == _payload.str().data();
+    if (not same_payload) {
+        InternetChecksum payload_check;
+        payload_check.add(_payload);
+        cache_checksum(payload_check.value());
+        return _cksum_cache->cksum;
+    }
+
+    // options aren't supported (they serialize as zeros), so only the fixed part can differ
+    const auto header_bytes = checksummed_header(_header);
+    uint16_t cksum = _cksum_cache->cksum;
+    for (size_t i = 0; i < TCPHeader::LENGTH; i += 2) {
+        uint16_t old_word, new_word;
+        memcpy(&old_word, _cksum_cache->header_bytes.data() + i, sizeof(old_word));
+        memcpy(&new_word, header_bytes.data() + i, sizeof(new_word));
+        if (old_word != new_word) {
+            cksum = InternetChecksum::update_u16(cksum, net_byteswap(old_word), net_byteswap(new_word));
+        }
+    }
+
+    _cksum_cache->header_bytes = header_bytes;
+    _cksum_cache->cksum = cksum;
+    return cksum;
+}
+
+//! \param[in] payload_cksum is the Internet checksum of the current payload by itself
+void TCPSegment::cache_checksum(const uint16_t payload_cksum) const {
+    const auto header_bytes = checksummed_header(_header);
+
+    // the header is a whole number of 16-bit words, so the payload's sum can simply be added to it
+    InternetChecksum check(uint16_t(~payload_cksum));
+    check.add({header_bytes.data(), 4 * size_t{_header.doff}});
+    _cksum_cache = ChecksumCache{header_bytes, _payload, check.value()};
+}
+
 //! \param[in] datagram_layer_checksum pseudo-checksum from the lower-layer protocol
 BufferList TCPSegment::serialize(const uint32_t datagram_layer_checksum) const {
+    return serialize_packet(datagram_layer_checksum).to_buffer_list();
+}
+
+//! \param[in] datagram_layer_checksum pseudo-checksum from the lower-layer protocol
+//! \returns a PacketBuffer holding the header, with headroom left in front of it for lower layers
+PacketBuffer TCPSegment::serialize_packet(const uint32_t datagram_layer_checksum) const {
     TCPHeader header_out = _header;
-    header_out.cksum = 0;
 
-    // calculate checksum -- taken over entire segment
-    InternetChecksum check(datagram_layer_checksum);
-    check.add(header_out.serialize());
-    check.add(_payload);
+    // calculate checksum -- taken over entire segment, combined with the pseudo-header's
+    const uint16_t segment_cksum = _checksum_without_pseudo_header();
+    InternetChecksum check(datagram_layer_checksum + uint16_t(~segment_cksum));
     header_out.cksum = check.value();
 
-    BufferList ret;
-    ret.append(header_out.serialize());
-    ret.append(_payload);
-
+    PacketBuffer ret{_payload};
+    header_out.serialize(ret.prepend(4 * header_out.doff));
     return ret;
 }
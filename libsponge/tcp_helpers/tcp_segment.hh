@@ -2,9 +2,12 @@
 #define SPONGE_LIBSPONGE_TCP_SEGMENT_HH
 
 #include "buffer.hh"
+#include "packet_buffer.hh"
 #include "tcp_header.hh"
 
+#include <array>
 #include <cstdint>
+#include <optional>
 
 //! \brief [TCP](\ref rfc::rfc793) segment
 class TCPSegment {
@@ -12,6 +15,17 @@ class TCPSegment {
     TCPHeader _header{};
     Buffer _payload{};
 
+    //! The last checksum computed for this segment (without the pseudo-header), and what it covered
+    struct ChecksumCache {
+        std::array<char, TCPHeader::MAX_LENGTH> header_bytes;  //!< header (with cksum = 0) that was summed
+        Buffer payload;  //!< payload when the checksum was computed (keeps its storage alive)
+        uint16_t cksum;  //!< checksum of header (with cksum = 0) and payload
+    };
+    mutable std::optional<ChecksumCache> _cksum_cache{};
+
+    //! Checksum of the header (with cksum = 0) and payload, updated from the cache if possible
+    uint16_t _checksum_without_pseudo_header() const;
+
   public:
     //! \brief Parse the segment from a string
     ParseResult parse(const Buffer buffer, const uint32_t datagram_layer_checksum = 0);
@@ -19,6 +33,17 @@ class TCPSegment {
     //! \brief Serialize the segment to a string
     BufferList serialize(const uint32_t datagram_layer_checksum = 0) const;
 
+    //! \brief Serialize the segment into a PacketBuffer, which lower layers can prepend their headers to
+    PacketBuffer serialize_packet(const uint32_t datagram_layer_checksum = 0) const;
+
+    //! \brief Compute and remember the checksum now, so later serializations needn't read the payload
+    void cache_checksum() const { _checksum_without_pseudo_header(); }
+
+    //! \brief Remember the checksum, given the checksum of the payload alone
+    //! \details For a payload that was checksummed as it was copied in (see InternetChecksum::add_copy()),
+    //! so that it never has to be read again.
+    void cache_checksum(const uint16_t payload_cksum) const;
+
     //! \name Accessors
     //!@{
     const TCPHeader &header() const { return _header; }
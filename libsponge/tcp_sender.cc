@@ -1,6 +1,8 @@
 #include "tcp_sender.hh"
 
 #include "tcp_config.hh"
+#include "tracepoint.hh"
+#include "util.hh"
 
 #include <random>
 #include <string>
@@ -46,7 +48,9 @@ void TCPSender::fill_window() {
 
         // Determine the size of the payload
         size_t payload_size = min(TCPConfig::MAX_PAYLOAD_SIZE, window_size - _bytes_in_flight - seg.header().syn);
-        string payload = _stream.read(payload_size);
+        // (checksummed as it is copied out of the stream, so the payload is only read once)
+        InternetChecksum payload_check;
+        Buffer payload = _stream.read(payload_size, payload_check);
 
         // Note that the payload need not to have a length of payload_size!!
         // Because the payload_size is the maximum length available
@@ -61,7 +65,7 @@ void TCPSender::fill_window() {
             _fin_flag_set = true;
         }
         
-        seg.payload() = Buffer(move(payload));
+        seg.payload() = move(payload);
 
         // If there is no data to send, abort immediately
         if (seg.length_in_sequence_space() == 0)
@@ -76,6 +80,9 @@ void TCPSender::fill_window() {
             _time_elapsed = 0;
         }
 
+        // Checksum the segment once; the copies kept for retransmission share the result
+        seg.cache_checksum(payload_check.value());
+
         // Send the segment
         _segments_out.push(seg);
 
@@ -128,6 +135,7 @@ void TCPSender::ack_received(const WrappingInt32 ackno, const uint16_t window_si
     }
 
     // Try to fill the window
+    SPONGE_TRACEPOINT(TraceEvent::WindowUpdate, ackno.raw_value(), window_size);
     _window_size = window_size;
     fill_window();
 }
@@ -140,6 +148,9 @@ void TCPSender::tick(const size_t ms_since_last_tick) {
     if (_bytes_in_flight != 0 && _time_elapsed >= _retransmission_timeout)
     {
         // Retransmit the oldest segment
+        SPONGE_TRACEPOINT(TraceEvent::Retransmit,
+                          _in_flight_segments.front().second.header().seqno.raw_value(),
+                          _retransmission_timeout);
         _segments_out.push(_in_flight_segments.front().second);
 
         if (_window_size > 0)
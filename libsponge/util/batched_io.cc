@@ -0,0 +1,216 @@
+#include "batched_io.hh"
+
+#include "util.hh"
+
+#include <cerrno>
+#include <iostream>
+#include <stdexcept>
+#include <sys/stat.h>
+
+using namespace std;
+
+static bool is_socket(const FileDescriptor &fd) {
+    struct stat st {};
+    SystemCall("fstat", ::fstat(fd.fd_num(), &st));
+    return S_ISSOCK(st.st_mode);
+}
+
+//! \param[in] fd is the file descriptor to move packets through
+//! \param[in] backend chooses between io_uring and one system call per packet
+//! \param[in] packet_size is the size of each receive buffer
+//! \param[in] depth is the number of receive buffers, and the number of writes that can be in flight
+BatchedIO::BatchedIO(FileDescriptor &&fd, const Backend backend, const size_t packet_size, const uint16_t depth)
+    : _fd(move(fd))
+    , _backend(backend == Backend::Auto ? (IoUring::available() ? Backend::IoUring : Backend::Synchronous)
+                                        : backend)
+    , _packet_size(packet_size)
+    , _depth(depth)
+    , _is_socket(is_socket(_fd)) {
+    if (_backend != Backend::IoUring) {
+        return;
+    }
+
+    if (not IoUring::available()) {
+        throw runtime_error("BatchedIO: io_uring is not available");
+    }
+    if (depth == 0 or (depth & (depth - 1))) {
+        throw runtime_error("BatchedIO: depth must be a power of two");
+    }
+
+    _multishot = _is_socket and IoUring::multishot_recv_available();
+    _ring = make_unique<IoUring>(2 * depth);
+    _ring->register_buffer_ring(depth);
+    _receive_buffers.resize(depth);
+    for (uint16_t id = 0; id < depth; id++) {
+        _receive_buffers[id] = Buffer::allocate(packet_size);
+        _ring->provide_buffer(_receive_buffers[id].mutable_data(), packet_size, id);
+    }
+    _ring->commit_buffers();
+
+    _writes.resize(depth);
+    for (uint32_t slot = depth; slot > 0; slot--) {
+        _free_writes.push_back(slot - 1);
+    }
+}
+
+BatchedIO::~BatchedIO() {
+    if (not _ring) {
+        return;
+    }
+
+    try {
+        // the kernel may still write into the receive buffers, and read from the packets being written
+        if (_reads_in_flight) {
+            io_uring_sqe &sqe = _ring->prepare(IORING_OP_ASYNC_CANCEL, _fd.fd_num(), CANCEL);
+            sqe.cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+        }
+        _reading = false;
+        while (_reads_in_flight or _free_writes.size() != _writes.size()) {
+            _ring->submit(1);
+            _drain();
+        }
+    } catch (const exception &e) {
+        // don't throw an exception from the destructor
+        std::cerr << "Exception destructing BatchedIO: " << e.what() << std::endl;
+    }
+}
+
+void BatchedIO::install(EventLoop &loop, const PacketCallbackT &on_packet) {
+    _on_packet = on_packet;
+
+    if (_backend == Backend::Synchronous) {
+        loop.add_rule(_fd, Direction::In, [this] { _on_packet(_fd.read_buffer(_packet_size)); });
+        return;
+    }
+
+    _reading = true;
+    _arm_reads();
+    _ring->submit();
+    loop.add_rule(*_ring, Direction::In, [this] { _reap(); });
+}
+
+void BatchedIO::_arm_reads() {
+    if (not _reading) {
+        return;
+    }
+
+    // a socket needs one multishot receive; anything else needs one read per packet
+    const unsigned wanted = _multishot ? 1 : _depth;
+    while (_reads_in_flight < wanted) {
+        io_uring_sqe &sqe = _ring->prepare(_is_socket ? IORING_OP_RECV : IORING_OP_READ, _fd.fd_num(), RECEIVE);
+        sqe.flags = IOSQE_BUFFER_SELECT;
+        sqe.buf_group = IoUring::BUFFER_GROUP;
+        if (_multishot) {
+            sqe.ioprio = IORING_RECV_MULTISHOT;  // (with no length: the provided buffer bounds each receive)
+        } else {
+            sqe.len = _packet_size;
+        }
+        _reads_in_flight++;
+    }
+}
+
+void BatchedIO::_drain() {
+    bool replenished = false;
+
+    _ring->reap([&](const io_uring_cqe &cqe) {
+        if (cqe.user_data == CANCEL) {
+            return;
+        }
+
+        if (cqe.user_data == RECEIVE) {
+            if (not(cqe.flags & IORING_CQE_F_MORE)) {
+                _reads_in_flight--;  // this request is finished (a multishot one may need rearming)
+            }
+
+            if (cqe.flags & IORING_CQE_F_BUFFER) {
+                const uint16_t id = cqe.flags >> IORING_CQE_BUFFER_SHIFT;
+                Buffer packet = move(_receive_buffers.at(id));
+                packet.truncate(cqe.res > 0 ? cqe.res : 0);
+
+                _receive_buffers[id] = Buffer::allocate(_packet_size);
+                _ring->provide_buffer(_receive_buffers[id].mutable_data(), _packet_size, id);
+                replenished = true;
+
+                if (cqe.res >= 0 and (cqe.res > 0 or _is_socket)) {
+                    _received.push_back(move(packet));
+                }
+            } else if (cqe.res == -EINVAL and _multishot) {
+                _multishot = false;  // the kernel refused the multishot receive; fall back to one-shot ones
+            } else if (cqe.res == 0 and not _is_socket) {
+                _reading = false;  // EOF
+            } else if (cqe.res < 0 and cqe.res != -ENOBUFS and cqe.res != -ECANCELED and cqe.res != -EINTR) {
+                // (running out of buffers just means rearming once they have been replenished)
+                throw unix_error("io_uring read", -cqe.res);
+            }
+            return;
+        }
+
+        // a write completed
+        PendingWrite &write = _writes.at(cqe.user_data);
+        const size_t size = write.packet.size();
+        write.packet = PacketBuffer{};
+        _free_writes.push_back(cqe.user_data);
+        if (cqe.res < 0) {
+            throw unix_error("io_uring writev", -cqe.res);
+        }
+        if (static_cast<size_t>(cqe.res) != size) {
+            throw runtime_error("BatchedIO: short write");
+        }
+    });
+
+    if (replenished) {
+        _ring->commit_buffers();
+    }
+}
+
+void BatchedIO::_reap() {
+    if (_reaping) {
+        _drain();  // the outer call delivers what this drains
+        return;
+    }
+
+    _reaping = true;
+    try {
+        _drain();
+
+        // the callback may write, which may drain more packets, which this loop then delivers
+        for (size_t i = 0; i < _received.size(); i++) {
+            Buffer packet = move(_received[i]);
+            _on_packet(move(packet));
+        }
+    } catch (...) {
+        _received.clear();
+        _reaping = false;
+        throw;
+    }
+    _received.clear();
+    _reaping = false;
+
+    _arm_reads();
+    _ring->submit();
+}
+
+void BatchedIO::write(PacketBuffer &&packet) {
+    if (_backend == Backend::Synchronous) {
+        _fd.write(packet);
+        return;
+    }
+
+    while (_free_writes.empty()) {
+        // every slot is in flight; wait for one to complete
+        _ring->submit(1);
+        _reap();
+    }
+
+    const uint32_t slot = _free_writes.back();
+    _free_writes.pop_back();
+    PendingWrite &write = _writes[slot];
+    write.packet = move(packet);
+    write.iovecs = write.packet.as_iovecs();
+
+    io_uring_sqe &sqe = _ring->prepare(IORING_OP_WRITEV, _fd.fd_num(), slot);
+    sqe.addr = reinterpret_cast<uint64_t>(write.iovecs.data());
+    sqe.len = write.iovecs.size();
+}
+
+unsigned BatchedIO::flush() { return _ring ? _ring->submit() : 0; }
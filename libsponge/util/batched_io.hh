@@ -0,0 +1,124 @@
+#ifndef SPONGE_LIBSPONGE_BATCHED_IO_HH
+#define SPONGE_LIBSPONGE_BATCHED_IO_HH
+
+#include "buffer.hh"
+#include "eventloop.hh"
+#include "file_descriptor.hh"
+#include "io_uring.hh"
+#include "packet_buffer.hh"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <sys/uio.h>
+#include <vector>
+
+//! \brief Moves packets (UDP datagrams, TUN/TAP frames) to and from a file descriptor, in batches when possible
+class BatchedIO {
+  public:
+    //! How the packets are moved
+    enum class Backend {
+        Auto,         //!< IoUring if the kernel supports it, otherwise Synchronous
+        Synchronous,  //!< One read(2) or writev(2) per packet, when EventLoop (epoll) says the fd is ready
+        IoUring       //!< Reads kept in flight and writes queued on an io_uring, submitted many at a time
+    };
+
+    static constexpr size_t DEFAULT_PACKET_SIZE = 2048;  //!< Largest packet received (bigger ones are truncated)
+    static constexpr uint16_t DEFAULT_DEPTH = 128;       //!< Receive buffers, and writes, in flight at once
+
+    using PacketCallbackT = std::function<void(Buffer &&packet)>;  //!< Called with each received packet
+
+  private:
+    //! Tags in a completion's user data
+    enum : uint64_t { RECEIVE = uint64_t{1} << 63, CANCEL = uint64_t{1} << 62 };
+
+    //! A write that has been prepared and not yet completed
+    struct PendingWrite {
+        PacketBuffer packet{};          //!< Holds the bytes being written until the write completes
+        std::array<iovec, 2> iovecs{};  //!< The packet's headers and payload (see PacketBuffer::as_iovecs)
+    };
+
+    FileDescriptor _fd;
+    Backend _backend;
+    size_t _packet_size;
+    uint16_t _depth;
+    bool _is_socket;
+    bool _multishot = false;  //!< Is the socket read with one multishot receive (rather than `depth` one-shot ones)?
+    PacketCallbackT _on_packet{};
+
+    //! \name io_uring state
+    //!@{
+    std::unique_ptr<IoUring> _ring{};
+    std::vector<Buffer> _receive_buffers{};  //!< The buffer given to the kernel with each id, until it is used
+    std::vector<Buffer> _received{};         //!< Packets reaped and not yet passed to the callback
+    unsigned _reads_in_flight = 0;           //!< Receive requests that may still complete
+    bool _reading = false;                   //!< Should receive requests be kept in flight?
+    bool _reaping = false;                   //!< Is _reap() running (so packets will be delivered)?
+    std::vector<PendingWrite> _writes{};     //!< One slot per write in flight (never resized)
+    std::vector<uint32_t> _free_writes{};    //!< Indices of unused slots in `_writes`
+    //!@}
+
+    //! Process the completions that have arrived, setting received packets aside in `_received`
+    void _drain();
+
+    //! Drain completions, deliver received packets, then replenish buffers and reads and submit
+    void _reap();
+
+    //! Keep receive requests in flight (to be submitted by the caller)
+    void _arm_reads();
+
+  public:
+    //! \brief Take over `fd` (e.g. a UDPSocket or TunFD, or a duplicate of one)
+    explicit BatchedIO(FileDescriptor &&fd,
+                       const Backend backend = Backend::Auto,
+                       const size_t packet_size = DEFAULT_PACKET_SIZE,
+                       const uint16_t depth = DEFAULT_DEPTH);
+
+    //! Cancel outstanding reads, and wait for outstanding writes to finish
+    ~BatchedIO();
+
+    //! The backend in use (never Backend::Auto)
+    Backend backend() const { return _backend; }
+
+    //! The file descriptor
+    const FileDescriptor &fd() const { return _fd; }
+
+    //! \brief Start receiving packets: `on_packet` is called from `loop` with each one
+    void install(EventLoop &loop, const PacketCallbackT &on_packet);
+
+    //! \brief Send a packet (with the IoUring backend, it is only queued until flush())
+    void write(PacketBuffer &&packet);
+
+    //! \brief Submit every queued write with one system call
+    //! \returns the number of operations submitted
+    unsigned flush();
+
+    //! \name
+    //! A BatchedIO cannot be copied or moved (the kernel and the EventLoop refer to it)
+    //!@{
+    BatchedIO(const BatchedIO &other) = delete;
+    BatchedIO &operator=(const BatchedIO &other) = delete;
+    BatchedIO(BatchedIO &&other) = delete;
+    BatchedIO &operator=(BatchedIO &&other) = delete;
+    //!@}
+};
+
+//! \class BatchedIO
+//! With the IoUring backend, receiving never costs a system call per packet: the kernel is given
+//! a ring of pooled, `packet_size` buffers up front (see IoUring::register_buffer_ring), a socket
+//! gets one multishot receive that keeps completing until the buffers run out (or, on kernels
+//! without multishot receives, `depth` one-shot ones), and another fd (e.g. TUN) gets `depth`
+//! reads in flight. Each completion hands its buffer to the callback as a Buffer (without copying)
+//! and a fresh pooled buffer takes its place. Writes are queued on the submission queue until
+//! flush(), so a busy adapter moves as many packets per `io_uring_enter` as it handles per
+//! EventLoop iteration. The EventLoop watches the ring's fd, which is readable whenever
+//! completions are waiting.
+//!
+//! With the Synchronous backend, the same interface does one read or write per packet.
+//!
+//! Each read or write moves one whole packet, so the fd must preserve packet boundaries (a UDP or
+//! packet socket, or a TUN/TAP device).
+
+#endif  // SPONGE_LIBSPONGE_BATCHED_IO_HH
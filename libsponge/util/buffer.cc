@@ -2,13 +2,46 @@
 
 using namespace std;
 
+//! \param[in] len is the number of bytes the caller will write through mutable_data()
+Buffer Buffer::allocate(const size_t len) {
+    Buffer ret;
+    ret._storage = BufferStorage::allocate(len);
+    return ret;
+}
+
+char *Buffer::mutable_data() {
+    if (not _storage) {
+        return nullptr;
+    }
+    if (not _storage->unique()) {
+        throw runtime_error("Buffer::mutable_data: storage is shared");
+    }
+    return _storage->data() + _starting_offset;
+}
+
+void Buffer::truncate(const size_t len) {
+    if (len >= size()) {
+        return;
+    }
+    if (not _storage->unique()) {
+        throw runtime_error("Buffer::truncate: storage is shared");
+    }
+    if (len == 0) {
+        *this = Buffer{};
+        return;
+    }
+    _storage->truncate(_starting_offset + len);
+}
+
 void Buffer::remove_prefix(const size_t n) {
     if (n > str().size()) {
         throw out_of_range("Buffer::remove_prefix");
     }
     _starting_offset += n;
-    if (_storage and _starting_offset == _storage->size()) {
-        _storage.reset();
+    if (_storage and _starting_offset == _storage->str().size()) {
+        _storage->release();
+        _storage = nullptr;
+        _starting_offset = 0;
     }
 }
 
@@ -66,7 +99,8 @@ void BufferList::remove_prefix(size_t n) {
 
 BufferViewList::BufferViewList(const BufferList &buffers) {
     for (const auto &x : buffers.buffers()) {
-        _views.push_back(x);
+        const std::string_view view = x;
+        _views.push_back({const_cast<char *>(view.data()), view.size()});
     }
 }
 
@@ -76,11 +110,12 @@ void BufferViewList::remove_prefix(size_t n) {
             throw std::out_of_range("BufferListView::remove_prefix");
         }
 
-        if (n < _views.front().size()) {
-            _views.front().remove_prefix(n);
+        if (n < _views.front().iov_len) {
+            _views.front().iov_base = static_cast<char *>(_views.front().iov_base) + n;
+            _views.front().iov_len -= n;
             n = 0;
         } else {
-            n -= _views.front().size();
+            n -= _views.front().iov_len;
             _views.pop_front();
         }
     }
@@ -88,17 +123,8 @@ void BufferViewList::remove_prefix(size_t n) {
 
 size_t BufferViewList::size() const {
     size_t ret = 0;
-    for (const auto &buf : _views) {
-        ret += buf.size();
-    }
-    return ret;
-}
-
-vector<iovec> BufferViewList::as_iovecs() const {
-    vector<iovec> ret;
-    ret.reserve(_views.size());
-    for (const auto &x : _views) {
-        ret.push_back({const_cast<char *>(x.data()), x.size()});
+    for (const auto &iov : _views) {
+        ret += iov.iov_len;
     }
     return ret;
 }
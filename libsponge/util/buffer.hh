@@ -1,8 +1,10 @@
 #ifndef SPONGE_LIBSPONGE_BUFFER_HH
 #define SPONGE_LIBSPONGE_BUFFER_HH
 
+#include "buffer_pool.hh"
+#include "small_vector.hh"
+
 #include <algorithm>
-#include <deque>
 #include <memory>
 #include <numeric>
 #include <stdexcept>
@@ -14,14 +16,50 @@
 //! \brief A reference-counted read-only string that can discard bytes from the front
 class Buffer {
   private:
-    std::shared_ptr<std::string> _storage{};
+    BufferStorage *_storage = nullptr;  //!< Shared (reference-counted) storage, or null if empty
     size_t _starting_offset{};
 
   public:
     Buffer() = default;
 
     //! \brief Construct by taking ownership of a string
-    Buffer(std::string &&str) noexcept : _storage(std::make_shared<std::string>(std::move(str))) {}
+    Buffer(std::string &&str) noexcept : _storage(BufferStorage::adopt(std::move(str))) {}
+
+    //! \brief Construct `len` uninitialized bytes of pooled storage, to be filled through mutable_data()
+    static Buffer allocate(const size_t len);
+
+    //! \name Copying and moving share the storage
+    //!@{
+    Buffer(const Buffer &other) noexcept : _storage(other._storage), _starting_offset(other._starting_offset) {
+        if (_storage) {
+            _storage->add_ref();
+        }
+    }
+
+    Buffer(Buffer &&other) noexcept : _storage(other._storage), _starting_offset(other._starting_offset) {
+        other._storage = nullptr;
+        other._starting_offset = 0;
+    }
+
+    Buffer &operator=(const Buffer &other) noexcept {
+        Buffer copy{other};
+        std::swap(_storage, copy._storage);
+        std::swap(_starting_offset, copy._starting_offset);
+        return *this;
+    }
+
+    Buffer &operator=(Buffer &&other) noexcept {
+        std::swap(_storage, other._storage);
+        std::swap(_starting_offset, other._starting_offset);
+        return *this;
+    }
+
+    ~Buffer() {
+        if (_storage) {
+            _storage->release();
+        }
+    }
+    //!@}
 
     //! \name Expose contents as a std::string_view
     //!@{
@@ -29,12 +67,21 @@ class Buffer {
         if (not _storage) {
             return {};
         }
-        return {_storage->data() + _starting_offset, _storage->size() - _starting_offset};
+        const std::string_view whole = _storage->str();
+        return {whole.data() + _starting_offset, whole.size() - _starting_offset};
     }
 
     operator std::string_view() const { return str(); }
     //!@}
 
+    //! \brief Writable access to the bytes
+    //! \note Only allowed while no other Buffer shares the storage (e.g. just after allocate())
+    char *mutable_data();
+
+    //! \brief Keep only the first `len` bytes (e.g. the part of an allocate()d Buffer that a read filled)
+    //! \note Like mutable_data(), only allowed while no other Buffer shares the storage
+    void truncate(const size_t len);
+
     //! \brief Get character at location `n`
     uint8_t at(const size_t n) const { return str().at(n); }
 
@@ -55,8 +102,11 @@ class Buffer {
 //! encapsulate a TCP payload in a TCPSegment, and then encapsulate
 //! the TCPSegment in an IPv4Datagram) without copying the payload.
 class BufferList {
+  public:
+    static constexpr size_t INLINE_PIECES = 4;  //!< Pieces held without allocating (e.g. headers + payload)
+
   private:
-    std::deque<Buffer> _buffers{};
+    SmallVector<Buffer, INLINE_PIECES> _buffers{};
 
   public:
     //! \name Constructors
@@ -65,17 +115,14 @@ class BufferList {
     BufferList() = default;
 
     //! \brief Construct from a Buffer
-    BufferList(Buffer buffer) : _buffers{buffer} {}
+    BufferList(Buffer buffer) : _buffers{std::move(buffer)} {}
 
     //! \brief Construct by taking ownership of a std::string
-    BufferList(std::string &&str) noexcept {
-        Buffer buf{std::move(str)};
-        append(buf);
-    }
+    BufferList(std::string &&str) noexcept : _buffers{Buffer{std::move(str)}} {}
     //!@}
 
-    //! \brief Access the underlying queue of Buffers
-    const std::deque<Buffer> &buffers() const { return _buffers; }
+    //! \brief Access the underlying sequence of Buffers
+    const SmallVector<Buffer, INLINE_PIECES> &buffers() const { return _buffers; }
 
     //! \brief Append a BufferList
     void append(const BufferList &other);
@@ -96,7 +143,8 @@ class BufferList {
 
 //! \brief A non-owning temporary view (similar to std::string_view) of a discontiguous string
 class BufferViewList {
-    std::deque<std::string_view> _views{};
+    //! The pieces, kept as `iovec`s so that system calls can use them directly
+    SmallVector<iovec, BufferList::INLINE_PIECES> _views{};
 
   public:
     //! \name Constructors
@@ -112,7 +160,7 @@ class BufferViewList {
     BufferViewList(const BufferList &buffers);
 
     //! \brief Construct from a std::string_view
-    BufferViewList(std::string_view str) { _views.push_back({const_cast<char *>(str.data()), str.size()}); }
+    BufferViewList(std::string_view str) : _views{{const_cast<char *>(str.data()), str.size()}} {}
     //!@}
 
     //! \brief Discard the first `n` bytes of the string (does not require a copy or move)
@@ -121,10 +169,18 @@ class BufferViewList {
     //! \brief Size of the string
     size_t size() const;
 
-    //! \brief Convert to a vector of `iovec` structures
+    //! \brief The pieces as a sequence of `iovec` structures (with `data()` and `size()`)
     //! \note used for system calls that write discontiguous buffers,
-    //! e.g. [writev(2)](\ref man2::writev) and [sendmsg(2)](\ref man2::sendmsg)
-    std::vector<iovec> as_iovecs() const;
+    //! e.g. [writev(2)](\ref man2::writev) and [sendmsg(2)](\ref man2::sendmsg); doesn't allocate
+    const SmallVector<iovec, BufferList::INLINE_PIECES> &as_iovecs() const { return _views; }
+
+    //! \brief The `i`th piece
+    std::string_view piece(const size_t i) const {
+        return {static_cast<const char *>(_views[i].iov_base), _views[i].iov_len};
+    }
+
+    //! \brief Number of pieces
+    size_t num_pieces() const { return _views.size(); }
 };
 
 #endif  // SPONGE_LIBSPONGE_BUFFER_HH
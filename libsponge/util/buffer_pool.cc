@@ -0,0 +1,110 @@
+#include "buffer_pool.hh"
+
+#include <algorithm>
+#include <new>
+
+using namespace std;
+
+//! Set once the calling thread's free lists have been destroyed (Buffers can outlive them at exit)
+static thread_local bool free_lists_destroyed = false;
+
+//! The calling thread's allocation counts
+static thread_local BufferStorage::Stats thread_stats{};
+
+//! A thread's free lists, one per size class plus one for adopted storage
+struct BufferStorage::FreeLists {
+    array<BufferStorage *, SIZE_CLASSES.size() + 1> heads{};
+    array<size_t, SIZE_CLASSES.size() + 1> lengths{};
+
+    FreeLists() = default;
+    FreeLists(const FreeLists &other) = delete;
+    FreeLists &operator=(const FreeLists &other) = delete;
+
+    ~FreeLists() {
+        free_lists_destroyed = true;
+        for (auto head : heads) {
+            while (head) {
+                BufferStorage *next = head->_next_free;
+                head->~BufferStorage();
+                ::operator delete(head);
+                head = next;
+            }
+        }
+    }
+};
+
+BufferStorage::FreeLists &BufferStorage::_free_lists() {
+    static thread_local FreeLists lists;
+    return lists;
+}
+
+BufferStorage *BufferStorage::_get(const uint8_t size_class) {
+    if (free_lists_destroyed) {
+        return nullptr;
+    }
+
+    FreeLists &lists = _free_lists();
+    if (size_class < lists.heads.size() and lists.heads[size_class]) {
+        BufferStorage *storage = lists.heads[size_class];
+        lists.heads[size_class] = storage->_next_free;
+        lists.lengths[size_class]--;
+        thread_stats.reuses++;
+        storage->_next_free = nullptr;
+        storage->_refs = 1;
+        return storage;
+    }
+    return nullptr;
+}
+
+//! \param[in] size is the number of bytes the caller will write (through data()) before sharing the storage
+BufferStorage *BufferStorage::allocate(const size_t size) {
+    const auto size_class = static_cast<uint8_t>(
+        lower_bound(SIZE_CLASSES.begin(), SIZE_CLASSES.end(), size) - SIZE_CLASSES.begin());
+    const bool pooled = size_class < SIZE_CLASSES.size();
+
+    // (past the last size class is the ADOPTED list, whose blocks have no room for the bytes)
+    BufferStorage *storage = pooled ? _get(size_class) : nullptr;
+    if (not storage) {
+        const size_t capacity = pooled ? SIZE_CLASSES[size_class] : size;
+        storage = new (::operator new(sizeof(BufferStorage) + capacity))
+            BufferStorage(pooled ? size_class : uint8_t{UNPOOLED});
+        storage->_data = reinterpret_cast<char *>(storage + 1);
+        thread_stats.heap_allocations++;
+    }
+    storage->_size = size;
+    return storage;
+}
+
+//! \param[in] str is the string whose bytes the storage will hold (without copying them)
+BufferStorage *BufferStorage::adopt(string &&str) {
+    BufferStorage *storage = _get(ADOPTED);
+    if (not storage) {
+        storage = new (::operator new(sizeof(BufferStorage))) BufferStorage(ADOPTED);
+        thread_stats.heap_allocations++;
+    }
+    storage->_adopted = move(str);
+    storage->_data = storage->_adopted.data();
+    storage->_size = storage->_adopted.size();
+    return storage;
+}
+
+void BufferStorage::_recycle() {
+    if (_size_class == ADOPTED) {
+        _adopted = string{};  // free the string's bytes now, not when the block is reused
+    }
+
+    if (not free_lists_destroyed and _size_class != UNPOOLED) {
+        FreeLists &lists = _free_lists();
+        if (lists.lengths[_size_class] < MAX_FREE_PER_CLASS) {
+            _next_free = lists.heads[_size_class];
+            lists.heads[_size_class] = this;
+            lists.lengths[_size_class]++;
+            return;
+        }
+    }
+
+    this->~BufferStorage();
+    ::operator delete(this);
+}
+
+BufferStorage::Stats BufferStorage::stats() { return thread_stats; }
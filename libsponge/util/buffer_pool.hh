@@ -0,0 +1,121 @@
+#ifndef SPONGE_LIBSPONGE_BUFFER_POOL_HH
+#define SPONGE_LIBSPONGE_BUFFER_POOL_HH
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+//! \brief Reference-counted storage behind a Buffer, recycled through per-thread free lists
+class BufferStorage {
+  public:
+    //! Capacities of pooled storage; larger requests are allocated exactly and freed on release
+    static constexpr std::array<size_t, 6> SIZE_CLASSES = {64, 256, 1024, 2048, 16384, 65536};
+
+    //! Most free blocks each thread keeps per size class
+    static constexpr size_t MAX_FREE_PER_CLASS = 256;
+
+    //! Counts of where this thread's storage came from
+    struct Stats {
+        uint64_t heap_allocations;  //!< Storage obtained from operator new
+        uint64_t reuses;            //!< Storage taken from a free list
+    };
+
+  private:
+#ifdef SPONGE_SINGLE_THREADED_BUFFERS
+    using RefCount = uint32_t;
+#else
+    using RefCount = std::atomic<uint32_t>;
+#endif
+
+    //! Free lists beyond the size classes
+    enum : uint8_t {
+        ADOPTED = SIZE_CLASSES.size(),  //!< Storage that owns a std::string handed over by adopt()
+        UNPOOLED,                       //!< Storage too big for any size class
+    };
+
+    RefCount _refs{1};
+    uint8_t _size_class;                   //!< Index into SIZE_CLASSES, or ADOPTED or UNPOOLED
+    size_t _size = 0;                      //!< Number of valid bytes
+    char *_data = nullptr;                 //!< The bytes (just after this object, or in `_adopted`)
+    std::string _adopted{};                //!< Owner of the bytes, for storage made by adopt()
+    BufferStorage *_next_free = nullptr;  //!< Link in this thread's free list
+
+    struct FreeLists;
+    static FreeLists &_free_lists();
+
+    explicit BufferStorage(const uint8_t size_class) : _size_class(size_class) {}
+
+    //! Pop storage of the given size class from this thread's free list, or make new storage
+    static BufferStorage *_get(const uint8_t size_class);
+
+    //! Return storage to this thread's free list, or free it
+    void _recycle();
+
+  public:
+    //! \brief Storage for `size` uninitialized bytes, with one reference
+    static BufferStorage *allocate(const size_t size);
+
+    //! \brief Storage that takes ownership of `str`, with one reference
+    static BufferStorage *adopt(std::string &&str);
+
+    //! \name Reference counting
+    //!@{
+    void add_ref() {
+#ifdef SPONGE_SINGLE_THREADED_BUFFERS
+        _refs++;
+#else
+        _refs.fetch_add(1, std::memory_order_relaxed);
+#endif
+    }
+
+    void release() {
+#ifdef SPONGE_SINGLE_THREADED_BUFFERS
+        if (--_refs == 0) {
+            _recycle();
+        }
+#else
+        if (_refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            _recycle();
+        }
+#endif
+    }
+
+    //! Is this the only reference (so the bytes may be written)?
+    bool unique() const { return _refs == 1; }
+    //!@}
+
+    //! The bytes
+    std::string_view str() const { return {_data, _size}; }
+
+    //! The bytes, for writing (only while unique())
+    char *data() { return _data; }
+
+    //! Discard all but the first `size` bytes (only while unique(), e.g. after a short read)
+    void truncate(const size_t size) { _size = std::min(_size, size); }
+
+    //! Counts for the calling thread's allocations
+    static Stats stats();
+
+    //! \name
+    //! Storage is shared by reference counting, never copied or moved
+    //!@{
+    BufferStorage(const BufferStorage &other) = delete;
+    BufferStorage &operator=(const BufferStorage &other) = delete;
+    //!@}
+};
+
+//! \class BufferStorage
+//! Each Buffer used to hold a `shared_ptr<std::string>`: a control block, a string and an atomic
+//! reference count, allocated for every segment, header and frame. A BufferStorage is one block
+//! holding the count, and (for allocate()) the bytes themselves right after it. When the last
+//! reference goes away, the block goes onto the releasing thread's free list for its size class,
+//! so a steady stream of packets reuses the same few blocks without calling the allocator.
+//!
+//! Configuring with `-DSPONGE_SINGLE_THREADED_BUFFERS=ON` makes the reference count a plain
+//! integer, for programs that never share a Buffer between threads.
+
+#endif  // SPONGE_LIBSPONGE_BUFFER_POOL_HH
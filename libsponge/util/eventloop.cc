@@ -2,7 +2,9 @@
 
 #include "util.hh"
 
+#include <algorithm>
 #include <cerrno>
+#include <limits>
 #include <stdexcept>
 #include <system_error>
 #include <utility>
@@ -10,6 +12,8 @@
 
 using namespace std;
 
+EventLoop::EventLoop() : _epoll(SystemCall("epoll_create1", ::epoll_create1(EPOLL_CLOEXEC))) {}
+
 unsigned int EventLoop::Rule::service_count() const {
     return direction == Direction::In ? fd.read_count() : fd.write_count();
 }
@@ -25,121 +29,284 @@ void EventLoop::add_rule(const FileDescriptor &fd,
                          const CallbackT &callback,
                          const InterestT &interest,
                          const CallbackT &cancel) {
-    _rules.push_back({fd.duplicate(), direction, callback, interest, cancel});
+    _registrations[fd.fd_num()].rules.push_back({fd.duplicate(), direction, callback, interest, cancel});
+}
+
+//! \param[in] delay_ms is how long from now the callback will be called
+//! \param[in] callback is called once, and then the timer is gone
+//! \returns an id with which to cancel the timer before it expires
+EventLoop::TimerId EventLoop::add_timer(const uint64_t delay_ms, const CallbackT &callback) {
+    return _add_timer(chrono::milliseconds(delay_ms), Clock::duration::zero(), [callback](uint64_t) { callback(); });
+}
+
+//! \param[in] period_ms is the time between calls (the first of which is `period_ms` from now)
+//! \param[in] callback is called with the number of milliseconds since it was last called (or added), which
+//!                     may exceed `period_ms` if the loop was busy; e.g. a TCPConnection's `tick`
+//! \returns an id with which to cancel the timer
+EventLoop::TimerId EventLoop::add_periodic(const uint64_t period_ms, const PeriodicT &callback) {
+    if (period_ms == 0) {
+        throw runtime_error("EventLoop::add_periodic: period must be positive");
+    }
+    return _add_timer(chrono::milliseconds(period_ms), chrono::milliseconds(period_ms), PeriodicT{callback});
+}
+
+EventLoop::TimerId EventLoop::_add_timer(const Clock::duration delay,
+                                         const Clock::duration period,
+                                         PeriodicT &&callback) {
+    const auto now = Clock::now();
+    const TimerId id = _next_timer_id++;
+    _timers.emplace(id, Timer{move(callback), period, now, now + delay});
+    _deadlines.push_back({now + delay, id});
+    push_heap(_deadlines.begin(), _deadlines.end());
+    return id;
+}
+
+//! \details Canceling a timer that has already expired (or been canceled) does nothing. A timer's
+//! callback may cancel the timer itself.
+void EventLoop::cancel_timer(const TimerId id) {
+    if (id == _running_timer) {
+        _running_timer_canceled = true;
+    }
+    _timers.erase(id);  // its deadline is discarded from the heap when it comes up
+}
+
+int EventLoop::_next_timeout(const int timeout_ms) {
+    // discard the deadlines of canceled timers
+    while (not _deadlines.empty()) {
+        const auto timer = _timers.find(_deadlines.front().id);
+        if (timer != _timers.end() and timer->second.deadline == _deadlines.front().when) {
+            break;
+        }
+        pop_heap(_deadlines.begin(), _deadlines.end());
+        _deadlines.pop_back();
+    }
+
+    if (_deadlines.empty()) {
+        return timeout_ms;
+    }
+
+    // round up, so as not to wake up just before the deadline
+    const auto until_deadline = max(_deadlines.front().when - Clock::now(), Clock::duration::zero());
+    const auto until_deadline_ms = chrono::ceil<chrono::milliseconds>(until_deadline).count();
+    if (timeout_ms >= 0 and timeout_ms < until_deadline_ms) {
+        return timeout_ms;
+    }
+    return static_cast<int>(min<int64_t>(until_deadline_ms, numeric_limits<int>::max()));
+}
+
+bool EventLoop::_run_timers() {
+    bool ran = false;
+    const auto now = Clock::now();
+
+    while (not _deadlines.empty() and _deadlines.front().when <= now) {
+        const Deadline due = _deadlines.front();
+        pop_heap(_deadlines.begin(), _deadlines.end());
+        _deadlines.pop_back();
+
+        // take the timer out while its callback runs (which may add or cancel timers)
+        auto node = _timers.extract(due.id);
+        if (node.empty() or node.mapped().deadline != due.when) {
+            continue;  // canceled
+        }
+        Timer &timer = node.mapped();
+
+        const auto elapsed = chrono::duration_cast<chrono::milliseconds>(now - timer.last_run);
+        timer.last_run += elapsed;  // keep the remainder for next time
+
+        _running_timer = due.id;
+        _running_timer_canceled = false;
+        timer.callback(elapsed.count());
+        _running_timer = 0;
+        ran = true;
+
+        if (timer.period != Clock::duration::zero() and not _running_timer_canceled) {
+            // stay on the original schedule, unless the loop has fallen a whole period behind
+            timer.deadline = max(timer.deadline + timer.period, now + chrono::milliseconds(1));
+            _deadlines.push_back({timer.deadline, due.id});
+            push_heap(_deadlines.begin(), _deadlines.end());
+            _timers.insert(move(node));
+        }
+    }
+
+    return ran;
 }
 
-//! \param[in] timeout_ms is the timeout value passed to [poll(2)](\ref man2::poll); `wait_next_event`
+bool EventLoop::_update(const int fd_num, Registration &registration) {
+    uint32_t events = 0;
+    bool closed = false;  // was the file registered under this number closed?
+    for (auto it = registration.rules.begin(); it != registration.rules.end();) {
+        auto &this_rule = *it;
+        if ((this_rule.direction == Direction::In && this_rule.fd.eof()) or this_rule.fd.closed()) {
+            // no more reading (or writing) on this rule
+            closed = closed or this_rule.fd.closed();
+            this_rule.cancel();
+            it = registration.rules.erase(it);
+            continue;
+        }
+
+        this_rule.polled = this_rule.interest();
+        if (this_rule.polled) {
+            events |= static_cast<uint32_t>(this_rule.direction);
+        }
+        ++it;
+    }
+
+    if (registration.always_ready and (closed or registration.rules.empty())) {
+        _always_ready.erase(find(_always_ready.begin(), _always_ready.end(), fd_num));
+    }
+
+    if (registration.rules.empty()) {
+        // a closed fd has already left the epoll set on its own
+        if (registration.added and not registration.always_ready and not closed) {
+            ::epoll_ctl(_epoll.fd_num(), EPOLL_CTL_DEL, fd_num, nullptr);
+        }
+        return false;
+    }
+
+    if (closed) {
+        // the remaining rules are on a new file that reused the number, which epoll hasn't seen yet
+        registration = Registration{move(registration.rules)};
+    }
+
+    if (not registration.added) {
+        // registered even with an empty mask, so that errors and hangups are still reported
+        epoll_event event{events, {}};
+        event.data.fd = fd_num;
+        // EPERM means epoll can't watch this kind of fd (e.g. a regular file)
+        if (SystemCall("epoll_ctl", ::epoll_ctl(_epoll.fd_num(), EPOLL_CTL_ADD, fd_num, &event), EPERM) < 0) {
+            registration.always_ready = true;
+            _always_ready.push_back(fd_num);
+        }
+        registration.added = true;
+    } else if (events != registration.events and not registration.always_ready) {
+        epoll_event event{events, {}};
+        event.data.fd = fd_num;
+        SystemCall("epoll_ctl", ::epoll_ctl(_epoll.fd_num(), EPOLL_CTL_MOD, fd_num, &event));
+    }
+    registration.events = events;
+    return true;
+}
+
+void EventLoop::_dispatch(Registration &registration, const uint32_t revents) {
+    if (revents & EPOLLERR) {
+        throw runtime_error("EventLoop: error on polled file descriptor");
+    }
+
+    // NOTE: a callback may add rules to this list, but only this loop removes them
+    for (auto it = registration.rules.begin(); it != registration.rules.end();) {
+        auto &this_rule = *it;
+        const auto poll_ready = this_rule.polled and (revents & static_cast<uint32_t>(this_rule.direction));
+        const auto poll_hup = static_cast<bool>(revents & EPOLLHUP);
+        if (poll_hup && this_rule.polled && !poll_ready) {
+            // if we asked for the status, and the _only_ condition was a hangup, this FD is defunct:
+            //   - if it was EPOLLIN and nothing is readable, no more will ever be readable
+            //   - if it was EPOLLOUT, it will not be writable again
+            this_rule.cancel();
+            it = registration.rules.erase(it);
+            continue;
+        }
+
+        if (poll_ready) {
+            // we only want to call callback if revents includes the event we asked for
+            const auto count_before = this_rule.service_count();
+            this_rule.callback();
+
+            // only check for busy wait if we're not canceling or exiting
+            if (count_before == this_rule.service_count() and this_rule.interest()) {
+                throw runtime_error(
+                    "EventLoop: busy wait detected: callback did not read/write fd and is still interested");
+            }
+        }
+
+        ++it;  // if we got here, it means we didn't call rules.erase()
+    }
+}
+
+//! \param[in] timeout_ms is the timeout value passed to [epoll_wait(2)](\ref man2::epoll_wait); `wait_next_event`
 //!                       returns Result::Timeout if no fd is ready after the timeout expires.
 //! \returns Eventloop::Result indicating success, timeout, or no more Rule objects to poll.
 //!
-//! For each Rule, this function first calls Rule::interest; if `true`, Rule::fd is added to the
-//! list of file descriptors to be polled for readability (if Rule::direction == Direction::In) or
-//! writability (if Rule::direction == Direction::Out) unless Rule::fd has reached EOF, in which case
-//! the Rule is canceled (i.e., deleted from EventLoop::_rules).
+//! For each Rule, this function first calls Rule::interest; if `true`, Rule::fd is watched for
+//! readability (if Rule::direction == Direction::In) or writability (if Rule::direction == Direction::Out)
+//! unless Rule::fd has reached EOF, in which case the Rule is canceled (i.e., deleted from
+//! EventLoop::_registrations). Only an fd whose set of interested directions changed since the last call
+//! costs a system call ([epoll_ctl(2)](\ref man2::epoll_ctl)).
 //!
-//! Next, this function calls [poll(2)](\ref man2::poll) with timeout value `timeout_ms`.
+//! Next, this function calls [epoll_wait(2)](\ref man2::epoll_wait) with timeout value `timeout_ms`,
+//! or the time until the earliest timer is due if that is sooner.
 //!
 //! Then, for each ready file descriptor, this function calls Rule::callback. If fd reaches EOF or
 //! if the Rule was registered using EventLoop::add_cancelable_rule and Rule::callback returns true,
-//! this Rule is canceled.
+//! this Rule is canceled. Finally, it calls the callback of each timer that is due.
 //!
 //! If an error occurs during polling, this function throws a std::runtime_error.
 //!
-//! If a [signal(7)](\ref man7::signal) was caught during polling or if EventLoop::_rules becomes empty,
-//! this function returns Result::Exit.
+//! If a [signal(7)](\ref man7::signal) was caught during polling or if EventLoop::_registrations becomes
+//! empty (or uninterested) with no timers pending, this function returns Result::Exit.
 //!
-//! If a timeout occurred while polling (i.e., no fd became ready), this function returns Result::Timeout.
+//! If a timeout occurred while polling (i.e., no fd became ready and no timer was due), this function
+//! returns Result::Timeout.
 //!
 //! Otherwise, this function returns Result::Success.
 //!
 //! \b IMPORTANT: every call to Rule::callback must read from or write to Rule::fd, or the `interest`
 //! callback must stop returning true after the callback completes.
 //! If none of these conditions occur, EventLoop::wait_next_event will throw std::runtime_error. This is
-//! because [poll(2)](\ref man2::poll) is level triggered, so failing to act on a ready file descriptor
-//! will result in a busy loop (poll returns on a ready file descriptor; file descriptor is not read or
-//! written, so it is still ready; the next call to poll will immediately return).
+//! because epoll is used in level-triggered mode, so failing to act on a ready file descriptor
+//! will result in a busy loop (epoll_wait returns on a ready file descriptor; file descriptor is not read or
+//! written, so it is still ready; the next call to epoll_wait will immediately return).
 EventLoop::Result EventLoop::wait_next_event(const int timeout_ms) {
-    vector<pollfd> pollfds{};
-    pollfds.reserve(_rules.size());
     bool something_to_poll = false;
 
-    // set up the pollfd for each rule
-    for (auto it = _rules.cbegin(); it != _rules.cend();) {  // NOTE: it gets erased or incremented in loop body
-        const auto &this_rule = *it;
-        if (this_rule.direction == Direction::In && this_rule.fd.eof()) {
-            // no more reading on this rule, it's reached eof
-            this_rule.cancel();
-            it = _rules.erase(it);
+    // bring each fd's registration up to date
+    for (auto it = _registrations.begin(); it != _registrations.end();) {  // NOTE: it gets erased or incremented
+        if (not _update(it->first, it->second)) {
+            it = _registrations.erase(it);
             continue;
         }
-
-        if (this_rule.fd.closed()) {
-            this_rule.cancel();
-            it = _rules.erase(it);
-            continue;
-        }
-
-        if (this_rule.interest()) {
-            pollfds.push_back({this_rule.fd.fd_num(), static_cast<short>(this_rule.direction), 0});
-            something_to_poll = true;
-        } else {
-            pollfds.push_back({this_rule.fd.fd_num(), 0, 0});  // placeholder --- we still want errors
-        }
+        something_to_poll |= it->second.events != 0;
         ++it;
     }
+    const bool something_always_ready = any_of(_always_ready.begin(), _always_ready.end(), [&](const int fd_num) {
+        return _registrations.at(fd_num).events != 0;
+    });
 
-    // quit if there is nothing left to poll
-    if (not something_to_poll) {
+    // quit if there is nothing left to poll or wait for
+    if (not something_to_poll and _timers.empty()) {
         return Result::Exit;
     }
 
-    // call poll -- wait until one of the fds satisfies one of the rules (writeable/readable)
+    // call epoll_wait -- wait until one of the fds satisfies one of the rules (writeable/readable)
+    _ready.resize(max({_ready.size(), _registrations.size(), size_t{1}}));
+    int ready_count = 0;
     try {
-        if (0 == SystemCall("poll", ::poll(pollfds.data(), pollfds.size(), timeout_ms))) {
-            return Result::Timeout;
-        }
+        const int wait_ms = something_always_ready ? 0 : _next_timeout(timeout_ms);
+        ready_count = SystemCall("epoll_wait", ::epoll_wait(_epoll.fd_num(), _ready.data(), _ready.size(), wait_ms));
     } catch (unix_error const &e) {
         if (e.code().value() == EINTR) {
             return Result::Exit;
         }
+        throw;
     }
 
-    // go through the poll results
-
-    for (auto [it, idx] = make_pair(_rules.begin(), size_t(0)); it != _rules.end(); ++idx) {
-        const auto &this_pollfd = pollfds[idx];
-
-        const auto poll_error = static_cast<bool>(this_pollfd.revents & (POLLERR | POLLNVAL));
-        if (poll_error) {
-            throw runtime_error("EventLoop: error on polled file descriptor");
-        }
-
-        const auto &this_rule = *it;
-        const auto poll_ready = static_cast<bool>(this_pollfd.revents & this_pollfd.events);
-        const auto poll_hup = static_cast<bool>(this_pollfd.revents & POLLHUP);
-        if (poll_hup && this_pollfd.events && !poll_ready) {
-            // if we asked for the status, and the _only_ condition was a hangup, this FD is defunct:
-            //   - if it was POLLIN and nothing is readable, no more will ever be readable
-            //   - if it was POLLOUT, it will not be writable again
-            this_rule.cancel();
-            it = _rules.erase(it);
-            continue;
-        }
-
-        if (poll_ready) {
-            // we only want to call callback if revents includes the event we asked for
-            const auto count_before = this_rule.service_count();
-            this_rule.callback();
+    if (ready_count == 0 and not something_always_ready) {
+        return _run_timers() ? Result::Success : Result::Timeout;
+    }
 
-            // only check for busy wait if we're not canceling or exiting
-            if (count_before == this_rule.service_count() and this_rule.interest()) {
-                throw runtime_error(
-                    "EventLoop: busy wait detected: callback did not read/write fd and is still interested");
-            }
+    // run the rules on the ready fds
+    for (int i = 0; i < ready_count; i++) {
+        const auto registration = _registrations.find(_ready[i].data.fd);
+        if (registration != _registrations.end()) {
+            _dispatch(registration->second, _ready[i].events);
         }
+    }
 
-        ++it;  // if we got here, it means we didn't call _rules.erase()
+    // and on the fds that are always ready (for whatever they are polled for)
+    for (const int fd_num : _always_ready) {
+        Registration &registration = _registrations.at(fd_num);
+        _dispatch(registration, registration.events);
     }
 
+    _run_timers();
     return Result::Success;
 }
@@ -3,23 +3,32 @@
 
 #include "file_descriptor.hh"
 
+#include <chrono>
+#include <cstdint>
 #include <cstdlib>
 #include <functional>
 #include <list>
-#include <poll.h>
+#include <map>
+#include <sys/epoll.h>
+#include <unordered_map>
+#include <vector>
 
 //! Waits for events on file descriptors and executes corresponding callbacks.
 class EventLoop {
   public:
     //! Indicates interest in reading (In) or writing (Out) a polled fd.
     enum class Direction : short {
-        In = POLLIN,   //!< Callback will be triggered when Rule::fd is readable.
-        Out = POLLOUT  //!< Callback will be triggered when Rule::fd is writable.
+        In = EPOLLIN,   //!< Callback will be triggered when Rule::fd is readable.
+        Out = EPOLLOUT  //!< Callback will be triggered when Rule::fd is writable.
     };
 
+    using TimerId = uint64_t;  //!< Identifies a timer added with add_timer() or add_periodic()
+
   private:
-    using CallbackT = std::function<void(void)>;  //!< Callback for ready Rule::fd
-    using InterestT = std::function<bool(void)>;  //!< `true` return indicates Rule::fd should be polled.
+    using CallbackT = std::function<void(void)>;      //!< Callback for ready Rule::fd
+    using InterestT = std::function<bool(void)>;      //!< `true` return indicates Rule::fd should be polled.
+    using PeriodicT = std::function<void(uint64_t)>;  //!< Timer callback, given the ms since it last ran
+    using Clock = std::chrono::steady_clock;
 
     //! \brief Specifies a condition and callback that an EventLoop should handle.
     //! \details Created by calling EventLoop::add_rule() or EventLoop::add_cancelable_rule().
@@ -30,19 +39,74 @@ class EventLoop {
         CallbackT callback;   //!< A callback that reads or writes fd.
         InterestT interest;   //!< A callback that returns `true` whenever fd should be polled.
         CallbackT cancel;     //!< A callback that is called when the rule is cancelled (e.g. on hangup)
+        bool polled = false;  //!< Was `interest` true when the current wait began?
 
         //! Returns the number of times fd has been read or written, depending on the value of Rule::direction.
         //! \details This function is used internally by EventLoop; you will not need to call it
         unsigned int service_count() const;
     };
 
-    std::list<Rule> _rules{};  //!< All rules that have been added and not canceled.
+    //! \brief The rules for one file descriptor number, and what epoll is watching it for
+    struct Registration {
+        std::list<Rule> rules{};    //!< Rules on this fd that have been added and not canceled.
+        uint32_t events = 0;        //!< The interest mask epoll currently has for this fd.
+        bool added = false;         //!< Has this fd been added to the epoll instance?
+        bool always_ready = false;  //!< Is this an fd that epoll can't watch (e.g. a regular file)?
+    };
+
+    FileDescriptor _epoll;                         //!< The epoll instance
+    std::map<int, Registration> _registrations{};  //!< All rules, by fd number
+    std::vector<int> _always_ready{};              //!< Numbers of the fds whose registrations are always ready
+    std::vector<epoll_event> _ready{};             //!< Results of epoll_wait (reused)
+
+    //! \brief A timer that has been added and not canceled (or, for a one-shot timer, run)
+    struct Timer {
+        PeriodicT callback;          //!< Called when the timer expires
+        Clock::duration period;      //!< How often a periodic timer runs (zero for a one-shot timer)
+        Clock::time_point last_run;  //!< When the callback last ran (or the timer was added)
+        Clock::time_point deadline;  //!< When the callback will next run
+    };
+
+    //! \brief A timer's deadline, in the heap of deadlines
+    struct Deadline {
+        Clock::time_point when;
+        TimerId id;
+
+        //! Order the heap so that the earliest deadline is on top
+        bool operator<(const Deadline &other) const { return when > other.when; }
+    };
+
+    std::unordered_map<TimerId, Timer> _timers{};  //!< All pending timers
+    std::vector<Deadline> _deadlines{};            //!< Heap of deadlines (including canceled timers')
+    TimerId _next_timer_id = 1;                    //!< The id of the next timer to be added
+    TimerId _running_timer = 0;                    //!< The timer whose callback is running, if any
+    bool _running_timer_canceled = false;          //!< Did the running callback cancel its own timer?
+
+    //! Add a timer that first runs after `delay`
+    TimerId _add_timer(const Clock::duration delay, const Clock::duration period, PeriodicT &&callback);
+
+    //! Milliseconds to wait for fd events before the next timer is due (or `timeout_ms`, if sooner)
+    int _next_timeout(const int timeout_ms);
+
+    //! Run the callbacks of the timers that are due
+    //! \returns `true` if any ran
+    bool _run_timers();
+
+    //! Cancel dead rules, collect the live ones' interest, and bring epoll's mask for `fd_num` up to date
+    //! \returns `false` if no rules on the fd remain
+    bool _update(const int fd_num, Registration &registration);
+
+    //! Call the callbacks of the rules on an fd that epoll reported `revents` for
+    void _dispatch(Registration &registration, const uint32_t revents);
 
   public:
+    //! Create the epoll instance
+    EventLoop();
+
     //! Returned by each call to EventLoop::wait_next_event.
     enum class Result {
-        Success,  //!< At least one Rule was triggered.
-        Timeout,  //!< No rules were triggered before timeout.
+        Success,  //!< At least one Rule or timer was triggered.
+        Timeout,  //!< No rules or timers were triggered before timeout.
         Exit  //!< All rules have been canceled or were uninterested; make no further calls to EventLoop::wait_next_event.
     };
 
@@ -53,7 +117,17 @@ class EventLoop {
                   const InterestT &interest = [] { return true; },
                   const CallbackT &cancel = [] {});
 
-    //! Calls [poll(2)](\ref man2::poll) and then executes callback for each ready fd.
+    //! Call `callback` once, `delay_ms` milliseconds from now
+    TimerId add_timer(const uint64_t delay_ms, const CallbackT &callback);
+
+    //! Call `callback` every `period_ms` milliseconds, with the number of milliseconds since it last ran
+    TimerId add_periodic(const uint64_t period_ms, const PeriodicT &callback);
+
+    //! Stop a timer (that has not already run, if it was a one-shot timer)
+    void cancel_timer(const TimerId id);
+
+    //! Calls [epoll_wait(2)](\ref man2::epoll_wait) until an fd is ready or a timer is due,
+    //! and then executes callback for each ready fd and each due timer.
     Result wait_next_event(const int timeout_ms);
 };
 
@@ -61,8 +135,22 @@ using Direction = EventLoop::Direction;
 
 //! \class EventLoop
 //!
-//! An EventLoop holds a std::list of Rule objects. Each time EventLoop::wait_next_event is
-//! executed, the EventLoop uses the Rule objects to construct a call to [poll(2)](\ref man2::poll).
+//! An EventLoop also keeps a heap of timer deadlines. EventLoop::wait_next_event sleeps until
+//! exactly the earliest deadline (or `timeout_ms`, or an fd event, whichever comes first), so
+//! time-driven code doesn't have to pick a polling interval and measure elapsed time itself:
+//!
+//! ~~~{.cpp}
+//! loop.add_periodic(10, [&](const uint64_t ms_since_last_tick) { connection.tick(ms_since_last_tick); });
+//! ~~~
+//!
+//! While any timer is pending, EventLoop::wait_next_event does not return Result::Exit.
+//!
+//! An EventLoop holds Rule objects grouped by file descriptor, each of which is registered once
+//! with an [epoll(7)](\ref man7::epoll) instance. Each time EventLoop::wait_next_event is executed,
+//! the EventLoop asks each Rule whether it is still interested, changes epoll's interest mask for
+//! an fd only when the answer changes, and then runs only the rules whose fds epoll reports ready.
+//! (File descriptors that epoll can't watch, like regular files, are treated as always ready, as
+//! [poll(2)](\ref man2::poll) does.)
 //!
 //! When a Rule is installed using EventLoop::add_rule, it will be polled for the specified Rule::direction
 //! whenver the Rule::interest callback returns `true`, until Rule::fd is no longer readable
@@ -1,5 +1,6 @@
 #include "file_descriptor.hh"
 
+#include "pcap_writer.hh"
 #include "util.hh"
 
 #include <algorithm>
@@ -44,23 +45,40 @@ FileDescriptor::FileDescriptor(shared_ptr<FDWrapper> other_shared_ptr) : _intern
 //! \returns a copy of this FileDescriptor
 FileDescriptor FileDescriptor::duplicate() const { return FileDescriptor(_internal_fd); }
 
-//! \param[in] limit is the maximum number of bytes to read; fewer bytes may be returned
-//! \param[out] str is the string to be read
-void FileDescriptor::read(std::string &str, const size_t limit) {
-    constexpr size_t BUFFER_SIZE = 1024 * 1024;  // maximum size of a read
-    const size_t size_to_read = min(BUFFER_SIZE, limit);
-    str.resize(size_to_read);
-
-    ssize_t bytes_read = SystemCall("read", ::read(fd_num(), str.data(), size_to_read));
-    if (limit > 0 && bytes_read == 0) {
+//! \param[out] buffer is filled from its start, and then truncated to the bytes read
+//! \details Nothing is zero-filled or copied, so the result can be sliced by later layers as is.
+//! Reading 0 bytes from a non-empty `buffer` means EOF.
+size_t FileDescriptor::read(Buffer &buffer) {
+    const size_t size_to_read = buffer.size();
+    const ssize_t bytes_read = SystemCall("read", ::read(fd_num(), buffer.mutable_data(), size_to_read));
+    if (size_to_read > 0 && bytes_read == 0) {
         _internal_fd->_eof = true;
     }
     if (bytes_read > static_cast<ssize_t>(size_to_read)) {
         throw runtime_error("read() read more than requested");
     }
-    str.resize(bytes_read);
+    buffer.truncate(bytes_read);
 
     register_read();
+    if (_internal_fd->_pcap_tap and bytes_read > 0) {
+        _internal_fd->_pcap_tap->capture(buffer.str());
+    }
+    return bytes_read;
+}
+
+//! \param[in] capacity is the maximum number of bytes to read; fewer bytes may be returned
+//! \returns a Buffer holding the bytes read, in storage recycled from earlier reads of similar size
+Buffer FileDescriptor::read_buffer(const size_t capacity) {
+    Buffer ret = Buffer::allocate(capacity);
+    read(ret);
+    return ret;
+}
+
+//! \param[in] limit is the maximum number of bytes to read; fewer bytes may be returned
+//! \param[out] str is the string to be read
+void FileDescriptor::read(std::string &str, const size_t limit) {
+    const Buffer bytes = read_buffer(min(DEFAULT_READ_SIZE, limit));
+    str.assign(bytes.str());
 }
 
 //! \param[in] limit is the maximum number of bytes to read; fewer bytes may be returned
@@ -74,10 +92,14 @@ string FileDescriptor::read(const size_t limit) {
 }
 
 size_t FileDescriptor::write(BufferViewList buffer, const bool write_all) {
+    if (_internal_fd->_pcap_tap) {
+        _internal_fd->_pcap_tap->capture(buffer);
+    }
+
     size_t total_bytes_written = 0;
 
     do {
-        auto iovecs = buffer.as_iovecs();
+        const auto &iovecs = buffer.as_iovecs();
 
         const ssize_t bytes_written = SystemCall("writev", ::writev(fd_num(), iovecs.data(), iovecs.size()));
         if (bytes_written == 0 and buffer.size() != 0) {
@@ -98,6 +120,50 @@ size_t FileDescriptor::write(BufferViewList buffer, const bool write_all) {
     return total_bytes_written;
 }
 
+//! \details Unlike write(BufferViewList), this doesn't allocate: the packet is already exactly two
+//! pieces, and a partial write just advances the `iovec`s.
+size_t FileDescriptor::write(const PacketBuffer &packet, const bool write_all) {
+    if (_internal_fd->_pcap_tap) {
+        _internal_fd->_pcap_tap->capture(packet);
+    }
+
+    auto iovecs = packet.as_iovecs();
+    size_t first = 0;
+    size_t remaining = packet.size();
+    size_t total_bytes_written = 0;
+
+    do {
+        const ssize_t bytes_written =
+            SystemCall("writev", ::writev(fd_num(), iovecs.data() + first, iovecs.size() - first));
+        if (bytes_written == 0 and remaining != 0) {
+            throw runtime_error("write returned 0 given non-empty input buffer");
+        }
+
+        if (bytes_written > ssize_t(remaining)) {
+            throw runtime_error("write wrote more than length of input buffer");
+        }
+
+        register_write();
+
+        remaining -= bytes_written;
+        total_bytes_written += bytes_written;
+
+        // skip past what was written
+        for (size_t left = bytes_written; left > 0 and first < iovecs.size();) {
+            if (left >= iovecs[first].iov_len) {
+                left -= iovecs[first].iov_len;
+                first++;
+            } else {
+                iovecs[first].iov_base = static_cast<char *>(iovecs[first].iov_base) + left;
+                iovecs[first].iov_len -= left;
+                left = 0;
+            }
+        }
+    } while (write_all and remaining);
+
+    return total_bytes_written;
+}
+
 void FileDescriptor::set_blocking(const bool blocking_state) {
     int flags = SystemCall("fcntl", fcntl(fd_num(), F_GETFL));
     if (blocking_state) {
@@ -2,23 +2,27 @@
 #define SPONGE_LIBSPONGE_FILE_DESCRIPTOR_HH
 
 #include "buffer.hh"
+#include "packet_buffer.hh"
 
 #include <array>
 #include <cstddef>
 #include <limits>
 #include <memory>
 
+class PcapWriter;
+
 //! A reference-counted handle to a file descriptor
 class FileDescriptor {
     //! \brief A handle on a kernel file descriptor.
     //! \details FileDescriptor objects contain a std::shared_ptr to a FDWrapper.
     class FDWrapper {
       public:
-        int _fd;                    //!< The file descriptor number returned by the kernel
-        bool _eof = false;          //!< Flag indicating whether FDWrapper::_fd is at EOF
-        bool _closed = false;       //!< Flag indicating whether FDWrapper::_fd has been closed
-        unsigned _read_count = 0;   //!< The number of times FDWrapper::_fd has been read
-        unsigned _write_count = 0;  //!< The numberof times FDWrapper::_fd has been written
+        int _fd;                                  //!< The file descriptor number returned by the kernel
+        bool _eof = false;                        //!< Flag indicating whether FDWrapper::_fd is at EOF
+        bool _closed = false;                     //!< Flag indicating whether FDWrapper::_fd has been closed
+        unsigned _read_count = 0;                 //!< The number of times FDWrapper::_fd has been read
+        unsigned _write_count = 0;                //!< The numberof times FDWrapper::_fd has been written
+        std::shared_ptr<PcapWriter> _pcap_tap{};  //!< Optional capture of everything read or written
 
         //! Construct from a file descriptor number returned by the kernel
         explicit FDWrapper(const int fd);
@@ -55,12 +59,22 @@ class FileDescriptor {
     //! Free the std::shared_ptr; the FDWrapper destructor calls close() when the refcount goes to zero.
     ~FileDescriptor() = default;
 
+    //! Most bytes read by one call, unless the caller asks for fewer
+    static constexpr size_t DEFAULT_READ_SIZE = 65536;
+
     //! Read up to `limit` bytes
     std::string read(const size_t limit = std::numeric_limits<size_t>::max());
 
     //! Read up to `limit` bytes into `str` (caller can allocate storage)
     void read(std::string &str, const size_t limit = std::numeric_limits<size_t>::max());
 
+    //! \brief Read up to `capacity` bytes (e.g. one MTU) into pooled storage
+    Buffer read_buffer(const size_t capacity = DEFAULT_READ_SIZE);
+
+    //! \brief Read into a caller-provided Buffer (e.g. from Buffer::allocate()), which is truncated to what was read
+    //! \returns the number of bytes read
+    size_t read(Buffer &buffer);
+
     //! Write a string, possibly blocking until all is written
     size_t write(const char *str, const bool write_all = true) { return write(BufferViewList(str), write_all); }
 
@@ -70,6 +84,9 @@ class FileDescriptor {
     //! Write a buffer (or list of buffers), possibly blocking until all is written
     size_t write(BufferViewList buffer, const bool write_all = true);
 
+    //! Write a packet's headers and payload with one system call, possibly blocking until all is written
+    size_t write(const PacketBuffer &packet, const bool write_all = true);
+
     //! Close the underlying file descriptor
     void close() { _internal_fd->close(); }
 
@@ -79,6 +96,9 @@ class FileDescriptor {
     //! Set blocking(true) or non-blocking(false)
     void set_blocking(const bool blocking_state);
 
+    //! \brief Capture everything read or written to `tap`, one packet per call, or stop capturing if null
+    void set_pcap_tap(std::shared_ptr<PcapWriter> tap) { _internal_fd->_pcap_tap = std::move(tap); }
+
     //! \name FDWrapper accessors
     //!@{
 
@@ -113,5 +133,8 @@ class FileDescriptor {
 //! FileDescriptor::write, which EventLoop uses to detect busy loop conditions.
 //!
 //! For an example of FileDescriptor use, see the EventLoop class documentation.
+//!
+//! A pcap tap is only meaningful on a descriptor that carries one packet per read or write, such as
+//! a TUN or TAP device: it records the bytes exactly as they were sent or received.
 
 #endif  // SPONGE_LIBSPONGE_FILE_DESCRIPTOR_HH
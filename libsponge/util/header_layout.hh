@@ -0,0 +1,113 @@
+#ifndef SPONGE_LIBSPONGE_HEADER_LAYOUT_HH
+#define SPONGE_LIBSPONGE_HEADER_LAYOUT_HH
+
+#include "parser.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+//! \brief How a header field's type converts to and from its value on the wire
+//! \details Integers and `bool`s convert directly; specialize this for other field types.
+template <typename T>
+struct WireValue {
+    static constexpr uint32_t get(const T &value) { return static_cast<uint32_t>(value); }
+    static constexpr T make(const uint32_t wire) { return static_cast<T>(wire); }
+};
+
+//! The unsigned integer type that is `WIDTH` bytes wide
+template <size_t WIDTH>
+using WireInt = std::conditional_t<WIDTH == 1, uint8_t, std::conditional_t<WIDTH == 2, uint16_t, uint32_t>>;
+
+//! \brief One field of a fixed-layout header
+//! \tparam MEMBER is the header struct's data member holding the field
+//! \tparam OFFSET is the byte offset of the big-endian word that contains the field
+//! \tparam WIDTH is the size of that word in bytes (1, 2 or 4)
+//! \tparam MASK selects the field's bits within the word (by default, all of them)
+template <auto MEMBER, size_t OFFSET, size_t WIDTH, uint32_t MASK = WireInt<WIDTH>(~0u)>
+struct HeaderField {
+    static_assert(WIDTH == 1 or WIDTH == 2 or WIDTH == 4, "HeaderField: fields must be 1, 2 or 4 bytes wide");
+    static_assert(MASK != 0 and MASK <= WireInt<WIDTH>(~0u), "HeaderField: mask does not fit in the word");
+
+    static constexpr size_t END = OFFSET + WIDTH;           //!< Offset just past the field's word
+    static constexpr unsigned SHIFT = __builtin_ctz(MASK);  //!< Position of the field's lowest bit
+
+    //! Does the field fill its word (so storing it needn't preserve other fields' bits)?
+    static constexpr bool WHOLE_WORD = MASK == WireInt<WIDTH>(~0u);
+
+    //! Decode the field from `bytes` (which must hold the whole header) into `header`
+    template <typename Header>
+    static void load(Header &header, const char *bytes) {
+        using T = std::remove_cv_t<std::remove_reference_t<decltype(header.*MEMBER)>>;
+        WireInt<WIDTH> word;
+        memcpy(&word, bytes + OFFSET, WIDTH);
+        header.*MEMBER = WireValue<T>::make((net_byteswap(word) & MASK) >> SHIFT);
+    }
+
+    //! \brief Encode the field from `header` into `bytes`
+    //! \details A field that shares its word with others is OR-ed in, so the word must start out zeroed.
+    template <typename Header>
+    static void store(const Header &header, char *bytes) {
+        using T = std::remove_cv_t<std::remove_reference_t<decltype(header.*MEMBER)>>;
+        auto word = static_cast<WireInt<WIDTH>>((WireValue<T>::get(header.*MEMBER) << SHIFT) & MASK);
+        if constexpr (not WHOLE_WORD) {
+            WireInt<WIDTH> others;
+            memcpy(&others, bytes + OFFSET, WIDTH);
+            word |= net_byteswap(others);
+        }
+        word = net_byteswap(word);
+        memcpy(bytes + OFFSET, &word, WIDTH);
+    }
+
+    //! Compare the field in two headers
+    template <typename Header>
+    static bool equal(const Header &a, const Header &b) {
+        return a.*MEMBER == b.*MEMBER;
+    }
+
+    //! Is this field's member one of `OTHERS`?
+    template <auto... OTHERS>
+    static constexpr bool is_one_of() {
+        return (same_member<OTHERS>() or ...);
+    }
+
+  private:
+    template <auto OTHER>
+    static constexpr bool same_member() {
+        if constexpr (std::is_same_v<decltype(MEMBER), decltype(OTHER)>) {
+            return MEMBER == OTHER;
+        } else {
+            return false;
+        }
+    }
+};
+
+//! \brief A fixed-layout header, described by its fields (see HeaderField)
+//! \details Every operation is a fold over the fields, so each one compiles to straight-line loads,
+//! shifts and stores with the offsets and masks as constants.
+template <typename... Fields>
+struct HeaderLayout {
+    static constexpr size_t LENGTH = std::max({Fields::END...});  //!< Bytes covered by the fields
+
+    //! Decode every field from `bytes`, which must hold at least LENGTH bytes
+    template <typename Header>
+    static void parse(Header &header, const char *bytes) {
+        (Fields::load(header, bytes), ...);
+    }
+
+    //! Encode every field into `out`, which must have room for LENGTH bytes (unused bits are zeroed)
+    template <typename Header>
+    static void serialize(const Header &header, char *out) {
+        memset(out, 0, LENGTH);
+        (Fields::store(header, out), ...);
+    }
+
+    //! Compare every field except those whose members are listed in `EXCLUDED`
+    template <auto... EXCLUDED, typename Header>
+    static bool equal(const Header &a, const Header &b) {
+        return ((Fields::template is_one_of<EXCLUDED...>() or Fields::equal(a, b)) and ...);
+    }
+};
+
+#endif  // SPONGE_LIBSPONGE_HEADER_LAYOUT_HH
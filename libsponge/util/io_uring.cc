@@ -0,0 +1,222 @@
+#include "io_uring.hh"
+
+#include "util.hh"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using namespace std;
+
+// glibc has no wrappers for the io_uring system calls
+
+static int io_uring_setup(const unsigned entries, io_uring_params *params) {
+    return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+}
+
+static int io_uring_enter(const int fd, const unsigned to_submit, const unsigned min_complete, const unsigned flags) {
+    return static_cast<int>(::syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+static int io_uring_register(const int fd, const unsigned opcode, void *arg, const unsigned nr_args) {
+    return static_cast<int>(::syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+}
+
+IoUring::Mapping::Mapping(const int fd, const size_t len, const uint64_t offset) : addr(nullptr), length(len) {
+    const int flags = fd < 0 ? MAP_PRIVATE | MAP_ANONYMOUS : MAP_SHARED | MAP_POPULATE;
+    addr = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, flags, fd, static_cast<off_t>(offset));
+    if (addr == MAP_FAILED) {
+        throw unix_error("mmap");
+    }
+}
+
+IoUring::Mapping::~Mapping() { ::munmap(addr, length); }
+
+//! \details Checks that a ring can be set up (io_uring may be missing or forbidden by seccomp) and
+//! that the kernel supports every opcode BatchedIO uses, plus provided buffer rings (Linux 5.19).
+bool IoUring::available() {
+    static const bool probed = [] {
+        try {
+            IoUring ring{2};
+
+            // an io_uring_probe, followed by room for its flexible array of ops
+            alignas(io_uring_probe) array<char, sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op)> storage{};
+            auto *probe = reinterpret_cast<io_uring_probe *>(storage.data());
+            SystemCall("io_uring_register", io_uring_register(ring.fd_num(), IORING_REGISTER_PROBE, probe, 256));
+            for (const uint8_t op : {IORING_OP_READ, IORING_OP_RECV, IORING_OP_WRITEV, IORING_OP_ASYNC_CANCEL}) {
+                if (op > probe->last_op or not(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) {
+                    return false;
+                }
+            }
+
+            ring.register_buffer_ring(1);
+            return true;
+        } catch (const exception &) {
+            return false;
+        }
+    }();
+    return probed;
+}
+
+//! \details Older kernels (and some that have multishot receives) reject a multishot receive whose
+//! length isn't zero, so the probe asks for one exactly as BatchedIO does.
+bool IoUring::multishot_recv_available() {
+    static const bool probed = [] {
+        if (not available()) {
+            return false;
+        }
+        try {
+            int fds[2];
+            SystemCall("socketpair", ::socketpair(AF_UNIX, SOCK_DGRAM, 0, static_cast<int *>(fds)));
+            const FileDescriptor sender{fds[0]}, receiver{fds[1]};
+            array<char, 16> buffer{};
+
+            IoUring ring{2};  // (closed first, which cancels the receive)
+            ring.register_buffer_ring(1);
+            ring.provide_buffer(buffer.data(), buffer.size(), 0);
+            ring.commit_buffers();
+            io_uring_sqe &sqe = ring.prepare(IORING_OP_RECV, receiver.fd_num(), 0);
+            sqe.flags = IOSQE_BUFFER_SELECT;
+            sqe.buf_group = BUFFER_GROUP;
+            sqe.ioprio = IORING_RECV_MULTISHOT;
+            ring.submit();
+
+            SystemCall("send", ::send(sender.fd_num(), "x", 1, 0));
+            ring.submit(1);
+            bool received = false;
+            ring.reap([&](const io_uring_cqe &cqe) {
+                // (the next completion may say the one buffer has run out)
+                if (cqe.res == 1 and (cqe.flags & IORING_CQE_F_MORE)) {
+                    received = true;
+                }
+            });
+            return received;
+        } catch (const exception &) {
+            return false;
+        }
+    }();
+    return probed;
+}
+
+pair<int, io_uring_params> IoUring::_setup(const unsigned entries) {
+    io_uring_params params{};
+    const int fd = SystemCall("io_uring_setup", io_uring_setup(entries, &params));
+    if (not(params.features & IORING_FEAT_SINGLE_MMAP)) {
+        ::close(fd);
+        throw runtime_error("IoUring: kernel is too old (no IORING_FEAT_SINGLE_MMAP)");
+    }
+    return {fd, params};
+}
+
+//! \param[in] entries is the size of the submission queue (rounded up to a power of two by the kernel);
+//!                    the completion queue is twice as big
+IoUring::IoUring(const unsigned entries) : IoUring(_setup(entries)) {}
+
+IoUring::IoUring(const pair<int, io_uring_params> &setup)
+    : FileDescriptor(setup.first)
+    , _params(setup.second)
+    , _rings(fd_num(),
+             max(_params.sq_off.array + _params.sq_entries * sizeof(uint32_t),
+                 _params.cq_off.cqes + _params.cq_entries * sizeof(io_uring_cqe)),
+             IORING_OFF_SQ_RING)
+    , _sqes(fd_num(), _params.sq_entries * sizeof(io_uring_sqe), IORING_OFF_SQES)
+    , _sq_head(_rings.at<uint32_t>(_params.sq_off.head))
+    , _sq_tail(_rings.at<uint32_t>(_params.sq_off.tail))
+    , _sq_array(_rings.at<uint32_t>(_params.sq_off.array))
+    , _sq_mask(*_rings.at<uint32_t>(_params.sq_off.ring_mask))
+    , _sq_local_tail(*_sq_tail)
+    , _cq_head(_rings.at<uint32_t>(_params.cq_off.head))
+    , _cq_tail(_rings.at<uint32_t>(_params.cq_off.tail))
+    , _cqes(_rings.at<io_uring_cqe>(_params.cq_off.cqes))
+    , _cq_mask(*_rings.at<uint32_t>(_params.cq_off.ring_mask)) {
+    // submission queue entries are always used in order, so the indirection array is the identity
+    for (uint32_t i = 0; i < _params.sq_entries; i++) {
+        _sq_array[i] = i;
+    }
+}
+
+IoUring::~IoUring() {
+    if (_buf_ring) {
+        io_uring_buf_reg reg{};
+        reg.bgid = BUFFER_GROUP;
+        io_uring_register(fd_num(), IORING_UNREGISTER_PBUF_RING, &reg, 1);
+    }
+}
+
+//! \param[in] opcode is the operation (e.g. `IORING_OP_RECV`)
+//! \param[in] fd is the file descriptor to operate on
+//! \param[in] user_data is returned in the operation's completion(s)
+io_uring_sqe &IoUring::prepare(const uint8_t opcode, const int fd, const uint64_t user_data) {
+    if (_sq_local_tail - __atomic_load_n(_sq_head, __ATOMIC_ACQUIRE) == _params.sq_entries) {
+        submit();
+    }
+
+    io_uring_sqe &sqe = _sqes.at<io_uring_sqe>(0)[_sq_local_tail & _sq_mask];
+    _sq_local_tail++;
+    memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = opcode;
+    sqe.fd = fd;
+    sqe.user_data = user_data;
+    return sqe;
+}
+
+void IoUring::_publish() {
+    _to_submit += _sq_local_tail - *_sq_tail;
+    __atomic_store_n(_sq_tail, _sq_local_tail, __ATOMIC_RELEASE);
+}
+
+//! \param[in] wait_for is the number of completions to wait for (0 to only submit)
+unsigned IoUring::submit(const unsigned wait_for) {
+    _publish();
+    if (_to_submit == 0 and wait_for == 0) {
+        return 0;
+    }
+
+    const unsigned flags = wait_for ? IORING_ENTER_GETEVENTS : 0;
+    const int submitted = SystemCall("io_uring_enter", io_uring_enter(fd_num(), _to_submit, wait_for, flags));
+    _to_submit -= submitted;
+    register_write();
+    return submitted;
+}
+
+//! \param[in] entries is the number of buffers the ring can hold (a power of two, at most 32768)
+void IoUring::register_buffer_ring(const uint16_t entries) {
+    if (_buf_ring) {
+        throw runtime_error("IoUring: buffer ring already registered");
+    }
+    if (entries == 0 or (entries & (entries - 1))) {
+        throw runtime_error("IoUring: buffer ring size must be a power of two");
+    }
+
+    _buf_ring_memory.emplace(-1, entries * sizeof(io_uring_buf), 0);
+    io_uring_buf_reg reg{};
+    reg.ring_addr = reinterpret_cast<uint64_t>(_buf_ring_memory->addr);
+    reg.ring_entries = entries;
+    reg.bgid = BUFFER_GROUP;
+    SystemCall("io_uring_register", io_uring_register(fd_num(), IORING_REGISTER_PBUF_RING, &reg, 1));
+
+    _buf_ring = static_cast<io_uring_buf_ring *>(_buf_ring_memory->addr);
+    _buf_ring_mask = entries - 1;
+    _buf_ring_local_tail = 0;
+}
+
+//! \param[in] addr is where the kernel may write received bytes
+//! \param[in] len is the size of the buffer
+//! \param[in] id identifies the buffer in the completion that used it
+void IoUring::provide_buffer(char *addr, const uint32_t len, const uint16_t id) {
+    // (io_uring_buf_ring::bufs is misplaced when the header is compiled as C++: the entries start at
+    // the beginning of the ring, with the first one's reserved field doubling as the tail)
+    io_uring_buf &buf = static_cast<io_uring_buf *>(_buf_ring_memory->addr)[_buf_ring_local_tail & _buf_ring_mask];
+    buf.addr = reinterpret_cast<uint64_t>(addr);
+    buf.len = len;
+    buf.bid = id;
+    _buf_ring_local_tail++;
+}
+
+void IoUring::commit_buffers() { __atomic_store_n(&_buf_ring->tail, _buf_ring_local_tail, __ATOMIC_RELEASE); }
@@ -0,0 +1,149 @@
+#ifndef SPONGE_LIBSPONGE_IO_URING_HH
+#define SPONGE_LIBSPONGE_IO_URING_HH
+
+#include "file_descriptor.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <linux/io_uring.h>
+#include <optional>
+#include <utility>
+
+//! \brief An [io_uring(7)](\ref man7::io_uring): submission and completion queues shared with the kernel
+class IoUring : public FileDescriptor {
+  private:
+    //! \brief One of the shared memory regions set up by io_uring_setup
+    class Mapping {
+      public:
+        void *addr;
+        size_t length;
+
+        //! Map `len` bytes of `fd` at `offset` (or, if `fd` is -1, `len` bytes of zeroed memory)
+        Mapping(const int fd, const size_t len, const uint64_t offset);
+        ~Mapping();
+
+        //! A pointer `offset` bytes into the region
+        template <typename T>
+        T *at(const uint32_t offset) const {
+            return reinterpret_cast<T *>(static_cast<char *>(addr) + offset);
+        }
+
+        Mapping(const Mapping &other) = delete;
+        Mapping &operator=(const Mapping &other) = delete;
+    };
+
+    io_uring_params _params;
+    Mapping _rings;  //!< The submission and completion rings (one mapping, see IORING_FEAT_SINGLE_MMAP)
+    Mapping _sqes;   //!< The submission queue entries
+
+    //! \name Submission ring
+    //!@{
+    uint32_t *_sq_head, *_sq_tail, *_sq_array;
+    uint32_t _sq_mask;
+    uint32_t _sq_local_tail;  //!< Entries prepared but not yet handed to the kernel end here
+    uint32_t _to_submit = 0;  //!< Entries handed to the kernel but not yet submitted with io_uring_enter
+    //!@}
+
+    //! \name Completion ring
+    //!@{
+    uint32_t *_cq_head, *_cq_tail;
+    io_uring_cqe *_cqes;
+    uint32_t _cq_mask;
+    //!@}
+
+    //! \name The provided buffer ring (see register_buffer_ring())
+    //!@{
+    std::optional<Mapping> _buf_ring_memory{};
+    io_uring_buf_ring *_buf_ring = nullptr;
+    uint16_t _buf_ring_mask = 0;
+    uint16_t _buf_ring_local_tail = 0;
+    //!@}
+
+    //! Call io_uring_setup, returning the ring's fd and parameters
+    static std::pair<int, io_uring_params> _setup(const unsigned entries);
+
+    //! Map the rings of a ring that has been set up
+    explicit IoUring(const std::pair<int, io_uring_params> &setup);
+
+    //! Make the prepared entries visible to the kernel
+    void _publish();
+
+  public:
+    //! The buffer group id of the ring registered with register_buffer_ring()
+    static constexpr uint16_t BUFFER_GROUP = 0;
+
+    //! \brief Can this kernel (and seccomp policy) run io_uring with the operations used by BatchedIO?
+    //! \details Probed once, the first time this is called.
+    static bool available();
+
+    //! \brief Can this kernel run a multishot IORING_OP_RECV (IORING_RECV_MULTISHOT, Linux 6.0)?
+    //! \details Probed once, on a socketpair, the first time this is called.
+    static bool multishot_recv_available();
+
+    //! \brief Set up a ring with room for `entries` submissions
+    explicit IoUring(const unsigned entries);
+
+    //! Unregister the provided buffer ring, if any (the kernel cancels outstanding requests on close)
+    ~IoUring();
+
+    //! \brief A zeroed submission queue entry for `opcode` on `fd`, to be filled in by the caller
+    //! \details If the queue is full, the entries already prepared are submitted first.
+    io_uring_sqe &prepare(const uint8_t opcode, const int fd, const uint64_t user_data);
+
+    //! \brief Submit everything prepared with one io_uring_enter, waiting for at least `wait_for` completions
+    //! \returns the number of entries submitted
+    unsigned submit(const unsigned wait_for = 0);
+
+    //! Number of entries prepared and not yet submitted
+    unsigned pending() const { return _to_submit + (_sq_local_tail - *_sq_tail); }
+
+    //! \brief Call `callback` on each completion queue entry that has arrived, then free them
+    //! \returns the number of entries reaped
+    template <typename Callback>
+    unsigned reap(Callback &&callback) {
+        uint32_t head = *_cq_head;
+        const uint32_t tail = __atomic_load_n(_cq_tail, __ATOMIC_ACQUIRE);
+        const unsigned count = tail - head;
+        for (; head != tail; head++) {
+            const io_uring_cqe cqe = _cqes[head & _cq_mask];
+            __atomic_store_n(_cq_head, head + 1, __ATOMIC_RELEASE);  // the entry was copied; let the kernel reuse it
+            callback(cqe);
+        }
+        if (count) {
+            register_read();
+        }
+        return count;
+    }
+
+    //! \name Provided buffers
+    //! Requests with IOSQE_BUFFER_SELECT in BUFFER_GROUP receive into buffers given with provide_buffer();
+    //! the completion carries the id of the buffer that was used (see IORING_CQE_F_BUFFER).
+    //!@{
+
+    //! \brief Register a ring of `entries` (a power of two) provided buffers as BUFFER_GROUP
+    void register_buffer_ring(const uint16_t entries);
+
+    //! Add a buffer to the ring (visible to the kernel after commit_buffers())
+    void provide_buffer(char *addr, const uint32_t len, const uint16_t id);
+
+    //! Hand the buffers added by provide_buffer() to the kernel
+    void commit_buffers();
+    //!@}
+
+    //! \name
+    //! An IoUring cannot be copied or moved (the kernel and the mappings refer to it)
+    //!@{
+    IoUring(const IoUring &other) = delete;
+    IoUring &operator=(const IoUring &other) = delete;
+    IoUring(IoUring &&other) = delete;
+    IoUring &operator=(IoUring &&other) = delete;
+    //!@}
+};
+
+//! \class IoUring
+//! This is a thin wrapper around the raw system calls (the same protocol liburing implements):
+//! prepare() entries, submit() them in one batch, and later reap() their completions. An IoUring
+//! is a FileDescriptor for the ring, which is readable when completions are waiting, so an
+//! EventLoop can watch it like any other fd; reap() counts as a read.
+
+#endif  // SPONGE_LIBSPONGE_IO_URING_HH
@@ -0,0 +1,80 @@
+#ifndef SPONGE_LIBSPONGE_MPSC_QUEUE_HH
+#define SPONGE_LIBSPONGE_MPSC_QUEUE_HH
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+//! \brief A bounded, lock-free queue that many threads may push to while one thread pops
+template <typename T>
+class MpscQueue {
+  private:
+    //! One place in the ring
+    struct Cell {
+        std::atomic<size_t> sequence{0};  //!< Equals the position that may next be pushed here (+1 once full)
+        T value{};                        //!< The element, while full
+    };
+
+    std::unique_ptr<Cell[]> _cells;
+    size_t _mask;
+    alignas(64) std::atomic<size_t> _tail{0};  //!< Position of the next push (shared by the producers)
+    alignas(64) size_t _head = 0;              //!< Position of the next pop (the consumer's alone)
+
+  public:
+    //! \brief An empty queue with room for `capacity` elements (a power of two)
+    explicit MpscQueue(const size_t capacity) : _cells(std::make_unique<Cell[]>(capacity)), _mask(capacity - 1) {
+        if (capacity == 0 or (capacity & (capacity - 1)) != 0) {
+            throw std::invalid_argument("MpscQueue capacity must be a power of two");
+        }
+        for (size_t i = 0; i < capacity; i++) {
+            _cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    //! \brief Append `value` (from any thread), unless the queue is full
+    //! \returns `false` (leaving `value` alone) if the queue was full
+    bool try_push(T &value) {
+        size_t position = _tail.load(std::memory_order_relaxed);
+        while (true) {
+            Cell &cell = _cells[position & _mask];
+            const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            if (sequence == position) {
+                if (_tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    cell.value = std::move(value);
+                    cell.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (sequence < position) {
+                return false;  // (the consumer hasn't popped this cell since the ring last went round)
+            } else {
+                position = _tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    //! \brief Remove the oldest element into `value` (from the consumer thread only)
+    //! \returns `false` if the queue was empty (or the oldest push hasn't finished)
+    bool try_pop(T &value) {
+        Cell &cell = _cells[_head & _mask];
+        if (cell.sequence.load(std::memory_order_acquire) != _head + 1) {
+            return false;
+        }
+        value = std::move(cell.value);
+        cell.sequence.store(_head + _mask + 1, std::memory_order_release);
+        _head++;
+        return true;
+    }
+
+    //! Number of elements the queue has room for
+    size_t capacity() const { return _mask + 1; }
+};
+
+//! \class MpscQueue
+//! This is Vyukov's bounded queue, with a single consumer. Each producer claims a position with one
+//! compare-and-swap on the tail, then publishes its element with a release-store of the cell's sequence
+//! number; the consumer never writes the tail, and no thread ever waits on a lock. Elements pushed by
+//! one producer are popped in the order it pushed them.
+
+#endif  // SPONGE_LIBSPONGE_MPSC_QUEUE_HH
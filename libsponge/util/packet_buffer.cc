@@ -0,0 +1,48 @@
+#include "packet_buffer.hh"
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+
+//! \param[in] len is the length of the header about to be written
+char *PacketBuffer::prepend(const size_t len) {
+    if (len > _headers_start) {
+        throw runtime_error("PacketBuffer: not enough headroom for header");
+    }
+    _headers_start -= len;
+    return _headroom.data() + _headers_start;
+}
+
+//! \param[in] len is the number of header bytes to discard
+void PacketBuffer::remove_header(const size_t len) {
+    if (len > headers().size()) {
+        throw out_of_range("PacketBuffer::remove_header");
+    }
+    _headers_start += len;
+}
+
+array<iovec, 2> PacketBuffer::as_iovecs() const {
+    const string_view header_bytes = headers();
+    const string_view payload_bytes = _payload.str();
+    return {iovec{const_cast<char *>(header_bytes.data()), header_bytes.size()},
+            iovec{const_cast<char *>(payload_bytes.data()), payload_bytes.size()}};
+}
+
+BufferList PacketBuffer::to_buffer_list() const {
+    const string_view header_bytes = headers();
+    Buffer header_buffer = Buffer::allocate(header_bytes.size());
+    copy(header_bytes.begin(), header_bytes.end(), header_buffer.mutable_data());
+
+    BufferList ret{move(header_buffer)};
+    ret.append(_payload);
+    return ret;
+}
+
+string PacketBuffer::concatenate() const {
+    string ret;
+    ret.reserve(size());
+    ret.append(headers());
+    ret.append(_payload.str());
+    return ret;
+}
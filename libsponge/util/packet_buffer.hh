@@ -0,0 +1,64 @@
+#ifndef SPONGE_LIBSPONGE_PACKET_BUFFER_HH
+#define SPONGE_LIBSPONGE_PACKET_BUFFER_HH
+
+#include "buffer.hh"
+
+#include <array>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <sys/uio.h>
+
+//! \brief An outgoing packet: headers written back-to-front into reserved headroom, followed by a payload
+class PacketBuffer {
+  public:
+    //! Bytes of headroom: enough for an Ethernet header plus IPv4 and TCP headers with maximal options
+    static constexpr size_t HEADROOM = 14 + 60 + 60;
+
+  private:
+    std::array<char, HEADROOM> _headroom{};  //!< Headers occupy the end of this array
+    size_t _headers_start = HEADROOM;        //!< Index in _headroom of the outermost header
+    Buffer _payload{};
+
+  public:
+    //! \brief Construct a packet with no headers and an empty payload
+    PacketBuffer() = default;
+
+    //! \brief Construct a packet with no headers (yet) in front of `payload`
+    explicit PacketBuffer(Buffer payload) : _payload(std::move(payload)) {}
+
+    //! \brief Make room for a header of `len` bytes in front of the packet
+    //! \returns where the caller should write the header
+    char *prepend(const size_t len);
+
+    //! \brief Remove the outermost `len` bytes of headers
+    void remove_header(const size_t len);
+
+    //! \brief The headers, outermost first, as one contiguous region
+    std::string_view headers() const { return {_headroom.data() + _headers_start, HEADROOM - _headers_start}; }
+
+    //! \brief The payload that follows the headers
+    const Buffer &payload() const { return _payload; }
+
+    //! \brief Bytes of headroom still free
+    size_t headroom() const { return _headers_start; }
+
+    //! \brief Size of the whole packet
+    size_t size() const { return headers().size() + _payload.size(); }
+
+    //! \brief The packet as two `iovec`s (headers and payload), e.g. for [writev(2)](\ref man2::writev)
+    std::array<iovec, 2> as_iovecs() const;
+
+    //! \brief Convert to a BufferList (copies the headers into one new Buffer)
+    BufferList to_buffer_list() const;
+
+    //! \brief Make a copy to a new std::string
+    std::string concatenate() const;
+};
+
+//! \class PacketBuffer
+//! Each layer of encapsulation calls prepend() and serializes its header directly in front of the
+//! one above it, so however many layers a packet passes through, its headers stay contiguous and no
+//! layer allocates. The payload is shared with (not copied from) the Buffer it was built from.
+
+#endif  // SPONGE_LIBSPONGE_PACKET_BUFFER_HH
@@ -31,15 +31,11 @@ T NetParser::_parse_int() {
         return 0;
     }
 
-    T ret = 0;
-    for (size_t i = 0; i < len; i++) {
-        ret <<= 8;
-        ret += uint8_t(_buffer.at(i));
-    }
-
+    T ret;
+    memcpy(&ret, _buffer.str().data(), len);
     _buffer.remove_prefix(len);
 
-    return ret;
+    return net_byteswap(ret);
 }
 
 void NetParser::remove_prefix(const size_t n) {
@@ -50,13 +46,22 @@ void NetParser::remove_prefix(const size_t n) {
     _buffer.remove_prefix(n);
 }
 
+//! \param[in] len is the number of bytes to consume (e.g. the length of a fixed-size header)
+optional<NetReader> NetParser::take(const size_t len) {
+    _check_size(len);
+    if (error()) {
+        return nullopt;
+    }
+
+    NetReader reader{_buffer};
+    _buffer.remove_prefix(len);
+    return reader;
+}
+
 template <typename T>
 void NetUnparser::_unparse_int(string &s, T val) {
-    constexpr size_t len = sizeof(T);
-    for (size_t i = 0; i < len; ++i) {
-        const uint8_t the_byte = (val >> ((len - i - 1) * 8)) & 0xff;
-        s.push_back(the_byte);
-    }
+    const T net_val = net_byteswap(val);
+    s.append(reinterpret_cast<const char *>(&net_val), sizeof(T));
 }
 
 uint32_t NetParser::u32() { return _parse_int<uint32_t>(); }
@@ -5,7 +5,10 @@
 
 #include <cstdint>
 #include <cstdlib>
+#include <cstring>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <utility>
 
 //! The result of parsing or unparsing an IP datagram, TCP segment, Ethernet frame, or ARP message
@@ -22,6 +25,50 @@ enum class ParseResult {
 //! Output a string representation of a ParseResult
 std::string as_string(const ParseResult r);
 
+//! Convert an integer between host and network byte order
+template <typename T>
+constexpr T net_byteswap(const T val) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    if constexpr (sizeof(T) == 4) {
+        return __builtin_bswap32(val);
+    } else if constexpr (sizeof(T) == 2) {
+        return __builtin_bswap16(val);
+    }
+#endif
+    return val;
+}
+
+//! \brief Decodes integers in network byte order from bytes that NetParser::take() has already bounds-checked
+class NetReader {
+  private:
+    Buffer _buffer;           //!< Keeps the bytes alive
+    std::string_view _bytes;  //!< Bytes not yet decoded
+
+    template <typename T>
+    T _read() {
+        T val;
+        memcpy(&val, _bytes.data(), sizeof(T));
+        _bytes.remove_prefix(sizeof(T));
+        return net_byteswap(val);
+    }
+
+  public:
+    explicit NetReader(const Buffer &buffer) : _buffer(buffer), _bytes(_buffer.str()) {}
+
+    //! \name Decode the next integer (no bounds checks)
+    //!@{
+    uint32_t u32() { return _read<uint32_t>(); }
+    uint16_t u16() { return _read<uint16_t>(); }
+    uint8_t u8() { return _read<uint8_t>(); }
+    //!@}
+
+    //! Skip over `n` bytes
+    void skip(const size_t n) { _bytes.remove_prefix(n); }
+
+    //! The bytes not yet decoded (e.g. for a HeaderLayout to decode by offset)
+    const char *data() const { return _bytes.data(); }
+};
+
 class NetParser {
   private:
     Buffer _buffer;
@@ -60,6 +107,38 @@ class NetParser {
 
     //! Remove n bytes from the buffer
     void remove_prefix(const size_t n);
+
+    //! \brief Check once that `len` bytes remain, and consume them
+    //! \returns a NetReader that decodes the consumed bytes without further checks, or
+    //! `std::nullopt` (and sets the error) if fewer than `len` bytes remain
+    std::optional<NetReader> take(const size_t len);
+};
+
+//! \brief Encodes integers in network byte order into a preallocated span of bytes
+class NetWriter {
+  private:
+    char *_pos;  //!< Where the next integer goes
+
+    template <typename T>
+    void _write(const T val) {
+        const T net_val = net_byteswap(val);
+        memcpy(_pos, &net_val, sizeof(T));
+        _pos += sizeof(T);
+    }
+
+  public:
+    //! \param[in] out must have room for everything that will be written (it is not checked)
+    explicit NetWriter(char *out) : _pos(out) {}
+
+    //! \name Encode an integer at the cursor and advance past it
+    //!@{
+    void u32(const uint32_t val) { _write(val); }
+    void u16(const uint16_t val) { _write(val); }
+    void u8(const uint8_t val) { _write(val); }
+    //!@}
+
+    //! Where the next integer would be written
+    char *position() const { return _pos; }
 };
 
 struct NetUnparser {
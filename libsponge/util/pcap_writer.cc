@@ -0,0 +1,135 @@
+#include "pcap_writer.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+
+using namespace std;
+
+//! The pcap file header ("usec" variant, written in host byte order)
+struct PcapFileHeader {
+    uint32_t magic_number;   //!< 0xa1b2c3d4 in host byte order
+    uint16_t version_major;  //!< 2
+    uint16_t version_minor;  //!< 4
+    int32_t thiszone;        //!< GMT to local correction (always 0)
+    uint32_t sigfigs;        //!< accuracy of timestamps (always 0)
+    uint32_t snaplen;        //!< max length of captured packets
+    uint32_t network;        //!< link-layer header type
+};
+
+//! The header in front of every packet in a pcap file
+struct PcapRecordHeader {
+    uint32_t ts_sec;    //!< timestamp seconds
+    uint32_t ts_usec;   //!< timestamp microseconds
+    uint32_t incl_len;  //!< number of bytes of the packet saved in the file
+    uint32_t orig_len;  //!< actual length of the packet
+};
+
+//! \param[in] fd is the file to write (e.g. opened with `O_WRONLY | O_CREAT | O_TRUNC`)
+//! \param[in] link_type is the type of header every captured packet starts with
+//! \param[in] ring_size is how many bytes of captured packets can wait in memory for the flusher
+//! \param[in] snaplen is the maximum number of bytes saved per packet
+PcapWriter::PcapWriter(FileDescriptor &&fd, const LinkType link_type, const size_t ring_size, const uint32_t snaplen)
+    : _fd(move(fd)), _snaplen(snaplen), _ring(ring_size) {
+    if (ring_size < sizeof(PcapRecordHeader) + snaplen) {
+        throw runtime_error("PcapWriter: ring is too small to hold one packet");
+    }
+
+    const PcapFileHeader header{0xa1b2c3d4, 2, 4, 0, 0, snaplen, static_cast<uint32_t>(link_type)};
+    _fd.write(string(reinterpret_cast<const char *>(&header), sizeof(header)));
+
+    _flusher = thread([this] { _flush_loop(); });
+}
+
+PcapWriter::~PcapWriter() {
+    try {
+        _stopping.store(true);
+        _wakeup.notify_one();
+        _flusher.join();
+    } catch (const exception &e) {
+        // don't throw an exception from the destructor
+        std::cerr << "Exception destructing PcapWriter: " << e.what() << std::endl;
+    }
+}
+
+void PcapWriter::_copy_in(const uint64_t pos, string_view data) {
+    const size_t offset = pos % _ring.size();
+    const size_t first_part = min(data.size(), _ring.size() - offset);
+    copy_n(data.data(), first_part, _ring.data() + offset);
+    copy_n(data.data() + first_part, data.size() - first_part, _ring.data());
+}
+
+//! \param[in] prefix is copied in front of the packet (may be empty)
+//! \param[in] packet is the packet to capture; bytes beyond the snaplen are not saved
+bool PcapWriter::capture(string_view prefix, const BufferViewList &packet) {
+    const size_t orig_len = prefix.size() + packet.size();
+    const size_t incl_len = min<size_t>(orig_len, _snaplen);
+    const size_t record_len = sizeof(PcapRecordHeader) + incl_len;
+
+    const uint64_t head = _head.load(memory_order_relaxed);
+    if (head + record_len - _tail.load(memory_order_acquire) > _ring.size()) {
+        _dropped.fetch_add(1, memory_order_relaxed);
+        return false;
+    }
+
+    const auto now = chrono::system_clock::now().time_since_epoch();
+    const auto usec = chrono::duration_cast<chrono::microseconds>(now).count();
+    const PcapRecordHeader record{static_cast<uint32_t>(usec / 1000000),
+                                  static_cast<uint32_t>(usec % 1000000),
+                                  static_cast<uint32_t>(incl_len),
+                                  static_cast<uint32_t>(orig_len)};
+
+    uint64_t pos = head;
+    _copy_in(pos, {reinterpret_cast<const char *>(&record), sizeof(record)});
+    pos += sizeof(record);
+
+    size_t remaining = incl_len;
+    const auto copy_piece = [&](string_view piece) {
+        piece = piece.substr(0, remaining);
+        _copy_in(pos, piece);
+        pos += piece.size();
+        remaining -= piece.size();
+    };
+    copy_piece(prefix);
+    for (size_t i = 0; i < packet.num_pieces(); i++) {
+        copy_piece(packet.piece(i));
+    }
+
+    _head.store(pos, memory_order_release);
+    _captured.fetch_add(1, memory_order_relaxed);
+    return true;
+}
+
+void PcapWriter::_flush() {
+    const uint64_t head = _head.load(memory_order_acquire);
+    const uint64_t tail = _tail.load(memory_order_relaxed);
+    if (head == tail) {
+        return;
+    }
+
+    const size_t offset = tail % _ring.size();
+    const size_t len = head - tail;
+    const size_t first_part = min(len, _ring.size() - offset);
+    _fd.write(BufferViewList(string_view(_ring.data() + offset, first_part)));
+    if (len > first_part) {
+        _fd.write(BufferViewList(string_view(_ring.data(), len - first_part)));
+    }
+
+    _tail.store(head, memory_order_release);
+}
+
+void PcapWriter::_flush_loop() {
+    try {
+        while (not _stopping.load()) {
+            {
+                unique_lock<mutex> lock(_wakeup_mutex);
+                _wakeup.wait_for(lock, chrono::milliseconds(FLUSH_INTERVAL_MS), [&] { return _stopping.load(); });
+            }
+            _flush();
+        }
+        _flush();
+    } catch (const exception &e) {
+        std::cerr << "PcapWriter: " << e.what() << std::endl;
+    }
+}
@@ -0,0 +1,101 @@
+#ifndef SPONGE_LIBSPONGE_PCAP_WRITER_HH
+#define SPONGE_LIBSPONGE_PCAP_WRITER_HH
+
+#include "buffer.hh"
+#include "file_descriptor.hh"
+#include "packet_buffer.hh"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+//! \brief Records packets to a [pcap](https://wiki.wireshark.org/Development/LibpcapFileFormat) file
+//! without doing any disk I/O on the caller's thread.
+class PcapWriter {
+  public:
+    //! The link-layer header type of every packet in the file
+    enum class LinkType : uint32_t {
+        Ethernet = 1,  //!< Packets begin with an Ethernet header
+        IPv4 = 228     //!< Packets begin with an IPv4 header
+    };
+
+    static constexpr size_t DEFAULT_RING_SIZE = 4 * 1024 * 1024;  //!< Bytes of captured packets held in memory
+    static constexpr uint32_t DEFAULT_SNAPLEN = 65535;             //!< Maximum bytes captured per packet
+    static constexpr unsigned FLUSH_INTERVAL_MS = 20;              //!< How often the flusher thread wakes up
+
+  private:
+    FileDescriptor _fd;
+    uint32_t _snaplen;
+
+    std::vector<char> _ring;           //!< Captured records, exactly as they will appear in the file
+    std::atomic<uint64_t> _head{0};    //!< Total bytes ever copied into the ring (advanced by capture())
+    std::atomic<uint64_t> _tail{0};    //!< Total bytes ever written to the file (advanced by the flusher)
+    std::atomic<uint64_t> _captured{0};
+    std::atomic<uint64_t> _dropped{0};
+
+    std::atomic<bool> _stopping{false};
+    std::mutex _wakeup_mutex{};
+    std::condition_variable _wakeup{};
+    std::thread _flusher{};
+
+    //! Copy `data` into the ring at absolute position `pos`, wrapping around the end
+    void _copy_in(const uint64_t pos, std::string_view data);
+
+    //! Write everything between _tail and _head to the file
+    void _flush();
+
+    //! Body of the flusher thread
+    void _flush_loop();
+
+  public:
+    //! \brief Write a pcap file header to `fd` and start the flusher thread
+    PcapWriter(FileDescriptor &&fd,
+               const LinkType link_type,
+               const size_t ring_size = DEFAULT_RING_SIZE,
+               const uint32_t snaplen = DEFAULT_SNAPLEN);
+
+    //! Flush any remaining packets and stop the flusher thread
+    ~PcapWriter();
+
+    //! \brief Copy a packet into the ring
+    //! \returns `false` (and counts a drop) if the ring has no room for it
+    bool capture(const BufferViewList &packet) { return capture({}, packet); }
+
+    //! \brief Copy a packet, preceded by `prefix` (e.g. a lower-layer header), into the ring
+    //! \returns `false` (and counts a drop) if the ring has no room for it
+    bool capture(std::string_view prefix, const BufferViewList &packet);
+
+    //! \brief Copy a packet (its headers, then its payload) into the ring
+    //! \returns `false` (and counts a drop) if the ring has no room for it
+    bool capture(const PacketBuffer &packet) { return capture(packet.headers(), packet.payload().str()); }
+
+    //! Number of packets copied into the ring
+    uint64_t captured() const { return _captured.load(std::memory_order_relaxed); }
+
+    //! Number of packets dropped because the flusher had fallen behind
+    uint64_t dropped() const { return _dropped.load(std::memory_order_relaxed); }
+
+    //! \name
+    //! A PcapWriter cannot be copied or moved (its flusher thread refers to it)
+    //!@{
+    PcapWriter(const PcapWriter &other) = delete;
+    PcapWriter &operator=(const PcapWriter &other) = delete;
+    PcapWriter(PcapWriter &&other) = delete;
+    PcapWriter &operator=(PcapWriter &&other) = delete;
+    //!@}
+};
+
+//! \class PcapWriter
+//! capture() only copies the packet (plus a 16-byte record header) into a preallocated ring; a
+//! background thread writes the ring to the file every PcapWriter::FLUSH_INTERVAL_MS milliseconds.
+//! If the ring fills up before the flusher catches up, packets are dropped rather than waited for.
+//!
+//! capture() must not be called from more than one thread at a time. A NetworkInterface (capturing
+//! its frames) or a FileDescriptor such as a TunFD (capturing the datagrams written to and read from
+//! the device) uses a PcapWriter once it has been given one with `set_pcap_tap()`.
+
+#endif  // SPONGE_LIBSPONGE_PCAP_WRITER_HH
@@ -0,0 +1,106 @@
+#ifndef SPONGE_LIBSPONGE_SMALL_VECTOR_HH
+#define SPONGE_LIBSPONGE_SMALL_VECTOR_HH
+
+#include <array>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+//! \brief A sequence that holds up to `N` elements without allocating, and can discard from the front
+template <typename T, size_t N>
+class SmallVector {
+  private:
+    std::array<T, N> _inline{};  //!< The elements, until there are more than N
+    std::vector<T> _heap{};      //!< The elements, once there have been more than N
+    bool _spilled = false;       //!< Are the elements in `_heap`?
+    size_t _begin = 0;           //!< Index of the first element
+    size_t _end = 0;             //!< Index just past the last element
+
+    T *_storage() { return _spilled ? _heap.data() : _inline.data(); }
+    const T *_storage() const { return _spilled ? _heap.data() : _inline.data(); }
+
+  public:
+    SmallVector() = default;
+
+    //! \brief Construct holding one element
+    explicit SmallVector(T value) { push_back(std::move(value)); }
+
+    //! Append an element (moving everything to the heap the first time there are more than N)
+    void push_back(T value) {
+        if (not _spilled and _end == N and _begin > 0) {
+            // room was freed at the front: move down into it rather than spilling
+            for (size_t i = _begin; i < _end; i++) {
+                _inline[i - _begin] = std::move(_inline[i]);
+                _inline[i] = T{};
+            }
+            _end -= _begin;
+            _begin = 0;
+        }
+
+        if (not _spilled and _end == N) {
+            _heap.reserve(2 * N);
+            for (size_t i = _begin; i < _end; i++) {
+                _heap.push_back(std::move(_inline[i]));
+                _inline[i] = T{};
+            }
+            _spilled = true;
+            _end -= _begin;
+            _begin = 0;
+        }
+
+        if (_spilled) {
+            _heap.push_back(std::move(value));
+        } else {
+            _inline[_end] = std::move(value);
+        }
+        _end++;
+    }
+
+    //! Discard the first element
+    void pop_front() {
+        _storage()[_begin] = T{};  // release what it refers to now
+        _begin++;
+        if (_begin == _end) {
+            clear();
+        } else if (_spilled and _begin > _heap.size() / 2) {
+            // erase the discarded half, so a vector used as a queue doesn't grow without bound
+            _heap.erase(_heap.begin(), _heap.begin() + _begin);
+            _end -= _begin;
+            _begin = 0;
+        }
+    }
+
+    //! Discard every element (keeping any heap capacity for reuse)
+    void clear() {
+        if (_spilled) {
+            _heap.clear();
+        } else {
+            for (size_t i = _begin; i < _end; i++) {
+                _inline[i] = T{};
+            }
+        }
+        _begin = _end = 0;
+    }
+
+    //! \name Element access
+    //!@{
+    size_t size() const { return _end - _begin; }
+    bool empty() const { return _begin == _end; }
+
+    T *data() { return _storage() + _begin; }
+    const T *data() const { return _storage() + _begin; }
+
+    T &operator[](const size_t i) { return data()[i]; }
+    const T &operator[](const size_t i) const { return data()[i]; }
+
+    T &front() { return data()[0]; }
+    const T &front() const { return data()[0]; }
+
+    T *begin() { return data(); }
+    T *end() { return data() + size(); }
+    const T *begin() const { return data(); }
+    const T *end() const { return data() + size(); }
+    //!@}
+};
+
+#endif  // SPONGE_LIBSPONGE_SMALL_VECTOR_HH
@@ -2,7 +2,10 @@
 
 #include "util.hh"
 
+#include <algorithm>
 #include <cstddef>
+#include <cstring>
+#include <netinet/udp.h>
 #include <stdexcept>
 #include <unistd.h>
 
@@ -141,6 +144,115 @@ void UDPSocket::send(const BufferViewList &payload) {
     register_write();
 }
 
+//! \param[out] datagrams is cleared, and then filled with the datagrams received
+//! \param[in] max_datagrams is the most datagrams to receive
+//! \param[in] mtu is the size of the buffer for each datagram (with GRO, for each group of coalesced datagrams)
+//! \note If `mtu` is too small to hold a received datagram, this method throws a std::runtime_error
+size_t UDPSocket::recv_many(vector<received_packet> &datagrams, const size_t max_datagrams, const size_t mtu) {
+    datagrams.clear();
+    _messages.resize(max_datagrams);
+    _iovecs.resize(max_datagrams);
+    _addresses.resize(max_datagrams);
+    _controls.resize(max_datagrams);
+
+    // pooled buffers for every datagram that might arrive (those left unused go straight back to the pool)
+    _payloads.resize(max_datagrams);
+    for (size_t i = 0; i < max_datagrams; i++) {
+        _payloads[i] = Buffer::allocate(mtu);
+        _iovecs[i] = {_payloads[i].mutable_data(), mtu};
+
+        msghdr &header = _messages[i].msg_hdr;
+        header = {};
+        header.msg_name = static_cast<sockaddr *>(_addresses[i]);
+        header.msg_namelen = sizeof(sockaddr_storage);
+        header.msg_iov = &_iovecs[i];
+        header.msg_iovlen = 1;
+        header.msg_control = _controls[i].data();
+        header.msg_controllen = _controls[i].size();
+    }
+
+    const int received = SystemCall(
+        "recvmmsg", ::recvmmsg(fd_num(), _messages.data(), _messages.size(), MSG_WAITFORONE | MSG_TRUNC, nullptr));
+    register_read();
+
+    for (int i = 0; i < received; i++) {
+        // a datagram too long for its buffer is returned cut short, not thrown away with the rest of the batch
+        msghdr &header = _messages[i].msg_hdr;
+        const bool truncated = header.msg_flags & MSG_TRUNC;
+
+        Buffer &payload = _payloads[i];
+        payload.truncate(min<size_t>(_messages[i].msg_len, mtu));
+
+        size_t segment_size = 0;
+        for (cmsghdr *cmsg = CMSG_FIRSTHDR(&header); cmsg; cmsg = CMSG_NXTHDR(&header, cmsg)) {
+            if (cmsg->cmsg_level == SOL_UDP and cmsg->cmsg_type == UDP_GRO) {
+                int size;
+                memcpy(&size, CMSG_DATA(cmsg), sizeof(size));
+                segment_size = size;
+            }
+        }
+        if (segment_size >= payload.size()) {
+            segment_size = 0;  // not coalesced after all
+        }
+
+        datagrams.push_back({{static_cast<const sockaddr *>(_addresses[i]), header.msg_namelen},
+                             move(payload),
+                             static_cast<uint16_t>(segment_size),
+                             truncated});
+    }
+
+    _payloads.clear();
+    return received;
+}
+
+size_t UDPSocket::_send_many(const Address *destination, const vector<BufferViewList> &payloads) {
+    // gather every payload's iovecs into one array first, since it may be reallocated as it grows
+    _iovecs.clear();
+    for (const auto &payload : payloads) {
+        const auto &iovecs = payload.as_iovecs();
+        _iovecs.insert(_iovecs.end(), iovecs.begin(), iovecs.end());
+    }
+
+    _messages.resize(payloads.size());
+    for (size_t i = 0, first_iovec = 0; i < payloads.size(); i++) {
+        msghdr &header = _messages[i].msg_hdr;
+        header = {};
+        if (destination) {
+            header.msg_name = const_cast<sockaddr *>(static_cast<const sockaddr *>(*destination));
+            header.msg_namelen = destination->size();
+        }
+        header.msg_iov = &_iovecs[first_iovec];
+        header.msg_iovlen = payloads[i].as_iovecs().size();
+        first_iovec += header.msg_iovlen;
+    }
+
+    size_t sent = 0;
+    while (sent < payloads.size()) {
+        const int count = SystemCall(
+            "sendmmsg", ::sendmmsg(fd_num(), &_messages[sent], payloads.size() - sent, 0), EAGAIN);
+        register_write();
+        if (count < 0) {
+            break;  // a non-blocking socket's buffer is full
+        }
+
+        for (int i = 0; i < count; i++, sent++) {
+            if (_messages[sent].msg_len != payloads[sent].size()) {
+                throw runtime_error("datagram payload too big for sendmmsg()");
+            }
+        }
+    }
+
+    return sent;
+}
+
+//! \param[in] segment_size is the size of each datagram the kernel makes (0 turns segmentation off)
+void UDPSocket::set_gso_segment_size(const uint16_t segment_size) {
+    setsockopt(SOL_UDP, UDP_SEGMENT, int(segment_size));
+}
+
+//! \param[in] enabled is whether to accept coalesced datagrams
+void UDPSocket::set_gro(const bool enabled) { setsockopt(SOL_UDP, UDP_GRO, int(enabled)); }
+
 // mark the socket as listening for incoming connections
 //! \param[in] backlog is the number of waiting connections to queue (see [listen(2)](\ref man2::listen))
 void TCPSocket::listen(const int backlog) { SystemCall("listen", ::listen(fd_num(), backlog)); }
@@ -2,12 +2,15 @@
 #define SPONGE_LIBSPONGE_SOCKET_HH
 
 #include "address.hh"
+#include "buffer.hh"
 #include "file_descriptor.hh"
 
+#include <array>
 #include <cstdint>
 #include <functional>
 #include <string>
 #include <sys/socket.h>
+#include <vector>
 
 //! \brief Base class for network sockets (TCP, UDP, etc.)
 //! \details Socket is generally used via a subclass. See TCPSocket and UDPSocket for usage examples.
@@ -49,6 +52,22 @@ class Socket : public FileDescriptor {
 
 //! A wrapper around [UDP sockets](\ref man7::udp)
 class UDPSocket : public Socket {
+  private:
+    //! Room for the one control message recv_many() asks for (a UDP_GRO segment size)
+    using ControlBuffer = std::array<char, CMSG_SPACE(sizeof(int))>;
+
+    //! \name Arrays passed to recvmmsg and sendmmsg (reused between calls)
+    //!@{
+    std::vector<mmsghdr> _messages{};
+    std::vector<iovec> _iovecs{};
+    std::vector<Address::Raw> _addresses{};
+    std::vector<ControlBuffer> _controls{};
+    std::vector<Buffer> _payloads{};
+    //!@}
+
+    //! Send each payload as a datagram to `destination` (if not null), with as few system calls as possible
+    size_t _send_many(const Address *destination, const std::vector<BufferViewList> &payloads);
+
   protected:
     //! \brief Construct from FileDescriptor (used by TCPOverUDPSocketAdapter)
     //! \param[in] fd is the FileDescriptor from which to construct
@@ -75,6 +94,46 @@ class UDPSocket : public Socket {
 
     //! Send datagram to the socket's connected address (must call connect() first)
     void send(const BufferViewList &payload);
+
+    //! Returned by UDPSocket::recv_many; like received_datagram, but the payload is a pooled Buffer
+    struct received_packet {
+        Address source_address;   //!< Address from which this datagram was received
+        Buffer payload;           //!< UDP datagram payload (or, with GRO, several consecutive datagrams' payloads)
+        uint16_t segment_size{};  //!< If the kernel coalesced datagrams (see set_gro()), the size of each but the last
+        bool truncated{};         //!< The datagram was longer than `mtu`, and `payload` holds only its start
+    };
+
+    //! Room recv_many() makes for each datagram unless told otherwise (an Ethernet MTU, rounded up)
+    static constexpr size_t DEFAULT_BATCH_MTU = 2048;
+
+    //! \brief Receive up to `max_datagrams` datagrams with one system call
+    //! \details Blocks (if the socket is blocking) only until the first one arrives. A datagram longer
+    //! than `mtu` is still returned, cut short and marked received_packet::truncated. With GRO, pass an
+    //! `mtu` of 65536, as coalesced payloads can be that long.
+    //! \returns the number of datagrams received, which replace the contents of `datagrams`
+    size_t recv_many(std::vector<received_packet> &datagrams,
+                     const size_t max_datagrams = 32,
+                     const size_t mtu = DEFAULT_BATCH_MTU);
+
+    //! \brief Send several datagrams to the specified Address with as few system calls as possible
+    //! \returns the number sent, which is fewer than all only if the socket is non-blocking and its buffer fills
+    size_t sendto_many(const Address &destination, const std::vector<BufferViewList> &payloads) {
+        return _send_many(&destination, payloads);
+    }
+
+    //! \brief Send several datagrams to the socket's connected address with as few system calls as possible
+    //! \returns the number sent, which is fewer than all only if the socket is non-blocking and its buffer fills
+    size_t send_many(const std::vector<BufferViewList> &payloads) { return _send_many(nullptr, payloads); }
+
+    //! \brief Have the kernel split each payload sent into datagrams of `segment_size` bytes (0 to stop)
+    //! \details This is [UDP GSO](\ref man7::udp) (`UDP_SEGMENT`): one send of up to 64 KiB carries
+    //! tens of datagrams, and the last one may be shorter.
+    void set_gso_segment_size(const uint16_t segment_size);
+
+    //! \brief Let the kernel coalesce consecutive datagrams from one sender into one received payload
+    //! \details This is [UDP GRO](\ref man7::udp) (`UDP_GRO`); recv_many() reports the size of the
+    //! coalesced datagrams in received_packet::segment_size. (recv() can't, so don't use the two together.)
+    void set_gro(const bool enabled);
 };
 
 //! \class UDPSocket
@@ -0,0 +1,157 @@
+#include "tracepoint.hh"
+
+#include "address.hh"
+
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+
+//! \param[in] event is the TraceEvent to name
+//! \returns a string representation of the TraceEvent
+const char *as_string(const TraceEvent event) {
+    static constexpr const char *_names[] = {
+        "InterfaceUp",
+        "RouteAdd",
+        "RouteLookup",
+        "ArpMiss",
+        "ArpLearn",
+        "FrameTx",
+        "FrameRx",
+        "SegmentTx",
+        "SegmentRx",
+        "Retransmit",
+        "WindowUpdate",
+        "UncleanShutdown",
+    };
+    static_assert(sizeof(_names) / sizeof(_names[0]) == static_cast<size_t>(TraceEvent::NumEvents));
+
+    const auto idx = static_cast<size_t>(event);
+    return idx < static_cast<size_t>(TraceEvent::NumEvents) ? _names[idx] : "Unknown";
+}
+
+string TraceRecord::to_string() const {
+    const auto kind = static_cast<TraceEvent>(event);
+    stringstream ss{};
+    ss << setw(10) << timestamp_ns / 1000 << "." << setw(3) << setfill('0') << timestamp_ns % 1000 << setfill(' ')
+       << " us  [thread " << thread << "]  " << setw(16) << left << as_string(kind) << right;
+
+    switch (kind) {
+        case TraceEvent::InterfaceUp:
+        case TraceEvent::ArpLearn:
+            ss << " ip=" << Address::from_ipv4_numeric(arg0).ip() << " eth=" << hex << arg1 << dec;
+            break;
+        case TraceEvent::RouteAdd:
+            ss << " prefix=" << Address::from_ipv4_numeric(arg0).ip() << "/" << arg1 << " interface=" << arg2;
+            break;
+        case TraceEvent::RouteLookup:
+            ss << " dst=" << Address::from_ipv4_numeric(arg0).ip() << " matched_len=" << static_cast<int64_t>(arg1);
+            break;
+        case TraceEvent::ArpMiss:
+            ss << " next_hop=" << Address::from_ipv4_numeric(arg0).ip();
+            break;
+        case TraceEvent::FrameTx:
+        case TraceEvent::FrameRx:
+            ss << " type=0x" << hex << arg0 << dec << " len=" << arg1;
+            break;
+        case TraceEvent::SegmentTx:
+        case TraceEvent::SegmentRx:
+            ss << " seqno=" << arg0 << " len=" << arg1 << " flags=0x" << hex << arg2 << dec;
+            break;
+        case TraceEvent::Retransmit:
+            ss << " seqno=" << arg0 << " rto=" << arg1;
+            break;
+        case TraceEvent::WindowUpdate:
+            ss << " ackno=" << arg0 << " win=" << arg1;
+            break;
+        default:
+            ss << " " << arg0 << " " << arg1 << " " << arg2;
+            break;
+    }
+    return ss.str();
+}
+
+//! All rings ever created; rings outlive their threads so that their records can still be dumped
+static mutex registry_mutex{};
+static vector<shared_ptr<TraceRing>> registry{};
+
+//! \details The first call from each thread allocates the thread's ring and registers it; this is
+//! the only time the tracing code takes a lock.
+TraceRing &TraceRing::local() {
+    thread_local shared_ptr<TraceRing> ring = [] {
+        lock_guard<mutex> lock(registry_mutex);
+        registry.push_back(make_shared<TraceRing>(static_cast<uint16_t>(registry.size())));
+        return registry.back();
+    }();
+    return *ring;
+}
+
+//! \details May run concurrently with record() on the owning thread. Records that might have been
+//! overwritten while they were being copied are discarded, including the one sharing a slot with the
+//! record being written when the head was read again.
+vector<TraceRecord> TraceRing::snapshot() const {
+    const uint64_t head = _head.load(memory_order_acquire);
+    const uint64_t first = head > CAPACITY ? head - CAPACITY : 0;
+
+    vector<TraceRecord> ret;
+    ret.reserve(head - first);
+    for (uint64_t i = first; i < head; i++) {
+        ret.push_back(_records[i & (CAPACITY - 1)]);
+    }
+
+    atomic_thread_fence(memory_order_acquire);
+    const uint64_t head_after = _head.load(memory_order_relaxed);
+    const uint64_t valid_from = head_after >= CAPACITY ? head_after - CAPACITY + 1 : 0;
+    if (valid_from > first) {
+        ret.erase(ret.begin(), ret.begin() + min<uint64_t>(valid_from - first, ret.size()));
+    }
+
+    return ret;
+}
+
+vector<TraceRecord> trace_collect() {
+    vector<shared_ptr<TraceRing>> rings;
+    {
+        lock_guard<mutex> lock(registry_mutex);
+        rings = registry;
+    }
+
+    vector<TraceRecord> ret;
+    for (const auto &ring : rings) {
+        const auto records = ring->snapshot();
+        ret.insert(ret.end(), records.begin(), records.end());
+    }
+
+    stable_sort(ret.begin(), ret.end(), [](const TraceRecord &a, const TraceRecord &b) {
+        return a.timestamp_ns < b.timestamp_ns;
+    });
+    return ret;
+}
+
+//! \param[in] fd is where to write the trace (e.g. a file opened for writing)
+//! \details The file is TRACE_FILE_MAGIC followed by the raw TraceRecord structs in host byte order.
+void trace_dump(FileDescriptor &fd) {
+    const auto records = trace_collect();
+
+    string out(TRACE_FILE_MAGIC, sizeof(TRACE_FILE_MAGIC));
+    out.append(reinterpret_cast<const char *>(records.data()), records.size() * sizeof(TraceRecord));
+    fd.write(out);
+}
+
+//! \param[in] contents is the whole file
+//! \details A partial record at the end of the file (from a dump cut short) is ignored.
+vector<TraceRecord> trace_load(const string &contents) {
+    if (contents.size() < sizeof(TRACE_FILE_MAGIC) or
+        memcmp(contents.data(), TRACE_FILE_MAGIC, sizeof(TRACE_FILE_MAGIC)) != 0) {
+        throw runtime_error("not a trace file");
+    }
+
+    vector<TraceRecord> ret((contents.size() - sizeof(TRACE_FILE_MAGIC)) / sizeof(TraceRecord));
+    memcpy(ret.data(), contents.data() + sizeof(TRACE_FILE_MAGIC), ret.size() * sizeof(TraceRecord));
+    return ret;
+}
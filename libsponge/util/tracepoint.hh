@@ -0,0 +1,116 @@
+#ifndef SPONGE_LIBSPONGE_TRACEPOINT_HH
+#define SPONGE_LIBSPONGE_TRACEPOINT_HH
+
+#include "file_descriptor.hh"
+#include "util.hh"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//! Kinds of events recorded by the tracepoints in the TCP and IP paths
+enum class TraceEvent : uint16_t {
+    InterfaceUp = 0,  //!< A NetworkInterface was created (arg0 = IP address, arg1 = Ethernet address)
+    RouteAdd,         //!< A route was added (arg0 = prefix, arg1 = prefix length, arg2 = interface)
+    RouteLookup,      //!< A datagram's route was looked up (arg0 = dst, arg1 = prefix length matched or -1)
+    ArpMiss,          //!< A datagram had to wait for ARP (arg0 = next-hop IP address)
+    ArpLearn,         //!< An ARP mapping was learned (arg0 = IP address, arg1 = Ethernet address)
+    FrameTx,          //!< An Ethernet frame was queued for sending (arg0 = EtherType, arg1 = payload size)
+    FrameRx,          //!< An Ethernet frame was received (arg0 = EtherType, arg1 = payload size)
+    SegmentTx,        //!< A TCP segment was queued for sending (arg0 = seqno, arg1 = length, arg2 = flags)
+    SegmentRx,        //!< A TCP segment was received (arg0 = seqno, arg1 = length, arg2 = flags)
+    Retransmit,       //!< The oldest outstanding segment was retransmitted (arg0 = seqno, arg1 = RTO)
+    WindowUpdate,     //!< The peer advertised a window (arg0 = ackno, arg1 = window size)
+    UncleanShutdown,  //!< A TCPConnection was destroyed while still active
+    NumEvents         //!< Number of event kinds (not an event)
+};
+
+//! \returns a human-readable name for a TraceEvent
+const char *as_string(const TraceEvent event);
+
+//! One fixed-size binary trace record, as stored in a TraceRing and written by trace_dump()
+struct TraceRecord {
+    uint64_t timestamp_ns;  //!< Nanoseconds since the program started (see timestamp_ns())
+    uint16_t event;         //!< A TraceEvent
+    uint16_t thread;        //!< Small integer identifying the recording thread
+    uint32_t arg0;          //!< Event-specific argument
+    uint64_t arg1;          //!< Event-specific argument
+    uint64_t arg2;          //!< Event-specific argument
+
+    //! Return a string containing the record in human-readable format
+    std::string to_string() const;
+};
+
+static_assert(sizeof(TraceRecord) == 32, "TraceRecord must stay 32 bytes");
+
+//! \brief A per-thread, fixed-size, overwrite-oldest ring of TraceRecord
+//! \details Each thread writes only to its own ring, so recording is a plain store plus a
+//! release-store of the head index, with no locks or read-modify-write atomics.
+class TraceRing {
+  public:
+    static constexpr size_t CAPACITY = 4096;  //!< Number of records kept per thread (a power of two)
+
+  private:
+    std::array<TraceRecord, CAPACITY> _records{};
+    std::atomic<uint64_t> _head{0};  //!< Total number of records ever written
+    uint16_t _thread;
+
+  public:
+    //! Construct an empty ring for the thread numbered `thread`
+    explicit TraceRing(const uint16_t thread) : _thread(thread) {}
+
+    //! Append a record, overwriting the oldest one if the ring is full
+    void record(const TraceEvent event, const uint32_t arg0 = 0, const uint64_t arg1 = 0, const uint64_t arg2 = 0) {
+        const uint64_t head = _head.load(std::memory_order_relaxed);
+        _records[head & (CAPACITY - 1)] = {timestamp_ns(), static_cast<uint16_t>(event), _thread, arg0, arg1, arg2};
+        _head.store(head + 1, std::memory_order_release);
+    }
+
+    //! Copy out the records currently held, oldest first (once the ring has wrapped, the oldest
+    //! is left out, as its slot is the next to be written)
+    std::vector<TraceRecord> snapshot() const;
+
+    //! The calling thread's ring (created and registered on first use)
+    static TraceRing &local();
+};
+
+//! Collect the records of every thread's ring, sorted by timestamp
+std::vector<TraceRecord> trace_collect();
+
+//! Write a trace file (a header followed by the records from trace_collect()) to `fd`
+void trace_dump(FileDescriptor &fd);
+
+//! Magic bytes at the start of a file written by trace_dump()
+constexpr const char TRACE_FILE_MAGIC[8] = {'S', 'P', 'N', 'G', 'T', 'R', 'C', '1'};
+
+//! Parse the records out of the contents of a file written by trace_dump()
+std::vector<TraceRecord> trace_load(const std::string &contents);
+
+#ifdef SPONGE_TRACE
+constexpr bool TRACE_ENABLED = true;  //!< Tracepoints are compiled in (`cmake -DSPONGE_TRACE=ON`)
+#else
+constexpr bool TRACE_ENABLED = false;  //!< Tracepoints are compiled out
+#endif
+
+//! \brief Record an event in the calling thread's TraceRing
+//! \details Usage: `SPONGE_TRACEPOINT(TraceEvent::SegmentTx, seqno, length, flags)`. When tracing is
+//! disabled, the arguments are still type-checked but the statement compiles to nothing.
+#define SPONGE_TRACEPOINT(...)                      \
+    do {                                            \
+        if (TRACE_ENABLED) {                        \
+            TraceRing::local().record(__VA_ARGS__); \
+        }                                           \
+    } while (false)
+
+//! \class TraceRing
+//! Tracepoints are compiled in only when the build is configured with `-DSPONGE_TRACE=ON`.
+//! A program that wants to keep its trace calls trace_dump() (e.g. before exiting), and the
+//! `trace_decode` app turns the resulting binary file into one line of text per event (see trace_load()
+//! and TraceRecord::to_string()).
+//!
+//! Records that are overwritten while trace_dump() is copying a ring are dropped from the dump.
+
+#endif  // SPONGE_LIBSPONGE_TRACEPOINT_HH
@@ -1,21 +1,41 @@
 #include "util.hh"
 
+#include <algorithm>
 #include <array>
 #include <cctype>
 #include <chrono>
+#include <cstring>
 #include <iomanip>
 #include <iostream>
 #include <sstream>
 #include <sys/socket.h>
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
 using namespace std;
 
+using time_point = std::chrono::steady_clock::time_point;
+
+//! \returns the time of the first call (used as the program's start time)
+static time_point program_start() {
+    static const time_point start = std::chrono::steady_clock::now();
+    return start;
+}
+
 //! \returns the number of milliseconds since the program started
 uint64_t timestamp_ms() {
-    using time_point = std::chrono::steady_clock::time_point;
-    static const time_point program_start = std::chrono::steady_clock::now();
+    const time_point start = program_start();
+    const time_point now = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::milliseconds>(now - start).count();
+}
+
+//! \returns the number of nanoseconds since the program started
+uint64_t timestamp_ns() {
+    const time_point start = program_start();
     const time_point now = std::chrono::steady_clock::now();
-    return std::chrono::duration_cast<std::chrono::milliseconds>(now - program_start).count();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(now - start).count();
 }
 
 //! \param[in] attempt is the name of the syscall to try (for error reporting)
@@ -86,25 +106,229 @@ mt19937 get_random_generator() {
 //! on the Internet checksum, and consult the [IP](\ref rfc::rfc791) and [TCP](\ref rfc::rfc793) RFCs.
 InternetChecksum::InternetChecksum(const uint32_t initial_sum) : _sum(initial_sum) {}
 
-void InternetChecksum::add(std::string_view data) {
-    for (size_t i = 0; i < data.size(); i++) {
-        uint16_t val = uint8_t(data[i]);
-        if (not _parity) {
-            val <<= 8;
+//! The summing kernels each add up `len` bytes (`len` must be even) as 16-bit words in host byte order.
+//! Because the ones'-complement sum commutes with byte swapping, the folded result only needs to be
+//! swapped once to get the sum of the big-endian words (see [RFC 1071](\ref rfc::rfc1071)).
+//! The `COPY` instantiations also store every word they load to `dst`, so a copy costs no second pass.
+using ChecksumKernelFn = uint64_t (*)(uint8_t *dst, const uint8_t *data, const size_t len);
+
+template <bool COPY>
+static uint64_t sum_words_64(uint8_t *dst, const uint8_t *data, const size_t len) {
+    uint64_t sum_a = 0;
+    uint64_t sum_b = 0;
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        uint64_t a, b;
+        memcpy(&a, data + i, sizeof(a));
+        memcpy(&b, data + i + 8, sizeof(b));
+        if constexpr (COPY) {
+            memcpy(dst + i, &a, sizeof(a));
+            memcpy(dst + i + 8, &b, sizeof(b));
+        }
+        sum_a += (a & 0xffff'ffff) + (a >> 32);
+        sum_b += (b & 0xffff'ffff) + (b >> 32);
+    }
+    for (; i + 2 <= len; i += 2) {
+        uint16_t w;
+        memcpy(&w, data + i, sizeof(w));
+        if constexpr (COPY) {
+            memcpy(dst + i, &w, sizeof(w));
+        }
+        sum_a += w;
+    }
+    return sum_a + sum_b;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+//! Largest number of vector iterations before a 32-bit lane could overflow (each adds at most 2 * 0xffff)
+static constexpr size_t VECTOR_BLOCK_ITERATIONS = 16384;
+
+template <bool COPY>
+__attribute__((target("sse2"))) static uint64_t sum_words_sse2(uint8_t *dst, const uint8_t *data, const size_t len) {
+    const __m128i zero = _mm_setzero_si128();
+    uint64_t sum = 0;
+    size_t i = 0;
+    while (len - i >= 16) {
+        const size_t block_end = i + min((len - i) / 16, VECTOR_BLOCK_ITERATIONS) * 16;
+        __m128i acc = zero;
+        for (; i < block_end; i += 16) {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+            if constexpr (COPY) {
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), v);
+            }
+            acc = _mm_add_epi32(acc, _mm_unpacklo_epi16(v, zero));
+            acc = _mm_add_epi32(acc, _mm_unpackhi_epi16(v, zero));
+        }
+        array<uint32_t, 4> lanes{};
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes.data()), acc);
+        sum += uint64_t{lanes[0]} + lanes[1] + lanes[2] + lanes[3];
+    }
+    return sum + sum_words_64<COPY>(dst + i, data + i, len - i);
+}
+
+template <bool COPY>
+__attribute__((target("avx2"))) static uint64_t sum_words_avx2(uint8_t *dst, const uint8_t *data, const size_t len) {
+    const __m256i zero = _mm256_setzero_si256();
+    uint64_t sum = 0;
+    size_t i = 0;
+    while (len - i >= 32) {
+        const size_t block_end = i + min((len - i) / 32, VECTOR_BLOCK_ITERATIONS) * 32;
+        __m256i acc = zero;
+        for (; i < block_end; i += 32) {
+            const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+            if constexpr (COPY) {
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), v);
+            }
+            acc = _mm256_add_epi32(acc, _mm256_unpacklo_epi16(v, zero));
+            acc = _mm256_add_epi32(acc, _mm256_unpackhi_epi16(v, zero));
+        }
+        array<uint32_t, 8> lanes{};
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(lanes.data()), acc);
+        for (const auto lane : lanes) {
+            sum += lane;
         }
-        _sum += val;
-        _parity = !_parity;
     }
+    return sum + sum_words_64<COPY>(dst + i, data + i, len - i);
 }
+#endif
 
-uint16_t InternetChecksum::value() const {
-    uint32_t ret = _sum;
+bool InternetChecksum::supported(const Kernel kernel) {
+    switch (kernel) {
+        case Kernel::Bytewise:
+        case Kernel::Word64:
+            return true;
+#if defined(__x86_64__) || defined(__i386__)
+        case Kernel::SSE2:
+            return __builtin_cpu_supports("sse2");
+        case Kernel::AVX2:
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+    }
+}
 
-    while (ret > 0xffff) {
-        ret = (ret >> 16) + (ret & 0xffff);
+template <bool COPY>
+static ChecksumKernelFn kernel_function(const InternetChecksum::Kernel kernel) {
+    switch (kernel) {
+#if defined(__x86_64__) || defined(__i386__)
+        case InternetChecksum::Kernel::AVX2:
+            return sum_words_avx2<COPY>;
+        case InternetChecksum::Kernel::SSE2:
+            return sum_words_sse2<COPY>;
+#endif
+        default:
+            return sum_words_64<COPY>;
     }
+}
+
+//! \returns the fastest kernel supported by this CPU (chosen once, on first use)
+static InternetChecksum::Kernel best_kernel() {
+    static const InternetChecksum::Kernel best = [] {
+        for (const auto kernel : {InternetChecksum::Kernel::AVX2, InternetChecksum::Kernel::SSE2}) {
+            if (InternetChecksum::supported(kernel)) {
+                return kernel;
+            }
+        }
+        return InternetChecksum::Kernel::Word64;
+    }();
+    return best;
+}
+
+//! Fold a sum of 16-bit words to 16 bits with end-around carry
+static uint64_t fold(uint64_t sum) {
+    while (sum > 0xffff) {
+        sum = (sum >> 16) + (sum & 0xffff);
+    }
+    return sum;
+}
+
+void InternetChecksum::add(std::string_view data) { _add(data, nullptr, best_kernel()); }
+
+//! \details Data may be split across calls at any byte boundary, including odd ones.
+void InternetChecksum::add(std::string_view data, const Kernel kernel) { _add(data, nullptr, kernel); }
+
+//! \param[in] src is the data to copy and add
+//! \param[out] dst must have room for `src.size()` bytes, and must not overlap `src`
+void InternetChecksum::add_copy(std::string_view src, char *dst) { _add(src, dst, best_kernel()); }
+
+//! \param[in] src is the data to copy and add
+//! \param[out] dst must have room for `src.size()` bytes, and must not overlap `src`
+//! \param[in] kernel is the summing loop to use
+void InternetChecksum::add_copy(std::string_view src, char *dst, const Kernel kernel) { _add(src, dst, kernel); }
+
+void InternetChecksum::_add(std::string_view data, char *dst, const Kernel kernel) {
+    if (kernel == Kernel::Bytewise) {
+        if (dst) {
+            copy(data.begin(), data.end(), dst);
+        }
+        for (size_t i = 0; i < data.size(); i++) {
+            uint16_t val = uint8_t(data[i]);
+            if (not _parity) {
+                val <<= 8;
+            }
+            _sum += val;
+            _parity = !_parity;
+        }
+        return;
+    }
+
+    if (data.empty()) {
+        return;
+    }
+
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(data.data());
+    uint8_t *out = reinterpret_cast<uint8_t *>(dst);
+    size_t len = data.size();
+
+    // finish the 16-bit word left half-done by the previous call
+    if (_parity) {
+        _sum += bytes[0];
+        _parity = false;
+        if (out) {
+            *out++ = bytes[0];
+        }
+        bytes++;
+        len--;
+    }
+
+    const size_t even_len = len & ~size_t{1};
+    const ChecksumKernelFn sum_words = out ? kernel_function<true>(kernel) : kernel_function<false>(kernel);
+    uint64_t words = fold(sum_words(out, bytes, even_len));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    words = ((words & 0xff) << 8) | (words >> 8);
+#endif
+    _sum += words;
+
+    // start a word with the odd byte at the end
+    if (len & 1) {
+        _sum += uint16_t{bytes[even_len]} << 8;
+        _parity = true;
+        if (out) {
+            out[even_len] = bytes[even_len];
+        }
+    }
+}
+
+uint16_t InternetChecksum::value() const { return ~fold(_sum); }
+
+//! \param[in] cksum is the checksum stored in the packet
+//! \param[in] old_value is the 16-bit field (at an even offset) as it was when `cksum` was computed
+//! \param[in] new_value is the field's new value
+//! \returns the checksum of the packet with the field changed, computed without looking at the rest
+//! of the packet (HC' = ~(~HC + ~m + m'), equation 3 of RFC 1624)
+uint16_t InternetChecksum::update_u16(const uint16_t cksum, const uint16_t old_value, const uint16_t new_value) {
+    const uint64_t sum = uint16_t(~cksum) + uint64_t{uint16_t(~old_value)} + new_value;
+    return ~fold(sum);
+}
 
-    return ~ret;
+//! \param[in] cksum is the checksum stored in the packet
+//! \param[in] old_value is the 32-bit field (at an even offset) as it was when `cksum` was computed
+//! \param[in] new_value is the field's new value
+//! \returns the checksum of the packet with the field changed (see update_u16())
+uint16_t InternetChecksum::update_u32(const uint16_t cksum, const uint32_t old_value, const uint32_t new_value) {
+    const uint16_t partial = update_u16(cksum, old_value >> 16, new_value >> 16);
+    return update_u16(partial, old_value & 0xffff, new_value & 0xffff);
 }
 
 //! \param[in] data is a pointer to the bytes to show
@@ -51,16 +51,50 @@ std::mt19937 get_random_generator();
 //! Get the time in milliseconds since the program began.
 uint64_t timestamp_ms();
 
+//! Get the time in nanoseconds since the program began.
+uint64_t timestamp_ns();
+
 //! The internet checksum algorithm
 class InternetChecksum {
+  public:
+    //! Implementations of the summing loop (add() uses the fastest one the CPU supports)
+    enum class Kernel {
+        Bytewise,  //!< One byte per iteration (the reference implementation)
+        Word64,    //!< Eight bytes per iteration with 64-bit accumulation
+        SSE2,      //!< Sixteen bytes per iteration (x86 only)
+        AVX2       //!< Thirty-two bytes per iteration (x86 only)
+    };
+
   private:
-    uint32_t _sum;
+    uint64_t _sum;
     bool _parity{};
 
+    //! Add `data`, copying it to `dst` on the way if `dst` is not null
+    void _add(std::string_view data, char *dst, const Kernel kernel);
+
   public:
     InternetChecksum(const uint32_t initial_sum = 0);
     void add(std::string_view data);
     uint16_t value() const;
+
+    //! Add data using a specific kernel (used to test the kernels against each other)
+    void add(std::string_view data, const Kernel kernel);
+
+    //! \brief Copy `src` to `dst` and add it, reading each byte only once
+    //! \details Cheaper than a copy followed by add() because the data crosses the memory bus once.
+    void add_copy(std::string_view src, char *dst);
+
+    //! Copy and add data using a specific kernel (used to test the kernels against each other)
+    void add_copy(std::string_view src, char *dst, const Kernel kernel);
+
+    //! Is `kernel` usable on this CPU?
+    static bool supported(const Kernel kernel);
+
+    //! \name Incremental update of a stored checksum after one field changes ([RFC 1624](\ref rfc::rfc1624))
+    //!@{
+    static uint16_t update_u16(const uint16_t cksum, const uint16_t old_value, const uint16_t new_value);
+    static uint16_t update_u32(const uint16_t cksum, const uint32_t old_value, const uint32_t new_value);
+    //!@}
 };
 
 //! Hexdump the contents of a packet (or any other sequence of bytes)
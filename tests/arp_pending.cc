@@ -0,0 +1,125 @@
+#include "arp_test_harness.hh"
+#include "network_interface.hh"
+#include "test_err_if.hh"
+
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+InternetDatagram make_datagram(const unsigned n) {
+    InternetDatagram dgram;
+    dgram.header().src = 0x01020304;
+    dgram.header().dst = 0x05060708;
+    dgram.payload() = "datagram " + to_string(n);
+    dgram.header().len = dgram.header().hlen * 4 + dgram.payload().size();
+    return dgram;
+}
+
+//! Everything `interface` has sent: "ARP" for a request, or else the datagram's payload (and clear its queue)
+vector<string> take_frames(NetworkInterface &interface) {
+    vector<string> frames;
+    auto &queue = interface.frames_out();
+    while (not queue.empty()) {
+        if (queue.front().header().type == EthernetHeader::TYPE_ARP) {
+            frames.push_back("ARP");
+        } else {
+            InternetDatagram dgram;
+            test_err_if(dgram.parse(queue.front().payload().concatenate()) != ParseResult::NoError,
+                        "bad datagram sent");
+            frames.push_back(dgram.payload().concatenate());
+        }
+        queue.pop();
+    }
+    return frames;
+}
+
+//! Send datagrams `first` through `last` to neighbour `i`
+void send(NetworkInterface &interface, const unsigned i, const unsigned first, const unsigned last) {
+    for (unsigned n = first; n <= last; n++) {
+        interface.send_datagram(make_datagram(n), Address::from_ipv4_numeric(test_neighbor_ip(i)));
+    }
+}
+
+//! Every datagram sent while a request is under way waits for the reply (only one request is sent)
+void check_all_wait() {
+    NetworkInterface interface(TEST_LOCAL_ETHERNET, Address::from_ipv4_numeric(TEST_LOCAL_IP));
+    send(interface, 0, 1, 3);
+    test_err_if(take_frames(interface) != vector<string>{"ARP"}, "expected exactly one ARP request");
+    interface.tick(1000);
+    send(interface, 0, 4, 4);
+    test_err_if(not take_frames(interface).empty(), "unexpected frame while waiting");
+
+    interface.recv_frame(make_neighbor_reply(0));
+    const vector<string> waiting{"datagram 1", "datagram 2", "datagram 3", "datagram 4"};
+    test_err_if(take_frames(interface) != waiting, "waiting datagrams weren't all sent, in order");
+    const auto &counters = interface.pending_counters();
+    test_err_if(counters.queued != 4 or counters.sent != 4 or counters.dropped_full != 0, "wrong counters");
+}
+
+//! A full queue drops its oldest or the newest datagram, as configured, and counts it
+void check_limits() {
+    for (const auto policy : {NetworkInterface::PendingDropPolicy::DropOldest,
+                              NetworkInterface::PendingDropPolicy::DropNewest}) {
+        const bool oldest = policy == NetworkInterface::PendingDropPolicy::DropOldest;
+        NetworkInterface interface(TEST_LOCAL_ETHERNET, Address::from_ipv4_numeric(TEST_LOCAL_IP));
+        interface.set_pending_limits({3, 5, policy});
+
+        send(interface, 0, 1, 5);  // (two too many for one neighbour)
+        send(interface, 1, 6, 8);  // (one too many for all neighbours together)
+        const vector<string> requests{"ARP", "ARP"};
+        test_err_if(take_frames(interface) != requests, "expected one request per neighbour");
+
+        interface.recv_frame(make_neighbor_reply(0));
+        interface.recv_frame(make_neighbor_reply(1));
+        const vector<string> expected =
+            oldest ? vector<string>{"datagram 3", "datagram 4", "datagram 5", "datagram 7", "datagram 8"}
+                   : vector<string>{"datagram 1", "datagram 2", "datagram 3", "datagram 6", "datagram 7"};
+        test_err_if(take_frames(interface) != expected, "the wrong datagrams were dropped");
+
+        const auto &counters = interface.pending_counters();
+        test_err_if(counters.dropped_full != 3 or counters.sent != 5, "wrong counters");
+        test_err_if(counters.queued != (oldest ? 8 : 5), "wrong count of queued datagrams");
+    }
+}
+
+//! A neighbour that never answers is given up on, with what was waiting for it, which frees room for others
+void check_give_up() {
+    NetworkInterface interface(TEST_LOCAL_ETHERNET, Address::from_ipv4_numeric(TEST_LOCAL_IP));
+    interface.set_pending_limits({4, 4, NetworkInterface::PendingDropPolicy::DropNewest});
+    send(interface, 0, 1, 4);
+    test_err_if(take_frames(interface) != vector<string>{"ARP"}, "expected an ARP request");
+    for (unsigned i = 0; i < 2; i++) {
+        interface.tick(5000);
+        test_err_if(take_frames(interface) != vector<string>{"ARP"}, "request not repeated");
+    }
+    interface.tick(4999);
+    send(interface, 1, 5, 5);  // (no room: neighbour 0 still holds every place)
+    test_err_if(take_frames(interface) != vector<string>{"ARP"}, "expected a request for the second neighbour");
+    interface.tick(1);
+    test_err_if(not take_frames(interface).empty(), "asked again after giving up");
+    test_err_if(interface.pending_counters().dropped_unresolved != 4, "waiting datagrams weren't counted as dropped");
+
+    // the next datagram asks afresh, and there's room for it now
+    send(interface, 0, 6, 6);
+    test_err_if(take_frames(interface) != vector<string>{"ARP"}, "no new request after giving up");
+    interface.recv_frame(make_neighbor_reply(0));
+    test_err_if(take_frames(interface) != vector<string>{"datagram 6"}, "datagram after giving up wasn't sent");
+    test_err_if(interface.pending_counters().dropped_full != 1, "wrong count of full drops");
+}
+
+int main() {
+    try {
+        check_all_wait();
+        check_limits();
+        check_give_up();
+    } catch (const exception &e) {
+        cerr << "Exception: " << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
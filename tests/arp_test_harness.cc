@@ -0,0 +1,34 @@
+#include "arp_test_harness.hh"
+
+#include "arp_message.hh"
+
+using namespace std;
+
+EthernetAddress test_neighbor_ethernet_address(const size_t i) { return {0x02, 0, 0, 0, 1, static_cast<uint8_t>(i)}; }
+
+uint32_t test_neighbor_ip(const size_t i) { return 0x0a000010 + i; }
+
+EthernetFrame make_arp_reply(const EthernetAddress &sender_ethernet_address,
+                             const uint32_t sender_ip_address,
+                             const EthernetAddress &target_ethernet_address,
+                             const uint32_t target_ip_address) {
+    ARPMessage reply;
+    reply.opcode = ARPMessage::OPCODE_REPLY;
+    reply.sender_ethernet_address = sender_ethernet_address;
+    reply.sender_ip_address = sender_ip_address;
+    reply.target_ethernet_address = target_ethernet_address;
+    reply.target_ip_address = target_ip_address;
+
+    EthernetFrame frame;
+    frame.header().dst = target_ethernet_address;
+    frame.header().src = sender_ethernet_address;
+    frame.header().type = EthernetHeader::TYPE_ARP;
+    frame.payload() = reply.serialize();
+    return frame;
+}
+
+EthernetFrame make_neighbor_reply(const size_t i) { return make_neighbor_reply(i, test_neighbor_ethernet_address(i)); }
+
+EthernetFrame make_neighbor_reply(const size_t i, const EthernetAddress &ethernet_address) {
+    return make_arp_reply(ethernet_address, test_neighbor_ip(i), TEST_LOCAL_ETHERNET, TEST_LOCAL_IP);
+}
@@ -0,0 +1,33 @@
+#ifndef SPONGE_ARP_TEST_HARNESS_HH
+#define SPONGE_ARP_TEST_HARNESS_HH
+
+#include "ethernet_frame.hh"
+
+#include <cstddef>
+#include <cstdint>
+
+//! Ethernet address of the interface under test
+constexpr EthernetAddress TEST_LOCAL_ETHERNET{0x02, 0, 0, 0, 0, 1};
+
+//! IP address of the interface under test (10.0.0.1)
+constexpr uint32_t TEST_LOCAL_IP = 0x0a000001;
+
+//! Ethernet address of neighbour `i`
+EthernetAddress test_neighbor_ethernet_address(const size_t i);
+
+//! IP address of neighbour `i` (10.0.0.16 + i)
+uint32_t test_neighbor_ip(const size_t i);
+
+//! The frame carrying an ARP reply from the sender to the target
+EthernetFrame make_arp_reply(const EthernetAddress &sender_ethernet_address,
+                             const uint32_t sender_ip_address,
+                             const EthernetAddress &target_ethernet_address,
+                             const uint32_t target_ip_address);
+
+//! Neighbour `i` answering the interface under test
+EthernetFrame make_neighbor_reply(const size_t i);
+
+//! Neighbour `i` answering the interface under test, announcing `ethernet_address` instead of its own
+EthernetFrame make_neighbor_reply(const size_t i, const EthernetAddress &ethernet_address);
+
+#endif  // SPONGE_ARP_TEST_HARNESS_HH
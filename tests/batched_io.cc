@@ -0,0 +1,115 @@
+#include "batched_io.hh"
+#include "eventloop.hh"
+#include "test_err_if.hh"
+#include "util.hh"
+
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+using Backend = BatchedIO::Backend;
+
+string packet_contents(const unsigned i) { return "packet number " + to_string(i) + string(i % 100, 'x'); }
+
+//! Run `loop` until `done`, failing if that takes too long
+template <typename Done>
+void run_until(EventLoop &loop, Done &&done) {
+    const uint64_t start = timestamp_ms();
+    while (not done()) {
+        test_err_if(timestamp_ms() - start >= 5000, "timed out waiting for packets");
+        loop.wait_next_event(10);
+    }
+}
+
+//! Packets sent to a datagram socket are received in order, and packets written arrive whole
+void check_socket(const Backend backend, const uint16_t depth) {
+    int fds[2];
+    SystemCall("socketpair", ::socketpair(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK, 0, static_cast<int *>(fds)));
+    FileDescriptor peer{fds[1]};
+    BatchedIO io{FileDescriptor{fds[0]}, backend, 2048, depth};
+    test_err_if(io.backend() != backend, "BatchedIO used the wrong backend");
+
+    EventLoop loop;
+    vector<string> received;
+    io.install(loop, [&](Buffer &&packet) { received.emplace_back(packet.str()); });
+
+    // more packets than receive buffers, so the buffers are replenished (and the receive rearmed)
+    constexpr unsigned COUNT = 300;
+    unsigned sent = 0;
+    while (sent < COUNT) {
+        for (unsigned i = 0; i < 50 and sent < COUNT; i++, sent++) {
+            peer.write(packet_contents(sent));
+        }
+        run_until(loop, [&] { return received.size() == sent; });
+    }
+    for (unsigned i = 0; i < COUNT; i++) {
+        test_err_if(received[i] != packet_contents(i), "BatchedIO received the wrong bytes");
+    }
+
+    // more packets than write slots, so writing waits for completions
+    for (unsigned i = 0; i < 100; i++) {
+        PacketBuffer packet{Buffer{packet_contents(i)}};
+        memcpy(packet.prepend(4), "HDR:", 4);
+        io.write(move(packet));
+        if (i % 30 == 29) {
+            io.flush();
+            for (unsigned j = i - 29; j <= i; j++) {
+                string datagram = peer.read();
+                test_err_if(datagram != "HDR:" + packet_contents(j), "BatchedIO wrote the wrong bytes");
+            }
+        }
+    }
+    io.flush();
+}
+
+//! A non-socket fd (here, a pipe in packet mode, as a stand-in for a TUN device) works too
+void check_packet_pipe(const Backend backend) {
+    int fds[2];
+    SystemCall("pipe2", ::pipe2(static_cast<int *>(fds), O_DIRECT | O_NONBLOCK));
+    FileDescriptor write_end{fds[1]};
+    BatchedIO io{FileDescriptor{fds[0]}, backend, 2048, 16};
+
+    EventLoop loop;
+    vector<string> received;
+    io.install(loop, [&](Buffer &&packet) { received.emplace_back(packet.str()); });
+
+    for (unsigned i = 0; i < 10; i++) {
+        write_end.write(packet_contents(i));
+    }
+    run_until(loop, [&] { return received.size() == 10; });
+    for (unsigned i = 0; i < 10; i++) {
+        test_err_if(received[i] != packet_contents(i), "BatchedIO received the wrong bytes from a pipe");
+    }
+}
+
+int main() {
+    try {
+        vector<Backend> backends{Backend::Synchronous};
+        if (IoUring::available()) {
+            backends.push_back(Backend::IoUring);
+            if (not IoUring::multishot_recv_available()) {
+                cerr << "multishot receives are not available; testing one-shot receives on sockets\n";
+            }
+        } else {
+            cerr << "io_uring is not available; testing only the synchronous backend\n";
+        }
+
+        for (const auto backend : backends) {
+            check_socket(backend, 8);
+            check_socket(backend, 128);
+            check_packet_pipe(backend);
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
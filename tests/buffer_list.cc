@@ -0,0 +1,115 @@
+#include "buffer.hh"
+#include "small_vector.hh"
+#include "test_err_if.hh"
+#include "util.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+//! Build a BufferList of `pieces` random strings, and the string it should concatenate to
+pair<BufferList, string> random_list(mt19937 &rd, const size_t pieces) {
+    BufferList list;
+    string expected;
+    for (size_t i = 0; i < pieces; i++) {
+        string piece(rd() % 20, 0);
+        generate(piece.begin(), piece.end(), [&] { return 'a' + rd() % 26; });
+        expected += piece;
+        list.append(BufferList{move(piece)});
+    }
+    return {list, expected};
+}
+
+//! The bytes an iovec sequence refers to
+template <typename Iovecs>
+string gather(const Iovecs &iovecs) {
+    string ret;
+    for (size_t i = 0; i < iovecs.size(); i++) {
+        ret.append(static_cast<const char *>(iovecs.data()[i].iov_base), iovecs.data()[i].iov_len);
+    }
+    return ret;
+}
+
+void check_list(mt19937 &rd) {
+    // often more pieces than are held inline, to exercise spilling to the heap
+    auto [list, expected] = random_list(rd, rd() % (2 * BufferList::INLINE_PIECES + 2));
+    test_err_if(list.concatenate() != expected or list.size() != expected.size(),
+                "BufferList::append lost or reordered bytes");
+
+    BufferViewList views{list};
+    test_err_if(gather(views.as_iovecs()) != expected,
+                "BufferViewList::as_iovecs disagreed with BufferList::concatenate");
+
+    // remove bytes from the front a little at a time
+    while (not expected.empty()) {
+        const size_t n = rd() % (expected.size() + 1);
+        list.remove_prefix(n);
+        views.remove_prefix(n);
+        expected.erase(0, n);
+
+        test_err_if(list.concatenate() != expected or gather(views.as_iovecs()) != expected or
+                        views.size() != expected.size(),
+                    "remove_prefix left the wrong bytes");
+    }
+
+    // an emptied list can be reused
+    list.append(BufferList{string("again")});
+    test_err_if(list.concatenate() != "again", "BufferList was not reusable after being emptied");
+}
+
+//! Is `vec` holding its elements inline (in the object itself)?
+template <typename Vec>
+bool is_inline(const Vec &vec) {
+    const auto data = reinterpret_cast<uintptr_t>(vec.data());
+    return data >= reinterpret_cast<uintptr_t>(&vec) and data < reinterpret_cast<uintptr_t>(&vec + 1);
+}
+
+//! SmallVector used as a queue: stays inline while it can, and doesn't grow without bound once spilled
+void check_small_vector(mt19937 &rd) {
+    constexpr size_t N = 4;
+    SmallVector<uint64_t, N> vec;
+    deque<uint64_t> expected;
+    uint64_t next = 0;
+    uintptr_t lowest = UINTPTR_MAX, highest = 0;
+    for (unsigned i = 0; i < 100000; i++) {
+        // hold up to N elements for a while, then up to 3N (spilled)
+        const size_t most = i < 50000 ? N : 3 * N;
+        if (expected.empty() or (expected.size() < most and rd() % 3)) {
+            vec.push_back(next);
+            expected.push_back(next++);
+        } else {
+            vec.pop_front();
+            expected.pop_front();
+        }
+
+        test_err_if(vec.size() != expected.size() or not equal(vec.begin(), vec.end(), expected.begin()),
+                    "SmallVector lost or reordered elements");
+        test_err_if(i < 50000 and not is_inline(vec),
+                    "SmallVector spilled to the heap while holding at most N elements");
+        if (i >= 60000) {
+            lowest = min(lowest, reinterpret_cast<uintptr_t>(vec.data()));
+            highest = max(highest, reinterpret_cast<uintptr_t>(vec.data()));
+        }
+    }
+    test_err_if(highest - lowest > 8 * N * sizeof(uint64_t), "SmallVector kept growing while used as a queue");
+}
+
+int main() {
+    try {
+        auto rd = get_random_generator();
+        for (unsigned i = 0; i < 10000; i++) {
+            check_list(rd);
+        }
+        check_small_vector(rd);
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,143 @@
+#include "buffer.hh"
+#include "file_descriptor.hh"
+#include "test_err_if.hh"
+#include "util.hh"
+
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+//! Released storage is reused by the next allocation of the same size class
+void check_reuse() {
+    { Buffer warm = Buffer::allocate(1000); }
+
+    const auto before = BufferStorage::stats();
+    for (unsigned i = 0; i < 100; i++) {
+        Buffer buf = Buffer::allocate(900 + i);
+        memset(buf.mutable_data(), 'a', buf.size());
+        test_err_if(buf.size() != 900 + i, "Buffer::allocate made the wrong size");
+    }
+    const auto after = BufferStorage::stats();
+    test_err_if(after.heap_allocations != before.heap_allocations, "released storage was not reused");
+    test_err_if(after.reuses != before.reuses + 100, "BufferStorage::stats miscounted reuses");
+}
+
+//! Storage bigger than every size class is allocated for the purpose, never taken from a free list
+void check_oversized() {
+    { Buffer adopted{string(1000, 'a')}; }  // (leaves a block on the free list for adopted storage)
+
+    const auto before = BufferStorage::stats();
+    for (const size_t size : {BufferStorage::SIZE_CLASSES.back() + 1, size_t{100000}}) {
+        Buffer big = Buffer::allocate(size);
+        memset(big.mutable_data(), 'b', big.size());
+        test_err_if(big.size() != size or big.str().back() != 'b', "Buffer::allocate made the wrong size");
+    }
+    const auto after = BufferStorage::stats();
+    test_err_if(after.reuses != before.reuses, "oversized storage was taken from a free list");
+    test_err_if(after.heap_allocations != before.heap_allocations + 2, "oversized storage wasn't allocated");
+}
+
+//! Copies share storage; the bytes stay alive until the last copy goes away
+void check_sharing() {
+    Buffer original{string("hello, world")};
+    Buffer copy = original;
+    test_err_if(copy.str().data() != original.str().data(), "copying a Buffer copied its bytes");
+
+    copy.remove_prefix(7);
+    test_err_if(copy.str() != "world" or original.str() != "hello, world", "remove_prefix affected the wrong copy");
+
+    bool threw = false;
+    try {
+        original.mutable_data();
+    } catch (const runtime_error &) {
+        threw = true;
+    }
+    test_err_if(not threw, "Buffer::mutable_data allowed writing shared storage");
+
+    original = Buffer{};
+    test_err_if(copy.str() != "world", "storage was freed while still referenced");
+
+    copy.remove_prefix(5);
+    test_err_if(copy.size() != 0 or not copy.str().empty(), "Buffer was not empty after removing every byte");
+
+    Buffer moved_from{string("abc")};
+    Buffer moved_to{move(moved_from)};
+    test_err_if(moved_to.str() != "abc", "moving a Buffer lost its bytes");
+}
+
+//! A Buffer may be released on a different thread than the one that allocated it
+void check_threads() {
+    vector<Buffer> buffers;
+    for (unsigned i = 0; i < 1000; i++) {
+        buffers.push_back(Buffer::allocate(i * 70));
+        buffers.back().mutable_data();
+    }
+
+    thread releaser([&] {
+        vector<Buffer> copies = buffers;
+        copies.clear();
+    });
+    releaser.join();
+
+    buffers.clear();
+}
+
+//! Reads fill pooled storage sized by the caller, and return only what was read
+void check_fd_read() {
+    int fds[2];
+    SystemCall("pipe", ::pipe(static_cast<int *>(fds)));
+    FileDescriptor read_end{fds[0]}, write_end{fds[1]};
+
+    write_end.write("warm up");
+    { Buffer warm = read_end.read_buffer(1500); }
+
+    const auto before = BufferStorage::stats();
+    for (unsigned i = 0; i < 100; i++) {
+        const string message = "packet " + to_string(i);
+        write_end.write(message);
+        const Buffer received = read_end.read_buffer(1500);
+        test_err_if(received.str() != message, "FileDescriptor::read_buffer returned the wrong bytes");
+    }
+    test_err_if(BufferStorage::stats().heap_allocations != before.heap_allocations, "reads did not reuse storage");
+
+    // a caller-provided Buffer is truncated to what was read
+    Buffer provided = Buffer::allocate(100);
+    write_end.write("abc");
+    test_err_if(read_end.read(provided) != 3 or provided.str() != "abc", "FileDescriptor::read(Buffer &) misread");
+
+    // and a shared one can't be read into
+    Buffer shared = Buffer::allocate(100);
+    const Buffer other = shared;
+    bool threw = false;
+    try {
+        read_end.read(shared);
+    } catch (const runtime_error &) {
+        threw = true;
+    }
+    test_err_if(not threw, "FileDescriptor::read wrote into shared storage");
+
+    write_end.close();
+    test_err_if(read_end.read_buffer().size() != 0 or not read_end.eof(), "FileDescriptor::read_buffer missed EOF");
+}
+
+int main() {
+    try {
+        check_reuse();
+        check_oversized();
+        check_sharing();
+        check_threads();
+        check_fd_read();
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
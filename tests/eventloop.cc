@@ -0,0 +1,206 @@
+#include "eventloop.hh"
+#include "test_err_if.hh"
+#include "util.hh"
+
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+pair<FileDescriptor, FileDescriptor> make_pipe() {
+    int fds[2];
+    SystemCall("pipe", ::pipe(static_cast<int *>(fds)));
+    return {FileDescriptor{fds[0]}, FileDescriptor{fds[1]}};
+}
+
+//! Only ready rules run; uninterested rules don't; EOF cancels
+void check_pipe() {
+    auto [read_end, write_end] = make_pipe();
+    auto [idle_read, idle_write] = make_pipe();
+
+    EventLoop loop;
+    string received;
+    bool canceled = false, idle_ran = false, interested = true;
+    loop.add_rule(
+        read_end, Direction::In, [&] { received += read_end.read(); }, [&] { return interested; },
+        [&] { canceled = true; });
+    loop.add_rule(idle_read, Direction::In, [&] { idle_ran = true; });
+
+    test_err_if(loop.wait_next_event(0) != EventLoop::Result::Timeout, "EventLoop didn't time out with nothing ready");
+
+    write_end.write("hello");
+    test_err_if(loop.wait_next_event(-1) != EventLoop::Result::Success or received != "hello",
+                "EventLoop didn't run the ready rule");
+    test_err_if(idle_ran, "EventLoop ran a rule whose fd wasn't ready");
+
+    // while uninterested, the rule doesn't run even though its fd is ready
+    interested = false;
+    write_end.write("world");
+    test_err_if(loop.wait_next_event(0) != EventLoop::Result::Timeout or received != "hello",
+                "EventLoop ran an uninterested rule");
+    interested = true;
+    test_err_if(loop.wait_next_event(0) != EventLoop::Result::Success or received != "helloworld",
+                "EventLoop didn't resume watching a rule that became interested again");
+
+    write_end.close();
+    loop.wait_next_event(-1);  // reads EOF
+    idle_write.close();
+    loop.wait_next_event(-1);  // cancels the first rule, and the second sees EOF
+    test_err_if(not canceled, "EventLoop didn't cancel a rule at EOF");
+}
+
+//! A callback that neither reads nor loses interest is a busy loop
+void check_busy_wait() {
+    auto [read_end, write_end] = make_pipe();
+    EventLoop loop;
+    loop.add_rule(read_end, Direction::In, [] {});
+    write_end.write("x");
+
+    bool threw = false;
+    try {
+        loop.wait_next_event(-1);
+    } catch (const runtime_error &) {
+        threw = true;
+    }
+    test_err_if(not threw, "EventLoop didn't detect a busy wait");
+}
+
+//! Reading and writing rules can share an fd, and the loop exits once nothing is interested
+void check_shared_fd() {
+    int fds[2];
+    SystemCall("socketpair", ::socketpair(AF_UNIX, SOCK_STREAM, 0, static_cast<int *>(fds)));
+    FileDescriptor a{fds[0]}, b{fds[1]};
+
+    EventLoop loop;
+    string to_send = "ping", received;
+    bool ponged = false;
+    loop.add_rule(
+        a, Direction::Out, [&] { to_send.erase(0, a.write(to_send)); }, [&] { return not to_send.empty(); });
+    loop.add_rule(
+        b, Direction::In, [&] { received += b.read(); }, [&] { return received.size() < 4; });
+    loop.add_rule(
+        b, Direction::Out, [&] { ponged = b.write("pong") == 4; }, [&] { return received == "ping" and not ponged; });
+    loop.add_rule(a, Direction::In, [&] { received += a.read(); }, [&] { return received.size() < 8; });
+
+    for (unsigned i = 0; i < 10 and loop.wait_next_event(1000) != EventLoop::Result::Exit; i++) {
+    }
+    test_err_if(received != "pingpong", "EventLoop rules sharing an fd misbehaved: " + received);
+}
+
+//! A rule added for a new fd that reuses a closed fd's number is watched, whatever it waits for
+void check_reused_fd_number() {
+    for (const auto direction : {Direction::In, Direction::Out}) {
+        auto [old_read, old_write] = make_pipe();
+        EventLoop loop;
+        string received;
+        loop.add_rule(old_read, Direction::In, [&] { received += old_read.read(); });
+        old_write.write("a");
+        test_err_if(loop.wait_next_event(0) != EventLoop::Result::Success or received != "a", "first rule didn't run");
+
+        // between waits, the fd is closed and its number taken by one end of a new pipe
+        auto [new_read, new_write] = make_pipe();
+        const int number = old_read.fd_num();
+        old_read.close();
+        FileDescriptor &new_end = direction == Direction::In ? new_read : new_write;
+        SystemCall("dup2", ::dup2(new_end.fd_num(), number));
+        new_end = FileDescriptor{number};
+
+        bool ran = false;
+        loop.add_rule(new_end, direction, [&] {
+            if (direction == Direction::In) {
+                received += new_end.read();
+            } else {
+                new_end.write("b");
+            }
+            ran = true;
+        });
+        new_write.write(direction == Direction::In ? "b" : "");
+        test_err_if(loop.wait_next_event(0) != EventLoop::Result::Success or not ran, "new fd wasn't watched");
+    }
+}
+
+//! Regular files can't be watched by epoll, but are always ready
+void check_regular_file() {
+    FILE *tmp = tmpfile();
+    FileDescriptor file{SystemCall("dup", ::dup(fileno(tmp)))};
+    fclose(tmp);
+
+    EventLoop loop;
+    bool written = false;
+    loop.add_rule(
+        file, Direction::Out, [&] { written = file.write("data") == 4; }, [&] { return not written; });
+    test_err_if(loop.wait_next_event(-1) != EventLoop::Result::Success or not written,
+                "EventLoop didn't treat a regular file as ready");
+    test_err_if(loop.wait_next_event(-1) != EventLoop::Result::Exit, "EventLoop didn't exit with nothing to do");
+
+    // once the file is closed and its number reused by a pipe, the number is watched by epoll again
+    auto [read_end, write_end] = make_pipe();
+    const int number = file.fd_num();
+    file.close();
+    SystemCall("dup2", ::dup2(read_end.fd_num(), number));
+    read_end = FileDescriptor{number};
+    string received;
+    loop.add_rule(read_end, Direction::In, [&] { received += read_end.read(); });
+    test_err_if(loop.wait_next_event(0) != EventLoop::Result::Timeout, "a reused number was still always ready");
+    write_end.write("x");
+    test_err_if(loop.wait_next_event(0) != EventLoop::Result::Success or received != "x",
+                "a reused number wasn't watched");
+}
+
+//! Timers run at their deadlines, without the caller picking a timeout
+void check_timers() {
+    EventLoop loop;
+    vector<string> events;
+    const uint64_t start = timestamp_ms();
+
+    loop.add_timer(30, [&] { events.push_back("once"); });
+    const auto canceled = loop.add_timer(10, [&] { events.push_back("canceled"); });
+    uint64_t ticked_ms = 0;
+    unsigned ticks = 0;
+    EventLoop::TimerId periodic = 0;
+    periodic = loop.add_periodic(5, [&](const uint64_t ms_since_last_tick) {
+        ticked_ms += ms_since_last_tick;
+        if (++ticks == 10) {
+            loop.cancel_timer(periodic);
+        }
+    });
+    loop.cancel_timer(canceled);
+
+    // an fd rule too, to check that timers interrupt waiting for it
+    auto [read_end, write_end] = make_pipe();
+    loop.add_rule(read_end, Direction::In, [&] { read_end.read(); }, [&] { return ticks < 10 or events.empty(); });
+
+    while (loop.wait_next_event(-1) != EventLoop::Result::Exit) {
+    }
+    const uint64_t elapsed = timestamp_ms() - start;
+
+    test_err_if(events != vector<string>{"once"}, "EventLoop ran the wrong one-shot timers");
+    test_err_if(ticks != 10, "EventLoop ran a periodic timer the wrong number of times");
+    test_err_if(ticked_ms < 45 or ticked_ms > elapsed, "periodic timer was told the wrong elapsed time");
+    test_err_if(elapsed < 30 or elapsed >= 1000, "EventLoop didn't wait for the timers");
+
+    // with a shorter timeout than the next deadline, the wait times out
+    loop.add_timer(1000, [] {});
+    test_err_if(loop.wait_next_event(1) != EventLoop::Result::Timeout, "EventLoop ignored its timeout");
+}
+
+int main() {
+    try {
+        check_pipe();
+        check_busy_wait();
+        check_shared_fd();
+        check_reused_fd_number();
+        check_regular_file();
+        check_timers();
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,129 @@
+#include "test_err_if.hh"
+#include "util.hh"
+
+#include <cstdint>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+using Kernel = InternetChecksum::Kernel;
+
+static const vector<pair<Kernel, string>> kernels = {
+    {Kernel::Word64, "Word64"}, {Kernel::SSE2, "SSE2"}, {Kernel::AVX2, "AVX2"}};
+
+//! Checksum `data` in pieces of the given sizes, using `kernel` (and copying it, if `copy` is not null)
+uint16_t checksum_in_pieces(const string &data,
+                            const vector<size_t> &pieces,
+                            const uint32_t initial_sum,
+                            const Kernel kernel,
+                            string *copy = nullptr) {
+    InternetChecksum check{initial_sum};
+    const auto add_piece = [&](const size_t offset, const size_t len) {
+        const string_view piece = string_view(data).substr(offset, len);
+        if (copy) {
+            check.add_copy(piece, copy->data() + offset, kernel);
+        } else {
+            check.add(piece, kernel);
+        }
+    };
+
+    size_t offset = 0;
+    for (const auto piece : pieces) {
+        add_piece(offset, piece);
+        offset += piece;
+    }
+    add_piece(offset, data.size() - offset);
+    return check.value();
+}
+
+//! The test case, for failure messages
+string describe(const string &data, const vector<size_t> &pieces, const uint32_t initial_sum) {
+    ostringstream ss;
+    ss << "data length = " << data.size() << ", initial sum = " << initial_sum << ", pieces =";
+    for (const auto piece : pieces) {
+        ss << " " << piece;
+    }
+    return ss.str();
+}
+
+void check_equivalence(const string &data, const vector<size_t> &pieces, const uint32_t initial_sum) {
+    const uint16_t expected = checksum_in_pieces(data, pieces, initial_sum, Kernel::Bytewise);
+
+    for (const auto &[kernel, name] : kernels) {
+        if (not InternetChecksum::supported(kernel)) {
+            continue;
+        }
+
+        string copy(data.size(), 0);
+        const uint16_t actual = checksum_in_pieces(data, pieces, initial_sum, kernel);
+        const uint16_t actual_copying = checksum_in_pieces(data, pieces, initial_sum, kernel, &copy);
+        test_err_if(copy != data, "InternetChecksum::add_copy with the " + name + " kernel copied the data wrong");
+        test_err_if(actual != expected or actual_copying != expected,
+                    "The " + name + " checksum kernel disagreed with the bytewise version\n  " +
+                        describe(data, pieces, initial_sum) + "\n  expected " + to_string(expected) + " but got " +
+                        to_string(actual) + "\n");
+    }
+
+    // the default add() must agree too
+    InternetChecksum check{initial_sum};
+    check.add(data);
+    test_err_if(pieces.empty() and check.value() != expected,
+                "InternetChecksum::add disagreed with the bytewise version");
+
+    // and so must the default add_copy()
+    string copy(data.size(), 0);
+    InternetChecksum copy_check{initial_sum};
+    copy_check.add_copy(data, copy.data());
+    test_err_if(pieces.empty() and (copy_check.value() != expected or copy != data),
+                "InternetChecksum::add_copy disagreed with the bytewise version");
+}
+
+int main() {
+    try {
+        auto rd = get_random_generator();
+
+        // every length (and alignment) around the vector widths, in one piece
+        for (size_t len = 0; len < 200; len++) {
+            for (size_t align = 0; align < 4; align++) {
+                string data(len + align, 0);
+                generate(data.begin(), data.end(), [&] { return rd(); });
+                check_equivalence(data.substr(align), {}, 0);
+            }
+        }
+
+        // all-ones data, which exercises the end-around carry
+        check_equivalence(string(100000, '\xff'), {}, 0);
+        check_equivalence(string(100001, '\xff'), {1, 2, 3}, 0xffff);
+
+        // random data split across add() calls at random (often odd) boundaries
+        for (unsigned i = 0; i < 2000; i++) {
+            string data(rd() % 3000, 0);
+            generate(data.begin(), data.end(), [&] { return rd(); });
+
+            vector<size_t> pieces;
+            size_t remaining = data.size();
+            while (remaining > 0 and rd() % 4) {
+                const size_t piece = rd() % (remaining + 1);
+                pieces.push_back(piece);
+                remaining -= piece;
+            }
+
+            check_equivalence(data, pieces, rd() % 2 ? 0 : rd());
+        }
+
+        // long input, to cross the vector kernels' lane-overflow blocks
+        string big(1 << 20, 0);
+        generate(big.begin(), big.end(), [&] { return rd() | 0xc0; });
+        check_equivalence(big, {}, 0);
+        check_equivalence(big, {7, 65537}, 0);
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
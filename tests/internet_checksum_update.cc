@@ -0,0 +1,127 @@
+#include "tcp_segment.hh"
+#include "test_err_if.hh"
+#include "util.hh"
+
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+uint16_t checksum(const string &data) {
+    InternetChecksum check;
+    check.add(data);
+    return check.value();
+}
+
+//! Ones'-complement arithmetic has two zeros (0x0000 and 0xffff); treat them as equal
+bool same_checksum(const uint16_t a, const uint16_t b) { return a % 0xffff == b % 0xffff; }
+
+uint32_t get_u32(const string &data, const size_t offset) {
+    uint32_t ret = 0;
+    for (size_t i = 0; i < 4; i++) {
+        ret = (ret << 8) | uint8_t(data[offset + i]);
+    }
+    return ret;
+}
+
+void set_u32(string &data, const size_t offset, const uint32_t val) {
+    for (size_t i = 0; i < 4; i++) {
+        data[offset + i] = static_cast<char>(val >> (8 * (3 - i)));
+    }
+}
+
+//! Change one field of a checksummed packet and check that the incremental update matches a full recompute
+void check_field_update(mt19937 &rd) {
+    string packet(20 + rd() % 64, 0);
+    generate(packet.begin(), packet.end(), [&] { return rd(); });
+    if (rd() % 8 == 0) {
+        fill(packet.begin(), packet.end(), 0);  // exercise the zero-sum corner cases
+    }
+
+    const uint16_t cksum = checksum(packet);
+    const size_t offset = 2 * (rd() % (packet.size() / 2 - 1));
+
+    if (rd() % 2) {
+        const uint16_t old_value = (uint8_t(packet[offset]) << 8) | uint8_t(packet[offset + 1]);
+        const uint16_t new_value = rd() % 4 ? rd() : old_value;
+        packet[offset] = static_cast<char>(new_value >> 8);
+        packet[offset + 1] = static_cast<char>(new_value & 0xff);
+
+        test_err_if(not same_checksum(InternetChecksum::update_u16(cksum, old_value, new_value), checksum(packet)),
+                    "InternetChecksum::update_u16 disagreed with a full recompute");
+    } else {
+        const size_t offset32 = min(offset, packet.size() - 4);
+        const size_t even_offset32 = offset32 & ~size_t{1};
+        const uint32_t old_value = get_u32(packet, even_offset32);
+        const uint32_t new_value = rd();
+        set_u32(packet, even_offset32, new_value);
+
+        test_err_if(not same_checksum(InternetChecksum::update_u32(cksum, old_value, new_value), checksum(packet)),
+                    "InternetChecksum::update_u32 disagreed with a full recompute");
+    }
+}
+
+//! Patch the header of an already-serialized segment and check that it serializes like a fresh one
+void check_segment_patch(mt19937 &rd) {
+    TCPSegment seg;
+    seg.header().sport = rd();
+    seg.header().dport = rd();
+    seg.header().seqno = WrappingInt32{static_cast<uint32_t>(rd())};
+    seg.header().syn = rd() % 2;
+    string payload(rd() % 1500, 0);
+    generate(payload.begin(), payload.end(), [&] { return rd(); });
+
+    // half the time, prime the cache the way TCPSender does: from a checksum taken while copying the payload
+    const uint32_t pseudo_cksum = rd() % 0x40000;
+    if (rd() % 2) {
+        string copied(payload.size(), 0);
+        InternetChecksum payload_check;
+        payload_check.add_copy(payload, copied.data());
+        seg.payload() = Buffer(move(copied));
+        seg.cache_checksum(payload_check.value());
+    } else {
+        seg.payload() = Buffer(move(payload));
+        seg.cache_checksum();
+    }
+    seg.serialize(pseudo_cksum);
+
+    // what TCPConnection does to segments built by TCPSender, and what the adapters do afterwards
+    TCPSegment patched = seg;
+    patched.header().ack = true;
+    patched.header().ackno = WrappingInt32{static_cast<uint32_t>(rd())};
+    patched.header().win = rd();
+    patched.header().sport = rd();
+    patched.header().fin = rd() % 2;
+
+    TCPSegment fresh;
+    fresh.header() = patched.header();
+    fresh.payload() = Buffer(patched.payload().copy());
+
+    test_err_if(patched.serialize(pseudo_cksum).concatenate() != fresh.serialize(pseudo_cksum).concatenate(),
+                "patched TCPSegment serialized with the wrong checksum");
+
+    TCPSegment reparsed;
+    test_err_if(reparsed.parse(patched.serialize(pseudo_cksum).concatenate(), pseudo_cksum) != ParseResult::NoError,
+                "patched TCPSegment failed to parse");
+}
+
+int main() {
+    try {
+        auto rd = get_random_generator();
+
+        for (unsigned i = 0; i < 100000; i++) {
+            check_field_update(rd);
+        }
+
+        for (unsigned i = 0; i < 1000; i++) {
+            check_segment_patch(rd);
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,149 @@
+#include "lpm_table.hh"
+#include "test_err_if.hh"
+#include "util.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+
+using namespace std;
+
+//! The reference: a linear scan of every route (as Router used to do), keeping the first of equal lengths
+class LinearScan {
+    struct Route {
+        uint32_t prefix;
+        uint8_t length;
+        uint32_t value;
+    };
+    vector<Route> _routes{};
+
+  public:
+    void insert(const uint32_t prefix, const uint8_t length, const uint32_t value) {
+        _routes.push_back({prefix, length, value});
+    }
+
+    void erase(const uint32_t prefix, const uint8_t length) {
+        _routes.erase(remove_if(_routes.begin(),
+                                _routes.end(),
+                                [&](const Route &route) { return route.prefix == prefix and route.length == length; }),
+                      _routes.end());
+    }
+
+    optional<uint32_t> lookup(const uint32_t address) const {
+        optional<uint32_t> best;
+        int best_length = -1;
+        for (const auto &route : _routes) {
+            const uint32_t mask = route.length == 0 ? 0 : ~uint32_t{0} << (32 - route.length);
+            if ((address & mask) == route.prefix and best_length < route.length) {
+                best = route.value;
+                best_length = route.length;
+            }
+        }
+        return best;
+    }
+};
+
+//! A random prefix, with lengths spread like a real routing table's (mostly /16 to /24, a few longer)
+pair<uint32_t, uint8_t> random_prefix(mt19937 &rd) {
+    static const vector<uint8_t> lengths{0, 8, 12, 15, 16, 16, 17, 19, 20, 22, 23, 24, 24, 24, 25, 28, 30, 32};
+    const uint8_t length = lengths[rd() % lengths.size()];
+    const uint32_t mask = length == 0 ? 0 : ~uint32_t{0} << (32 - length);
+    // crowd the prefixes into a few /8s, so they nest
+    const uint32_t address = ((rd() % 4 + 10) << 24) | (rd() & 0xffffff);
+    return {address & mask, length};
+}
+
+//! The table agrees with a linear scan, whatever order the prefixes are inserted (and erased) in
+void check_against_linear_scan(mt19937 &rd, const size_t route_count) {
+    LpmTable table;
+    LinearScan oracle;
+    vector<pair<uint32_t, uint8_t>> prefixes;
+
+    for (uint32_t value = 0; value < route_count; value++) {
+        // sometimes repeat a prefix (with a different value)
+        const auto [prefix, length] =
+            (not prefixes.empty() and rd() % 10 == 0) ? prefixes[rd() % prefixes.size()] : random_prefix(rd);
+        prefixes.emplace_back(prefix, length);
+        table.insert(prefix, length, value);
+        oracle.insert(prefix, length, value);
+
+        // sometimes erase one
+        if (rd() % 8 == 0) {
+            const auto [old_prefix, old_length] = prefixes[rd() % prefixes.size()];
+            table.erase(old_prefix, old_length);
+            oracle.erase(old_prefix, old_length);
+        }
+    }
+
+    // random addresses, and addresses at and just past each prefix's edges
+    vector<uint32_t> addresses;
+    for (unsigned i = 0; i < 20000; i++) {
+        addresses.push_back(((rd() % 5 + 9) << 24) | (rd() & 0xffffff));
+    }
+    for (const auto &[prefix, length] : prefixes) {
+        const uint32_t last = prefix | (length == 0 ? ~uint32_t{0} : ~(~uint32_t{0} << (32 - length)));
+        addresses.insert(addresses.end(), {prefix, prefix - 1, last, last + 1});
+    }
+
+    for (const uint32_t address : addresses) {
+        const auto expected = oracle.lookup(address);
+        const auto actual = table.lookup(address);
+        test_err_if(actual != expected,
+                    "lookup of " + to_string(address) + " returned " + (actual ? to_string(*actual) : "nothing") +
+                        " instead of " + (expected ? to_string(*expected) : "nothing"));
+    }
+}
+
+//! Edge cases: the default route, host routes, repeated prefixes, and invalid prefixes
+void check_edges() {
+    LpmTable table;
+    test_err_if(table.lookup(0) or table.lookup(0xffffffff), "empty table matched");
+
+    test_err_if(not table.insert(0x0a000000, 8, 1), "insert failed");
+    test_err_if(not table.insert(0x0a010203, 32, 2), "insert failed");
+    test_err_if(table.insert(0x0a000000, 8, 3), "repeated insert succeeded");
+    test_err_if(table.size() != 2, "wrong size");
+    test_err_if(table.lookup(0x0a010203) != 2u or table.lookup(0x0a010202) != 1u, "host route lookup failed");
+    test_err_if(table.lookup(0x0b000000).has_value(), "lookup outside prefixes matched");
+
+    table.insert(0, 0, 0);
+    test_err_if(table.lookup(0x0b000000) != 0u or table.lookup(0x0a010204) != 1u, "default route lookup failed");
+
+    test_err_if(not table.erase(0x0a000000, 8) or table.erase(0x0a000000, 8), "erase failed");
+    test_err_if(table.lookup(0x0a010203) != 2u or table.lookup(0x0a010202) != 0u, "erase didn't fall back");
+    test_err_if(table.find(0x0a010203, 32) != 2u or table.find(0x0a000000, 8), "find failed");
+    test_err_if(not table.insert(0x0a000000, 8, 3) or table.lookup(0x0a010202) != 3u, "insert after erase failed");
+
+    table.insert(LpmTable::MAX_VALUE, 32, LpmTable::MAX_VALUE);
+    test_err_if(table.lookup(LpmTable::MAX_VALUE) != LpmTable::MAX_VALUE, "largest value lookup failed");
+
+    for (const auto &[prefix, length, value] : vector<tuple<uint32_t, uint8_t, uint32_t>>{
+             {0x0a000001, 8, 0}, {0, 33, 0}, {0, 8, LpmTable::MAX_VALUE + 1}}) {
+        try {
+            table.insert(prefix, length, value);
+            throw runtime_error("invalid insert succeeded");
+        } catch (const runtime_error &e) {
+            test_err_if(string(e.what()).find("LpmTable") != 0, "invalid insert failed the wrong way");
+        }
+    }
+}
+
+int main() {
+    try {
+        auto rd = get_random_generator();
+        check_edges();
+        for (const size_t route_count : {10, 100, 1000, 5000}) {
+            check_against_linear_scan(rd, route_count);
+        }
+    } catch (const exception &e) {
+        cerr << "Exception: " << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
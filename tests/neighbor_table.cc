@@ -0,0 +1,114 @@
+#include "neighbor_table.hh"
+#include "test_err_if.hh"
+#include "util.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+//! Inserts, finds and erases agree with a std::map, through growth and backward-shift deletion
+void check_against_map() {
+    auto rd = get_random_generator();
+    NeighborTable table;
+    map<uint32_t, uint8_t> oracle;
+
+    for (unsigned i = 0; i < 200000; i++) {
+        // (few distinct addresses, several sharing each home slot, so runs form and break up)
+        const uint32_t ip_address = rd() % 4 ? 0x0a000000 | (rd() % 3000) : rd() % 64 << 26;
+        switch (rd() % 3) {
+            case 0: {
+                NeighborTable::Entry &entry = table.insert(ip_address);
+                test_err_if(not entry.in_use or entry.ip_address != ip_address, "inserted entry has the wrong address");
+                if (oracle.count(ip_address)) {
+                    test_err_if(entry.ethernet_address[0] != oracle[ip_address],
+                                "insert didn't find the existing entry");
+                } else {
+                    test_err_if(entry.resolved or entry.deadline != NeighborTable::NO_DEADLINE, "new entry not empty");
+                    entry.ethernet_address[0] = oracle[ip_address] = rd();
+                }
+                break;
+            }
+            case 1: {
+                table.erase(ip_address);
+                oracle.erase(ip_address);
+                break;
+            }
+            default: {
+                const NeighborTable::Entry *entry = table.find(ip_address);
+                test_err_if(bool(entry) != bool(oracle.count(ip_address)), "find disagreed about presence");
+                test_err_if(entry and entry->ethernet_address[0] != oracle[ip_address],
+                            "find returned the wrong entry");
+            }
+        }
+        test_err_if(table.size() != oracle.size(), "wrong size");
+    }
+
+    for (const auto &[ip_address, tag] : oracle) {
+        const NeighborTable::Entry *entry = table.find(ip_address);
+        test_err_if(not entry or entry->ethernet_address[0] != tag, "entry lost");
+    }
+}
+
+//! Each deadline is reported once, at the first take_expired() at or after it, unless reset or erased first
+void check_deadlines() {
+    auto rd = get_random_generator();
+    NeighborTable table;
+    map<uint32_t, uint64_t> deadlines;  // (the oracle)
+    uint64_t now = 0;
+
+    for (unsigned i = 0; i < 50000; i++) {
+        const uint32_t ip_address = 0xc0a80000 | (rd() % 500);
+        switch (rd() % 4) {
+            case 0: {
+                // from just after now to past a whole turn of the wheel
+                const uint64_t deadline = now + 1 + (rd() % 2 ? rd() % 1000 : rd() % 60000);
+                table.set_deadline(table.insert(ip_address), deadline);
+                deadlines[ip_address] = deadline;
+                break;
+            }
+            case 1: {
+                table.erase(ip_address);
+                deadlines.erase(ip_address);
+                break;
+            }
+            default: {
+                now += rd() % 3 ? rd() % 100 : rd() % 100000;
+                vector<uint32_t> expired;
+                table.take_expired(now, expired);
+
+                vector<uint32_t> expected;
+                for (auto it = deadlines.begin(); it != deadlines.end();) {
+                    if (it->second <= now) {
+                        expected.push_back(it->first);
+                        it = deadlines.erase(it);
+                    } else {
+                        it++;
+                    }
+                }
+                test_err_if(expired != expected, "wrong entries expired at " + to_string(now));
+                for (const uint32_t expired_address : expired) {
+                    test_err_if(table.find(expired_address)->deadline != NeighborTable::NO_DEADLINE,
+                                "deadline not cleared");
+                }
+            }
+        }
+    }
+}
+
+int main() {
+    try {
+        check_against_map();
+        check_deadlines();
+    } catch (const exception &e) {
+        cerr << "Exception: " << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
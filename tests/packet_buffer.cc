@@ -0,0 +1,82 @@
+#include "file_descriptor.hh"
+#include "packet_buffer.hh"
+#include "tcp_segment.hh"
+#include "test_err_if.hh"
+#include "util.hh"
+
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+
+using namespace std;
+
+//! A serialized segment must be the same whether it goes through a PacketBuffer or a BufferList
+void check_segment(mt19937 &rd) {
+    TCPSegment seg;
+    seg.header().sport = rd();
+    seg.header().dport = rd();
+    seg.header().seqno = WrappingInt32{static_cast<uint32_t>(rd())};
+    seg.header().ack = rd() % 2;
+    seg.header().ackno = WrappingInt32{static_cast<uint32_t>(rd())};
+    seg.header().win = rd();
+    string payload(rd() % 2 ? 0 : rd() % 1500, 0);
+    generate(payload.begin(), payload.end(), [&] { return rd(); });
+    seg.payload() = Buffer(move(payload));
+
+    const uint32_t pseudo_cksum = rd() % 0x40000;
+    const PacketBuffer packet = seg.serialize_packet(pseudo_cksum);
+    test_err_if(packet.concatenate() != seg.serialize(pseudo_cksum).concatenate(),
+                "TCPSegment::serialize_packet disagreed with TCPSegment::serialize");
+    test_err_if(packet.payload().str().data() != seg.payload().str().data(),
+                "TCPSegment::serialize_packet copied the payload");
+    test_err_if(packet.headroom() != PacketBuffer::HEADROOM - TCPHeader::LENGTH,
+                "TCPSegment::serialize_packet left the wrong amount of headroom");
+}
+
+//! Headers are prepended outermost-last, and can be written and removed again
+void check_layers() {
+    PacketBuffer packet{Buffer{string("payload")}};
+    memcpy(packet.prepend(3), "TCP", 3);
+    memcpy(packet.prepend(2), "IP", 2);
+    memcpy(packet.prepend(3), "ETH", 3);
+    test_err_if(packet.concatenate() != "ETHIPTCPpayload" or packet.size() != 15,
+                "PacketBuffer::prepend put headers in the wrong place");
+
+    packet.remove_header(3);
+    test_err_if(packet.headers() != "IPTCP", "PacketBuffer::remove_header removed the wrong bytes");
+
+    // write it through a pipe with FileDescriptor::write(const PacketBuffer &)
+    int fds[2];
+    SystemCall("pipe", ::pipe(static_cast<int *>(fds)));
+    FileDescriptor read_end{fds[0]}, write_end{fds[1]};
+    test_err_if(write_end.write(packet) != packet.size() or read_end.read() != "IPTCPpayload",
+                "FileDescriptor::write(PacketBuffer) wrote the wrong bytes");
+
+    bool threw = false;
+    try {
+        packet.prepend(PacketBuffer::HEADROOM);
+    } catch (const runtime_error &) {
+        threw = true;
+    }
+    test_err_if(not threw, "PacketBuffer::prepend overran its headroom");
+}
+
+int main() {
+    try {
+        auto rd = get_random_generator();
+
+        for (unsigned i = 0; i < 1000; i++) {
+            check_segment(rd);
+        }
+
+        check_layers();
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,155 @@
+#include "arp_test_harness.hh"
+#include "network_interface.hh"
+#include "pcap_writer.hh"
+#include "tcp_segment.hh"
+#include "test_err_if.hh"
+#include "util.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <pcap/pcap.h>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+//! A pcap file in /tmp, removed when it goes out of scope
+class TempFile {
+    string _path{"/tmp/sponge_pcap_writer_XXXXXX"};
+    FileDescriptor _fd{SystemCall("mkstemp", ::mkstemp(_path.data()))};
+
+  public:
+    ~TempFile() { ::unlink(_path.c_str()); }
+    const string &path() const { return _path; }
+    FileDescriptor fd() const { return _fd.duplicate(); }
+
+    TempFile() = default;
+    TempFile(const TempFile &other) = delete;
+    TempFile &operator=(const TempFile &other) = delete;
+};
+
+//! The packets in the pcap file at `path`, which must have link type `link_type`
+vector<string> read_pcap(const string &path, const int link_type) {
+    char errbuf[PCAP_ERRBUF_SIZE];
+    pcap_t *pcap = pcap_open_offline(path.c_str(), static_cast<char *>(errbuf));
+    test_err_if(pcap == nullptr, "libpcap couldn't open the capture: " + string(static_cast<char *>(errbuf)));
+
+    const int file_link_type = pcap_datalink(pcap);
+    vector<string> packets;
+    const uint8_t *pkt;
+    struct pcap_pkthdr hdr;
+    while ((pkt = pcap_next(pcap, &hdr)) != nullptr) {
+        packets.emplace_back(reinterpret_cast<const char *>(pkt), hdr.caplen);
+        test_err_if(hdr.caplen != hdr.len, "packet truncated in the capture");
+    }
+    pcap_close(pcap);
+
+    test_err_if(file_link_type != link_type, "wrong link type in the capture");
+    return packets;
+}
+
+//! A NetworkInterface captures the frames it sends and receives, as they are on the wire
+void check_interface() {
+    const TempFile file;
+    vector<string> expected;
+    {
+        auto tap = make_shared<PcapWriter>(file.fd(), PcapWriter::LinkType::Ethernet);
+        NetworkInterface interface(TEST_LOCAL_ETHERNET, Address::from_ipv4_numeric(TEST_LOCAL_IP));
+        interface.set_pcap_tap(tap);
+
+        InternetDatagram dgram;
+        dgram.header().dst = test_neighbor_ip(1);
+        dgram.payload() = string("captured");
+        dgram.header().len = dgram.header().hlen * 4 + dgram.payload().size();
+        interface.send_datagram(dgram, Address::from_ipv4_numeric(test_neighbor_ip(1)));
+        expected.push_back(interface.frames_out().front().serialize().concatenate());  // the ARP request
+        interface.frames_out().pop();
+
+        const EthernetFrame reply = make_neighbor_reply(1);
+        interface.recv_frame(reply);
+        expected.push_back(reply.serialize().concatenate());
+        expected.push_back(interface.frames_out().front().serialize().concatenate());  // the waiting datagram
+
+        // a frame leaving a qdisc is captured when it goes out, not when it is queued
+        interface.set_qdisc(Qdisc::Config{});
+        interface.send_datagram(dgram, Address::from_ipv4_numeric(test_neighbor_ip(1)));
+        test_err_if(tap->captured() != 3, "a frame was captured while it waited in the qdisc");
+        interface.transmit();
+        expected.push_back(interface.frames_out().back().serialize().concatenate());
+
+        test_err_if(tap->captured() != 4 or tap->dropped() != 0, "wrong number of frames captured");
+    }
+
+    test_err_if(read_pcap(file.path(), 1) != expected, "captured frames differ from the frames on the wire");
+}
+
+//! A tapped FileDescriptor captures exactly the datagrams written to and read from it
+void check_file_descriptor() {
+    TCPSegment seg;
+    seg.header().sport = 1234;
+    seg.header().dport = 80;
+    seg.header().syn = true;
+    seg.payload() = string("hello");
+
+    InternetDatagram dgram;
+    dgram.header().src = 0x0a000001;
+    dgram.header().dst = 0x0a000002;
+    dgram.header().len = dgram.header().hlen * 4 + seg.header().doff * 4 + seg.payload().size();
+    dgram.payload() = seg.serialize(dgram.header().pseudo_cksum());
+    const string wire = dgram.serialize().concatenate();
+
+    // the same datagram again, as the TCP layer's PacketBuffer with the IPv4 header prepended
+    PacketBuffer packet = seg.serialize_packet(dgram.header().pseudo_cksum());
+    memcpy(packet.prepend(dgram.header().hlen * 4), wire.data(), dgram.header().hlen * 4);
+    test_err_if(packet.concatenate() != wire, "test built the datagram wrongly");
+
+    const TempFile file;
+    {
+        int fds[2];
+        SystemCall("socketpair", ::socketpair(AF_UNIX, SOCK_DGRAM, 0, static_cast<int *>(fds)));
+        FileDescriptor sender{fds[0]}, receiver{fds[1]};
+        auto tap = make_shared<PcapWriter>(file.fd(), PcapWriter::LinkType::IPv4);
+        sender.set_pcap_tap(tap);
+        receiver.set_pcap_tap(tap);
+
+        sender.write(wire);
+        sender.write(packet);
+        test_err_if(receiver.read_buffer().str() != wire or receiver.read_buffer().str() != wire,
+                    "wrong datagrams received");
+        sender.set_pcap_tap(nullptr);
+        sender.write(wire);
+        test_err_if(tap->captured() != 4, "wrong number of datagrams captured");
+    }
+
+    const auto packets = read_pcap(file.path(), 228);
+    test_err_if(packets.size() != 4, "wrong number of datagrams in the capture");
+    for (const auto &captured : packets) {
+        test_err_if(captured != wire, "captured datagram differs from the one written");
+
+        // the capture holds real addresses, so its checksums verify
+        InternetDatagram parsed_dgram;
+        test_err_if(parsed_dgram.parse(string(captured)) != ParseResult::NoError, "captured datagram didn't parse");
+        TCPSegment parsed_seg;
+        test_err_if(parsed_seg.parse(parsed_dgram.payload().concatenate(), parsed_dgram.header().pseudo_cksum()) !=
+                        ParseResult::NoError,
+                    "captured segment didn't parse");
+    }
+}
+
+int main() {
+    try {
+        check_interface();
+        check_file_descriptor();
+    } catch (const exception &e) {
+        cerr << "Exception: " << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
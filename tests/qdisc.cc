@@ -0,0 +1,153 @@
+#include "arp_test_harness.hh"
+#include "network_interface.hh"
+#include "qdisc.hh"
+#include "test_err_if.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+Qdisc::Config config(const Qdisc::Discipline discipline, const size_t limit = 10240) {
+    Qdisc::Config ret;
+    ret.discipline = discipline;
+    ret.limit = limit;
+    return ret;
+}
+
+//! A frame of `size` payload bytes, tagged (in its source address) with `tag`
+EthernetFrame make_frame(const uint8_t tag, const size_t size) {
+    EthernetFrame frame;
+    frame.header().src = {0x02, 0, 0, 0, 0, tag};
+    frame.header().type = EthernetHeader::TYPE_IPv4;
+    frame.payload() = string(size, 'x');
+    return frame;
+}
+
+//! The tags of every frame waiting in `qdisc` at time `now`, in the order they come out
+vector<uint8_t> drain(Qdisc &qdisc, const uint64_t now = 0) {
+    vector<uint8_t> tags;
+    while (auto frame = qdisc.dequeue(now)) {
+        tags.push_back(frame->header().src[5]);
+    }
+    return tags;
+}
+
+//! A FIFO sends in order, and drops arrivals beyond its limit
+void check_fifo() {
+    Qdisc fifo(config(Qdisc::Discipline::Fifo, 4));
+    for (uint8_t tag = 0; tag < 6; tag++) {
+        test_err_if(fifo.enqueue(make_frame(tag, 100), tag, 0) != (tag < 4), "FIFO limit not enforced");
+    }
+    test_err_if(fifo.size() != 4 or fifo.stats().backlog_bytes != 400, "wrong backlog");
+    const vector<uint8_t> in_order{0, 1, 2, 3};
+    test_err_if(drain(fifo, 7) != in_order, "FIFO out of order");
+
+    const auto &stats = fifo.stats();
+    test_err_if(stats.enqueued != 4 or stats.dequeued != 4 or stats.dropped_overlimit != 2, "wrong counts");
+    test_err_if(stats.backlog != 0 or stats.max_backlog != 4, "wrong backlog counts");
+    test_err_if(stats.total_sojourn_ms != 28 or stats.max_sojourn_ms != 7, "wrong sojourn times");
+}
+
+//! DRR serves flows in turn, a quantum at a time, and drops from the biggest flow when full
+void check_drr() {
+    Qdisc drr(config(Qdisc::Discipline::Drr, 64));
+    for (unsigned i = 0; i < 40; i++) {
+        drr.enqueue(make_frame(1, 1514), 1, 0);
+    }
+    for (unsigned i = 0; i < 4; i++) {
+        drr.enqueue(make_frame(2, 757), 2, 0);
+    }
+    // flow 2's frames are half the size, so it sends two for each of flow 1's
+    const vector<uint8_t> expected_start{1, 2, 2, 1, 2, 2, 1, 1, 1};
+    const auto tags = drain(drr);
+    test_err_if(tags.size() != 44 or vector<uint8_t>(tags.begin(), tags.begin() + 9) != expected_start, "not fair");
+
+    for (unsigned i = 0; i < 64; i++) {
+        drr.enqueue(make_frame(1, 1000), 1, 0);
+    }
+    drr.enqueue(make_frame(2, 1000), 2, 0);
+    test_err_if(drr.stats().dropped_overlimit != 1 or drr.size() != 64, "DRR limit not enforced");
+    const auto after = drain(drr);
+    test_err_if(count(after.begin(), after.end(), 2) != 1, "DRR dropped from the wrong flow");
+}
+
+//! FQ-CoDel sends a new flow's first frame ahead of backlogged flows (where DRR makes it wait its turn)
+void check_new_flows_first() {
+    for (const auto discipline : {Qdisc::Discipline::FqCoDel, Qdisc::Discipline::Drr}) {
+        Qdisc qdisc(config(discipline));
+        for (unsigned i = 0; i < 20; i++) {
+            qdisc.enqueue(make_frame(1, 1000), 1, 0);
+            qdisc.enqueue(make_frame(3, 1000), 3, 0);
+        }
+        for (unsigned i = 0; i < 4; i++) {
+            qdisc.dequeue(0);
+        }
+        qdisc.enqueue(make_frame(2, 100), 2, 0);
+        const bool first = qdisc.dequeue(0)->header().src[5] == 2;
+        test_err_if(first != (discipline == Qdisc::Discipline::FqCoDel), "new flow served in the wrong place");
+    }
+}
+
+//! A queue fed a little faster than it drains: CoDel keeps the sojourn time down, where a FIFO's keeps growing
+void check_codel() {
+    Qdisc fifo(config(Qdisc::Discipline::Fifo)), codel(config(Qdisc::Discipline::CoDel));
+    for (uint64_t now = 0; now < 10000; now++) {
+        for (auto qdisc : {&fifo, &codel}) {
+            qdisc->enqueue(make_frame(1, 1000), 1, now);
+            if (now % 10 == 0) {
+                qdisc->enqueue(make_frame(1, 1000), 1, now);
+            }
+            qdisc->dequeue(now);
+        }
+    }
+
+    test_err_if(fifo.stats().dropped_codel != 0 or fifo.stats().max_sojourn_ms < 900, "FIFO should have queued up");
+    test_err_if(codel.stats().dropped_codel == 0, "CoDel never dropped");
+    test_err_if(codel.stats().max_sojourn_ms >= fifo.stats().max_sojourn_ms / 2,
+                "CoDel didn't keep the sojourn time down");
+    test_err_if(codel.size() >= fifo.size() / 4, "CoDel didn't keep the queue short");
+}
+
+//! An interface's frames wait in its qdisc until transmitted
+void check_interface() {
+    NetworkInterface interface(TEST_LOCAL_ETHERNET, Address::from_ipv4_numeric(TEST_LOCAL_IP));
+    interface.recv_frame(make_neighbor_reply(1));
+
+    interface.set_qdisc(config(Qdisc::Discipline::FqCoDel));
+    InternetDatagram dgram;
+    dgram.payload() = string(100, 'x');
+    dgram.header().len = dgram.header().hlen * 4 + dgram.payload().size();
+    for (unsigned i = 0; i < 5; i++) {
+        dgram.header().dst = i;
+        interface.send_datagram(dgram, Address::from_ipv4_numeric(test_neighbor_ip(1)));
+    }
+    test_err_if(not interface.frames_out().empty() or interface.qdisc()->size() != 5,
+                "frames didn't wait in the qdisc");
+
+    interface.tick(3);
+    test_err_if(interface.transmit(2) != 2 or interface.frames_out().size() != 2, "transmit(2) didn't move two frames");
+    test_err_if(interface.qdisc()->stats().max_sojourn_ms != 3, "wrong sojourn time");
+    interface.set_qdisc(nullopt);
+    test_err_if(interface.qdisc() or interface.frames_out().size() != 5, "frames lost removing the qdisc");
+    test_err_if(interface.transmit() != 0, "transmit() without a qdisc moved frames");
+}
+
+int main() {
+    try {
+        check_fifo();
+        check_drr();
+        check_new_flows_first();
+        check_codel();
+        check_interface();
+    } catch (const exception &e) {
+        cerr << "Exception: " << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,153 @@
+#include "route_table.hh"
+#include "test_err_if.hh"
+#include "util.hh"
+
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+RouterEntry route(const uint32_t prefix, const uint8_t length, const size_t interface_num) {
+    return {prefix, length, LpmTable::mask(length), {}, interface_num};
+}
+
+//! Changes are invisible until published, and then visible all at once
+void check_publish() {
+    RouteTable table;
+    auto reader = table.reader();
+
+    table.add(route(0x0a000000, 8, 1));
+    table.add(route(0x0a010000, 16, 2));
+    {
+        const auto guard = reader.read();
+        test_err_if(guard.table().lookup(0x0a010101), "unpublished route was visible");
+    }
+
+    table.publish();
+    {
+        const auto guard = reader.read();
+        test_err_if(guard.table().lookup(0x0a010101)->interface_num != 2, "published route wasn't visible");
+        test_err_if(guard.table().lookup(0x0a020101)->interface_num != 1, "published route wasn't visible");
+        test_err_if(guard.table().size() != 2, "wrong size");
+
+        // a guard keeps its snapshot, even across a publish
+        table.remove(0x0a010000, 16);
+        table.add(route(0x0a000000, 8, 3));  // (ignored: the prefix is present already)
+        table.publish();
+        test_err_if(guard.table().lookup(0x0a010101)->interface_num != 2, "snapshot changed under a guard");
+    }
+
+    // both copies get every change, however the publishes fall
+    for (unsigned i = 0; i < 3; i++) {
+        const auto guard = reader.read();
+        test_err_if(guard.table().lookup(0x0a010101)->interface_num != 1, "removal didn't fall back");
+        test_err_if(guard.table().size() != 1, "wrong size after removal");
+        table.publish();  // (nothing to publish)
+    }
+
+    // a removal and an addition published together replace a route
+    table.remove(0x0a000000, 8);
+    table.add(route(0x0a000000, 8, 4));
+    table.publish();
+    table.add(route(0x0b000000, 8, 5));
+    table.publish();
+    for (unsigned i = 0; i < 2; i++) {
+        const auto guard = reader.read();
+        test_err_if(guard.table().lookup(0x0a010101)->interface_num != 4, "route wasn't replaced");
+        test_err_if(guard.table().lookup(0x0b010101)->interface_num != 5, "route wasn't added");
+        table.remove(0x0c000000, 8);  // (not present)
+        table.publish();
+    }
+}
+
+//! \name Version `v` of the churned table
+//! 10.0.0.0/8, plus each 10.i.0.0/16 and 10.i.1.0/24 on some versions, all with interface_num `v`
+//!@{
+constexpr unsigned CHURNED_PREFIXES = 64;
+bool has_16(const size_t v, const unsigned i) { return (i + v) % 3 != 0; }
+bool has_24(const size_t v, const unsigned i) { return (i + v) % 2 == 0; }
+//!@}
+
+//! Readers never see a version half-applied, and never go back to an older one
+void check_concurrent_churn() {
+    RouteTable table;
+    constexpr size_t VERSIONS = 300;
+    atomic<bool> done{false};
+    atomic<size_t> failures{0}, lookups{0};
+
+    const auto read_loop = [&](RouteTable::Reader reader) {
+        size_t last_version = 0;
+        while (not done.load()) {
+            const auto guard = reader.read();
+            const RouterEntry *whole = guard.table().lookup(0x0aff0000);
+            if (not whole) {
+                continue;  // nothing published yet
+            }
+            const size_t v = whole->interface_num;
+            if (v < last_version) {
+                failures++;
+            }
+            last_version = v;
+
+            for (unsigned i = 0; i < CHURNED_PREFIXES; i++) {
+                const RouterEntry *match = guard.table().lookup(0x0a000101 | (i << 16));
+                const uint8_t expected_length = has_24(v, i) ? 24 : has_16(v, i) ? 16 : 8;
+                if (not match or match->interface_num != v or match->prefix_length != expected_length) {
+                    failures++;
+                }
+            }
+            lookups++;
+        }
+    };
+
+    vector<thread> readers;
+    for (unsigned i = 0; i < 3; i++) {
+        readers.emplace_back(read_loop, table.reader());
+    }
+
+    for (size_t v = 1; v <= VERSIONS; v++) {
+        table.remove(0x0a000000, 8);
+        table.add(route(0x0a000000, 8, v));
+        for (unsigned i = 0; i < CHURNED_PREFIXES; i++) {
+            table.remove(0x0a000000 | (i << 16), 16);
+            table.remove(0x0a000100 | (i << 16), 24);
+            if (has_16(v, i)) {
+                table.add(route(0x0a000000 | (i << 16), 16, v));
+            }
+            if (has_24(v, i)) {
+                table.add(route(0x0a000100 | (i << 16), 24, v));
+            }
+        }
+        table.publish();
+    }
+
+    // let the readers see the last version
+    const size_t lookups_at_end = lookups.load();
+    while (lookups.load() < lookups_at_end + 100) {
+        this_thread::yield();
+    }
+    done.store(true);
+    for (auto &reader : readers) {
+        reader.join();
+    }
+
+    test_err_if(failures.load() != 0, to_string(failures.load()) + " lookups saw a half-updated or older table");
+    test_err_if(table.current().lookup(0x0a000101)->interface_num != VERSIONS, "last version wasn't current");
+}
+
+int main() {
+    try {
+        check_publish();
+        check_concurrent_churn();
+    } catch (const exception &e) {
+        cerr << "Exception: " << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,136 @@
+#include "router.hh"
+#include "router_test_harness.hh"
+#include "test_err_if.hh"
+#include "util.hh"
+
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+constexpr size_t INTERFACES = 4;
+
+//! A router with INTERFACES interfaces, which have learned the Ethernet addresses of next hops 0 through 7
+unique_ptr<Router> make_router(const size_t batch_size, const size_t cache_capacity = 0) {
+    auto router = make_test_router(INTERFACES);
+    router->set_batch_size(batch_size);
+    router->set_route_cache(cache_capacity);
+    return router;
+}
+
+InternetDatagram make_datagram(const uint32_t dst, const uint8_t ttl, const size_t n) {
+    InternetDatagram dgram;
+    dgram.header().src = 0x01020304;
+    dgram.header().dst = dst;
+    dgram.header().ttl = ttl;
+    dgram.payload() = "datagram " + to_string(n);
+    dgram.header().len = dgram.header().hlen * 4 + dgram.payload().size();
+    return dgram;
+}
+
+//! Everything each interface of `router` has sent (and clear its queue)
+vector<vector<string>> take_frames(Router &router) { return take_router_frames(router, INTERFACES); }
+
+//! Batched (and cached) routing sends exactly what routing one datagram at a time does
+void check_same_as_one_at_a_time() {
+    auto rd = get_random_generator();
+    auto one_at_a_time = make_router(1), batched = make_router(Router::DEFAULT_BATCH_SIZE);
+    auto odd_batches = make_router(7), cached = make_router(1, 16), cached_batches = make_router(32, 4096);
+    const vector<Router *> routers{
+        one_at_a_time.get(), batched.get(), odd_batches.get(), cached.get(), cached_batches.get()};
+
+    size_t frames_sent = 0;
+    for (unsigned round = 0; round < 20; round++) {
+        // change some routes
+        for (unsigned i = 0; i < 50; i++) {
+            const uint8_t length = vector<uint8_t>{0, 8, 12, 16, 20, 24, 28, 32}[rd() % 8];
+            const uint32_t prefix = ((rd() % 2 + 10) << 24 | (rd() & 0xffffff)) & LpmTable::mask(length);
+            const size_t hop = rd() % 12;
+            const auto hop_address =
+                rd() % 4 ? optional<Address>{Address::from_ipv4_numeric(router_next_hop_ip(hop))} : optional<Address>{};
+            const bool remove = rd() % 5 == 0;
+            for (auto router : routers) {
+                if (remove) {
+                    router->remove_route(prefix, length);
+                } else {
+                    router->add_route(prefix, length, hop_address, hop % INTERFACES);
+                }
+            }
+        }
+
+        // queue the same datagrams on every router's interfaces (some expired, some unroutable, many repeated)
+        for (unsigned i = 0; i < 200; i++) {
+            const uint32_t dst = ((rd() % 3 + 10) << 24) | (rd() % 2 ? rd() % 8 : rd() & 0xffffff);
+            const uint8_t ttl = rd() % 4;
+            const size_t in = rd() % INTERFACES;
+            for (auto router : routers) {
+                router->interface(in).datagrams_out().push(make_datagram(dst, ttl, i));
+            }
+        }
+
+        for (auto router : routers) {
+            router->route();
+        }
+
+        const auto expected = take_frames(*one_at_a_time);
+        test_err_if(take_frames(*batched) != expected, "batched routing sent different frames");
+        test_err_if(take_frames(*odd_batches) != expected, "routing in batches of 7 sent different frames");
+        test_err_if(take_frames(*cached) != expected, "cached routing sent different frames");
+        test_err_if(take_frames(*cached_batches) != expected, "cached batched routing sent different frames");
+        for (const auto &frames : expected) {
+            frames_sent += frames.size();
+        }
+    }
+    test_err_if(frames_sent < 500, "too few frames were sent for the comparison to mean anything");
+    test_err_if(cached_batches->route_cache()->hits() <= 100, "the route cache never hit");
+}
+
+//! The cache counts hits and misses, and a route change takes effect immediately
+void check_route_cache() {
+    auto router = make_router(1, 64);
+    test_err_if(router->route_cache()->capacity() != 64 or router->route_cache()->misses() != 0, "cache not enabled");
+
+    const auto route_to = [&](const uint32_t dst) {
+        router->interface(0).datagrams_out().push(make_datagram(dst, 64, 0));
+        router->route();
+        for (size_t i = 0; i < INTERFACES; i++) {
+            if (not router->interface(i).frames_out().empty()) {
+                take_frames(*router);
+                return int(i);
+            }
+        }
+        return -1;
+    };
+
+    router->add_route(0x0a000000, 8, Address::from_ipv4_numeric(router_next_hop_ip(1)), 1);
+    test_err_if(route_to(0x0a010101) != 1 or route_to(0x0a010101) != 1, "route not followed");
+    test_err_if(router->route_cache()->misses() != 1 or router->route_cache()->hits() != 1, "wrong hit/miss counts");
+
+    router->add_route(0x0a010100, 24, Address::from_ipv4_numeric(router_next_hop_ip(2)), 2);
+    test_err_if(route_to(0x0a010101) != 2, "cache wasn't invalidated by add_route");
+    router->remove_route(0x0a010100, 24);
+    test_err_if(route_to(0x0a010101) != 1, "cache wasn't invalidated by remove_route");
+    router->remove_route(0x0a000000, 8);
+    test_err_if(route_to(0x0a010101) != -1 or route_to(0x0a010101) != -1, "a removed route was followed");
+    test_err_if(router->route_cache()->misses() != 4 or router->route_cache()->hits() != 2, "wrong hit/miss counts");
+
+    router->set_route_cache(0);
+    test_err_if(router->route_cache(), "cache not disabled");
+}
+
+int main() {
+    try {
+        check_same_as_one_at_a_time();
+        check_route_cache();
+    } catch (const exception &e) {
+        cerr << "Exception: " << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
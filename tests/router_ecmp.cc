@@ -0,0 +1,198 @@
+#include "next_hop_group.hh"
+#include "router.hh"
+#include "router_test_harness.hh"
+#include "test_err_if.hh"
+#include "util.hh"
+
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+constexpr size_t INTERFACES = 4;
+constexpr size_t FLOWS = 2000;
+
+//! Next hop `i`, on interface i % INTERFACES
+NextHop next_hop(const size_t i) { return {Address::from_ipv4_numeric(router_next_hop_ip(i)), i % INTERFACES}; }
+
+//! How many buckets each member of `group` has
+vector<size_t> bucket_counts(const NextHopGroup &group) {
+    vector<size_t> counts(group.members().size(), 0);
+    for (const uint16_t member : group.buckets()) {
+        counts.at(member)++;
+    }
+    return counts;
+}
+
+//! The next hop each bucket of `group` sends to
+vector<uint32_t> bucket_next_hops(const NextHopGroup &group) {
+    vector<uint32_t> next_hops;
+    for (const uint16_t member : group.buckets()) {
+        next_hops.push_back(group.members()[member].next_hop->ipv4_numeric());
+    }
+    return next_hops;
+}
+
+//! Buckets are shared fairly, and membership changes move as few as possible
+void check_resilient_buckets() {
+    const RouterEntry route{0x0a000000, 8, LpmTable::mask(8), {}, 0};
+    const NextHopGroup three(route, {next_hop(0), next_hop(1), next_hop(2), next_hop(1)});
+    test_err_if(three.members().size() != 3 or three.buckets().size() != NextHopGroup::BUCKETS, "wrong group size");
+    for (const size_t count : bucket_counts(three)) {
+        test_err_if(count != 85 and count != 86, "buckets not spread evenly");
+    }
+    test_err_if(three.members()[1].route_prefix != 0x0a000000 or three.members()[1].interface_num != 1, "wrong member");
+
+    // a new member takes only its share, and nothing moves between the others
+    const NextHopGroup four = three.with(next_hop(3));
+    const auto before = bucket_next_hops(three), after = bucket_next_hops(four);
+    size_t moved = 0;
+    for (size_t b = 0; b < NextHopGroup::BUCKETS; b++) {
+        if (before[b] != after[b]) {
+            test_err_if(after[b] != next_hop(3).address->ipv4_numeric(), "a bucket moved to an old member");
+            moved++;
+        }
+    }
+    test_err_if(moved != 64 or bucket_counts(four) != vector<size_t>(4, 64), "wrong number of buckets moved");
+    test_err_if(bucket_next_hops(four.with(next_hop(3))) != after, "adding a member again changed the group");
+
+    // removing a member moves only its buckets
+    const NextHopGroup without_one = four.without(next_hop(1));
+    const auto remaining = bucket_next_hops(without_one);
+    for (size_t b = 0; b < NextHopGroup::BUCKETS; b++) {
+        const bool removed_members = after[b] == next_hop(1).address->ipv4_numeric();
+        test_err_if(not removed_members and remaining[b] != after[b], "a bucket moved needlessly");
+        test_err_if(remaining[b] == next_hop(1).address->ipv4_numeric(), "a removed member kept a bucket");
+    }
+    test_err_if(bucket_next_hops(without_one.without(next_hop(7))) != remaining,
+                "removing a non-member changed the group");
+
+    bool threw = false;
+    try {
+        NextHopGroup(route, {next_hop(5)}).without(next_hop(5));
+    } catch (const invalid_argument &) {
+        threw = true;
+    }
+    test_err_if(not threw, "removing the last member didn't throw");
+}
+
+//! A router whose interfaces have learned the Ethernet addresses of next hops 0 through 7
+unique_ptr<Router> make_router(const size_t batch_size, const size_t threads) {
+    auto router = make_test_router(INTERFACES);
+    router->set_batch_size(batch_size);
+    router->set_threads(threads);
+    return router;
+}
+
+//! Send one datagram of each flow (the flows differ in source port) through `router`, and
+//! return the next hop (the last byte of its Ethernet address) each was sent to (or -1)
+vector<int> route_flows(Router &router) {
+    for (size_t flow = 0; flow < FLOWS; flow++) {
+        InternetDatagram dgram;
+        dgram.header().src = 0x01020304;
+        dgram.header().dst = 0x0a010203;
+        dgram.header().ttl = 64;
+        dgram.payload() = string{char(flow >> 8), char(flow), 0, 80} + "flow " + to_string(flow) + ";";
+        dgram.header().len = dgram.header().hlen * 4 + dgram.payload().size();
+        router.interface(flow % INTERFACES).queue_datagram(move(dgram));
+    }
+    router.route();
+
+    vector<int> next_hops(FLOWS, -1);
+    const auto frames = take_router_frames(router, INTERFACES);
+    for (size_t i = 0; i < INTERFACES; i++) {
+        for (const auto &frame : frames[i]) {
+            const size_t flow = stoul(frame.substr(frame.find("flow ") + 5));
+            const uint8_t hop = static_cast<uint8_t>(frame[5]);  // the last byte of the destination address
+            test_err_if(next_hops.at(flow) != -1, "a flow was sent twice");
+            test_err_if(hop % INTERFACES != i, "a datagram was sent by the wrong interface");
+            next_hops[flow] = hop;
+        }
+    }
+    return next_hops;
+}
+
+//! Flows spread across a multipath route's next hops, stick to them, and move as little as possible
+void check_router_multipath() {
+    auto one_at_a_time = make_router(1, 1), batched = make_router(32, 1), parallel = make_router(32, 2);
+    for (auto router : {one_at_a_time.get(), batched.get(), parallel.get()}) {
+        router->add_route(0x0a000000, 8, vector<NextHop>{next_hop(0), next_hop(1), next_hop(2)});
+    }
+
+    const auto check_all_agree = [&] {
+        const auto next_hops = route_flows(*one_at_a_time);
+        test_err_if(route_flows(*one_at_a_time) != next_hops, "flows moved between identical rounds");
+        test_err_if(route_flows(*batched) != next_hops, "batched routing picked different next hops");
+        test_err_if(route_flows(*parallel) != next_hops, "parallel routing picked different next hops");
+        return next_hops;
+    };
+
+    // every next hop gets a fair share of the flows
+    const auto three = check_all_agree();
+    map<int, size_t> shares;
+    for (const int hop : three) {
+        shares[hop]++;
+    }
+    test_err_if(shares.size() != 3 or shares.count(-1) != 0, "flows didn't use exactly the three next hops");
+    for (const auto &[hop, share] : shares) {
+        test_err_if(share <= FLOWS / 4 or share >= FLOWS / 2, "next hop " + to_string(hop) + " got an unfair share");
+    }
+
+    // adding a next hop moves only the flows that now use it
+    for (auto router : {one_at_a_time.get(), batched.get(), parallel.get()}) {
+        router->add_next_hop(0x0a000000, 8, next_hop(5));
+    }
+    const auto four = check_all_agree();
+    size_t moved = 0;
+    for (size_t flow = 0; flow < FLOWS; flow++) {
+        if (four[flow] != three[flow]) {
+            test_err_if(four[flow] != 5, "a flow moved between old next hops");
+            moved++;
+        }
+    }
+    test_err_if(moved <= FLOWS / 8 or moved >= FLOWS / 3, "wrong number of flows moved to the new next hop");
+
+    // removing one moves only the flows that used it, and removing the rest removes the route
+    for (auto router : {one_at_a_time.get(), batched.get(), parallel.get()}) {
+        router->remove_next_hop(0x0a000000, 8, next_hop(1));
+    }
+    const auto without_one = check_all_agree();
+    for (size_t flow = 0; flow < FLOWS; flow++) {
+        test_err_if(without_one[flow] == 1 or (four[flow] != 1 and without_one[flow] != four[flow]), "a flow moved");
+    }
+    for (auto router : {one_at_a_time.get(), batched.get(), parallel.get()}) {
+        router->remove_next_hop(0x0a000000, 8, next_hop(0));
+        router->remove_next_hop(0x0a000000, 8, next_hop(2));
+    }
+    test_err_if(check_all_agree() != vector<int>(FLOWS, 5), "the last next hop didn't get every flow");
+    for (auto router : {one_at_a_time.get(), batched.get(), parallel.get()}) {
+        router->remove_next_hop(0x0a000000, 8, next_hop(5));
+    }
+    test_err_if(check_all_agree() != vector<int>(FLOWS, -1), "the route wasn't removed with its last next hop");
+
+    // a single-path route becomes multipath when it gets a second next hop
+    one_at_a_time->add_route(0x0a000000, 8, next_hop(4).address, next_hop(4).interface_num);
+    one_at_a_time->add_next_hop(0x0a000000, 8, next_hop(6));
+    shares.clear();
+    for (const int hop : route_flows(*one_at_a_time)) {
+        shares[hop]++;
+    }
+    test_err_if(shares.size() != 2 or shares[4] <= FLOWS / 3 or shares[6] <= FLOWS / 3, "flows weren't split in two");
+}
+
+int main() {
+    try {
+        check_resilient_buckets();
+        check_router_multipath();
+    } catch (const exception &e) {
+        cerr << "Exception: " << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,176 @@
+#include "flow_hash.hh"
+#include "mpsc_queue.hh"
+#include "router.hh"
+#include "router_test_harness.hh"
+#include "test_err_if.hh"
+#include "util.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+//! The hashes match the verification suite in Microsoft's RSS specification
+void check_flow_hash() {
+    struct Vector {
+        uint32_t src, dst;
+        uint16_t src_port, dst_port;
+        uint32_t ipv4_hash, tcp_hash;
+    };
+    const vector<Vector> vectors{{0x420995bb, 0xa18e6450, 2794, 1766, 0x323e8fc2, 0x51ccc178},
+                                 {0xc75c6f02, 0x41458c53, 14230, 4739, 0xd718262a, 0xc626b0ea},
+                                 {0x1813c65f, 0x0c16cfb8, 12898, 38024, 0xd2d0a5de, 0x5c2b394a},
+                                 {0x261bcd1e, 0xd18ea306, 48228, 2217, 0x82989176, 0xafc7327f},
+                                 {0x9927a3bf, 0xcabc7f02, 44251, 1303, 0x5d1809c5, 0x10e828a2}};
+
+    const FlowHash hash;
+    for (const auto &v : vectors) {
+        InternetDatagram dgram;
+        dgram.header().src = v.src;
+        dgram.header().dst = v.dst;
+        dgram.header().proto = IPv4Header::PROTO_TCP;
+        dgram.payload() = string{char(v.src_port >> 8), char(v.src_port), char(v.dst_port >> 8), char(v.dst_port)} +
+                          string(16, 'x');
+        test_err_if(hash(dgram) != v.tcp_hash, "wrong TCP hash");
+
+        // a datagram that may be fragmented hashes just its addresses, as do its fragments (which may not have
+        // the ports) and any other protocol
+        dgram.header().df = false;
+        test_err_if(hash(dgram) != v.ipv4_hash, "wrong hash of a datagram that may be fragmented");
+        dgram.header().mf = true;
+        test_err_if(hash(dgram) != v.ipv4_hash, "wrong hash of a first fragment");
+        dgram.header().mf = false;
+        dgram.header().offset = 185;
+        dgram.payload() = string(16, 'x');
+        test_err_if(hash(dgram) != v.ipv4_hash, "wrong hash of a last fragment");
+        dgram.header().offset = 0;
+        dgram.header().df = true;
+        dgram.header().proto = 1;
+        test_err_if(hash(dgram) != v.ipv4_hash, "wrong hash of an ICMP datagram");
+    }
+}
+
+//! Every element pushed by any producer is popped once, in the order its producer pushed them
+void check_mpsc_queue() {
+    MpscQueue<uint64_t> queue(64);
+    constexpr uint64_t PRODUCERS = 3, PER_PRODUCER = 20000;
+
+    vector<thread> producers;
+    for (uint64_t p = 0; p < PRODUCERS; p++) {
+        producers.emplace_back([&queue, p] {
+            for (uint64_t i = 0; i < PER_PRODUCER; i++) {
+                uint64_t value = p << 32 | i;
+                while (not queue.try_push(value)) {
+                    this_thread::yield();
+                }
+            }
+        });
+    }
+
+    vector<uint64_t> next(PRODUCERS, 0);
+    for (uint64_t popped = 0; popped < PRODUCERS * PER_PRODUCER;) {
+        uint64_t value = 0;
+        if (not queue.try_pop(value)) {
+            this_thread::yield();
+            continue;
+        }
+        const uint64_t p = value >> 32;
+        test_err_if(p >= PRODUCERS or (value & 0xffffffff) != next[p]++, "element popped out of order");
+        popped++;
+    }
+    for (auto &producer : producers) {
+        producer.join();
+    }
+
+    uint64_t value = 0;
+    test_err_if(queue.try_pop(value), "extra element popped");
+}
+
+constexpr size_t INTERFACES = 5;
+
+//! A router whose interfaces have learned the Ethernet addresses of next hops 0 through 7
+unique_ptr<Router> make_router(const size_t threads) {
+    auto router = make_test_router(INTERFACES);
+    router->set_threads(threads);
+    for (uint32_t i = 0; i < 16; i++) {
+        const uint32_t hop = i % 8;
+        router->add_route(
+            0x0a000000 | (i << 20), 12, Address::from_ipv4_numeric(router_next_hop_ip(hop)), hop % INTERFACES);
+    }
+    return router;
+}
+
+//! The frames in `frames`, in order, grouped by flow (from the payload)
+map<string, vector<string>> by_flow(const vector<string> &frames) {
+    map<string, vector<string>> flows;
+    for (const auto &frame : frames) {
+        const size_t flow = frame.find("flow ");
+        flows[frame.substr(flow, frame.find(" #", flow) - flow)].push_back(frame);
+    }
+    return flows;
+}
+
+//! Routing on several threads sends the same frames as one thread, in the same order within each flow
+void check_same_flows() {
+    auto rd = get_random_generator();
+    auto one_thread = make_router(1), three_threads = make_router(3);
+    three_threads->set_batch_size(7);
+    three_threads->set_route_cache(64);
+    test_err_if(three_threads->threads() != 3 or three_threads->interface(2).rx_queues() != 3, "threads not set");
+
+    size_t frames_sent = 0;
+    for (unsigned round = 0; round < 10; round++) {
+        for (unsigned i = 0; i < 3000; i++) {
+            const size_t flow = rd() % 50;
+            InternetDatagram dgram;
+            dgram.header().src = 0x01020300 | flow;
+            dgram.header().dst = 0x0a000000 | (flow * 0x51237);  // (some flows unroutable)
+            dgram.header().proto = flow % 3 ? IPv4Header::PROTO_TCP : 17;
+            dgram.header().ttl = rd() % 8 ? 64 : 1;
+            dgram.payload() = string{char(flow), 0, 0, 80} + "flow " + to_string(flow) + " #" + to_string(i) + ";";
+            dgram.header().len = dgram.header().hlen * 4 + dgram.payload().size();
+
+            const size_t in = flow % INTERFACES;
+            one_thread->interface(in).queue_datagram(InternetDatagram{dgram});
+            three_threads->interface(in).queue_datagram(move(dgram));
+        }
+
+        one_thread->route();
+        three_threads->route();
+
+        const auto expected = take_router_frames(*one_thread, INTERFACES),
+                   actual = take_router_frames(*three_threads, INTERFACES);
+        for (size_t i = 0; i < INTERFACES; i++) {
+            test_err_if(actual[i].size() != expected[i].size(), "an interface sent a different number of frames");
+            test_err_if(by_flow(actual[i]) != by_flow(expected[i]), "a flow's frames differed (or were reordered)");
+            frames_sent += expected[i].size();
+        }
+    }
+    test_err_if(frames_sent <= 10000, "too few frames were sent for the comparison to mean anything");
+
+    // back to one thread, every queued datagram still gets routed
+    three_threads->interface(0).queue_datagram(InternetDatagram{});
+    three_threads->set_threads(1);
+    test_err_if(three_threads->interface(0).rx_queues() != 1 or three_threads->interface(0).datagrams_out().size() != 1,
+                "datagram lost when the receive queues changed");
+}
+
+int main() {
+    try {
+        check_flow_hash();
+        check_mpsc_queue();
+        check_same_flows();
+    } catch (const exception &e) {
+        cerr << "Exception: " << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,44 @@
+#include "router_test_harness.hh"
+
+#include "arp_test_harness.hh"
+
+using namespace std;
+
+EthernetAddress router_interface_ethernet_address(const size_t i) {
+    return {0x02, 0, 0, 0, 0, static_cast<uint8_t>(i)};
+}
+
+uint32_t router_interface_ip(const size_t i) { return 0xc0a80100 | i; }
+
+EthernetAddress router_neighbor_ethernet_address(const size_t i) { return test_neighbor_ethernet_address(i); }
+
+uint32_t router_next_hop_ip(const size_t i) { return 0xc0a80000 | i; }
+
+unique_ptr<Router> make_test_router(const size_t interfaces, const size_t resolved) {
+    auto router = make_unique<Router>();
+    for (size_t i = 0; i < interfaces; i++) {
+        router->add_interface(AsyncNetworkInterface{router_interface_ethernet_address(i),
+                                                    Address::from_ipv4_numeric(router_interface_ip(i))});
+    }
+
+    for (size_t i = 0; i < resolved; i++) {
+        router->interface(i % interfaces)
+            .recv_frame(make_arp_reply(router_neighbor_ethernet_address(i),
+                                       router_next_hop_ip(i),
+                                       router_interface_ethernet_address(i % interfaces),
+                                       router_interface_ip(i % interfaces)));
+    }
+    return router;
+}
+
+vector<vector<string>> take_router_frames(Router &router, const size_t interfaces) {
+    vector<vector<string>> frames(interfaces);
+    for (size_t i = 0; i < interfaces; i++) {
+        auto &queue = router.interface(i).frames_out();
+        while (not queue.empty()) {
+            frames[i].push_back(queue.front().serialize().concatenate());
+            queue.pop();
+        }
+    }
+    return frames;
+}
@@ -0,0 +1,31 @@
+#ifndef SPONGE_ROUTER_TEST_HARNESS_HH
+#define SPONGE_ROUTER_TEST_HARNESS_HH
+
+#include "router.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+//! Ethernet address of a test router's interface `i`
+EthernetAddress router_interface_ethernet_address(const size_t i);
+
+//! IP address of a test router's interface `i`
+uint32_t router_interface_ip(const size_t i);
+
+//! Ethernet address of next hop `i`
+EthernetAddress router_neighbor_ethernet_address(const size_t i);
+
+//! IP address of next hop `i`, a neighbour on interface i % (number of interfaces)
+uint32_t router_next_hop_ip(const size_t i);
+
+//! A router with `interfaces` interfaces, which have learned the Ethernet addresses of next hops
+//! 0 through `resolved` - 1 (other next hops never answer ARP)
+std::unique_ptr<Router> make_test_router(const size_t interfaces, const size_t resolved = 8);
+
+//! Everything each of the first `interfaces` interfaces of `router` has sent, serialized (and clear their queues)
+std::vector<std::vector<std::string>> take_router_frames(Router &router, const size_t interfaces);
+
+#endif  // SPONGE_ROUTER_TEST_HARNESS_HH
@@ -0,0 +1,109 @@
+#include "arp_test_harness.hh"
+#include "network_interface.hh"
+#include "test_err_if.hh"
+#include "util.hh"
+
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+//! The frame a datagram to `ethernet_address` should be sent in, built from scratch
+string expected_frame(const InternetDatagram &dgram, const EthernetAddress &ethernet_address) {
+    EthernetFrame frame;
+    frame.header().src = TEST_LOCAL_ETHERNET;
+    frame.header().dst = ethernet_address;
+    frame.header().type = EthernetHeader::TYPE_IPv4;
+    frame.payload() = dgram.serialize();
+    return frame.serialize().concatenate();
+}
+
+//! The frame `interface` sent (and which it no longer holds)
+string take_frame(NetworkInterface &interface) {
+    auto &queue = interface.frames_out();
+    test_err_if(queue.size() != 1, "expected exactly one frame");
+    const string frame = queue.front().serialize().concatenate();
+    queue.pop();
+    return frame;
+}
+
+//! Frames built from the neighbours' cached link headers are byte-for-byte the frames built from scratch
+void check_same_frames() {
+    auto rd = get_random_generator();
+    NetworkInterface interface(TEST_LOCAL_ETHERNET, Address::from_ipv4_numeric(TEST_LOCAL_IP));
+    vector<EthernetAddress> neighbors;
+    for (unsigned i = 0; i < 4; i++) {
+        neighbors.push_back(test_neighbor_ethernet_address(i));
+        interface.recv_frame(make_neighbor_reply(i, neighbors.back()));
+    }
+
+    InternetDatagram dgram;
+    dgram.header().src = 0x01020304;
+    for (unsigned n = 0; n < 2000; n++) {
+        // repeat the last datagram, or change some of its header, or its payload (and length)
+        switch (rd() % 4) {
+            case 0:
+                break;
+            case 1:
+                dgram.header().ttl = rd();
+                break;
+            case 2:
+                dgram.header().id = rd();
+                dgram.header().dst = rd();
+                dgram.header().cksum = rd();  // (ignored: serializing computes it)
+                break;
+            default:
+                dgram.payload() = string(rd() % 100, 'a' + n % 26);
+                break;
+        }
+        dgram.header().len = dgram.header().hlen * 4 + dgram.payload().size();
+
+        const unsigned i = rd() % neighbors.size();
+        interface.send_datagram(dgram, Address::from_ipv4_numeric(test_neighbor_ip(i)));
+        test_err_if(take_frame(interface) != expected_frame(dgram, neighbors[i]), "wrong frame sent");
+
+        // now and then, a neighbour's Ethernet address changes
+        if (rd() % 50 == 0) {
+            neighbors[i][5] ^= 0x80;
+            interface.recv_frame(make_neighbor_reply(i, neighbors[i]));
+        }
+    }
+}
+
+//! Datagrams that waited for ARP are sent in the same frames, and a malformed datagram isn't sent at all
+void check_pending_and_malformed() {
+    NetworkInterface interface(TEST_LOCAL_ETHERNET, Address::from_ipv4_numeric(TEST_LOCAL_IP));
+    InternetDatagram dgram;
+    dgram.payload() = string("waiting");
+    dgram.header().len = dgram.header().hlen * 4 + dgram.payload().size();
+    interface.send_datagram(dgram, Address::from_ipv4_numeric(test_neighbor_ip(0)));
+    interface.frames_out().pop();  // (the ARP request)
+
+    interface.recv_frame(make_neighbor_reply(0));
+    test_err_if(take_frame(interface) != expected_frame(dgram, test_neighbor_ethernet_address(0)),
+                "wrong frame sent after ARP");
+
+    dgram.header().len++;
+    bool threw = false;
+    try {
+        interface.send_datagram(dgram, Address::from_ipv4_numeric(test_neighbor_ip(0)));
+    } catch (const runtime_error &) {
+        threw = true;
+    }
+    test_err_if(not threw or not interface.frames_out().empty(), "a datagram of the wrong length was sent");
+}
+
+int main() {
+    try {
+        check_same_frames();
+        check_pending_and_malformed();
+    } catch (const exception &e) {
+        cerr << "Exception: " << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
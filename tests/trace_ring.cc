@@ -0,0 +1,120 @@
+#include "test_err_if.hh"
+#include "tracepoint.hh"
+#include "util.hh"
+
+#include <atomic>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+//! Is `rec` the record written by record(TraceEvent::FrameTx, n, n, ~n)?
+bool is_record(const TraceRecord &rec, const uint64_t n) {
+    return rec.event == static_cast<uint16_t>(TraceEvent::FrameTx) and rec.arg0 == static_cast<uint32_t>(n) and
+           rec.arg1 == n and rec.arg2 == ~n;
+}
+
+//! A ring holds its newest records, oldest first (once full, all but the one in the slot written next)
+void check_wraparound() {
+    auto ring = make_unique<TraceRing>(7);
+    test_err_if(not ring->snapshot().empty(), "new ring not empty");
+
+    for (uint64_t n = 0; n < 3 * TraceRing::CAPACITY + 100; n++) {
+        ring->record(TraceEvent::FrameTx, n, n, ~n);
+        if (n == 9 or n == TraceRing::CAPACITY - 1 or n == 3 * TraceRing::CAPACITY + 99) {
+            const auto records = ring->snapshot();
+            const uint64_t first = n + 1 < TraceRing::CAPACITY ? 0 : n + 2 - TraceRing::CAPACITY;
+            test_err_if(records.size() != n + 1 - first, "wrong number of records");
+            for (size_t i = 0; i < records.size(); i++) {
+                test_err_if(not is_record(records[i], first + i) or records[i].thread != 7, "wrong record");
+                test_err_if(i > 0 and records[i].timestamp_ns < records[i - 1].timestamp_ns, "records out of order");
+            }
+        }
+    }
+}
+
+//! Snapshots taken while the owning thread writes hold only whole, consecutive records
+void check_concurrent_writer() {
+    auto ring = make_unique<TraceRing>(1);
+    atomic<bool> done{false};
+    thread writer([&] {
+        for (uint64_t n = 0; n < 20 * TraceRing::CAPACITY or not done.load(); n++) {
+            ring->record(TraceEvent::FrameTx, n, n, ~n);
+        }
+    });
+
+    for (unsigned i = 0; i < 2000; i++) {
+        const auto records = ring->snapshot();
+        if (records.empty()) {
+            continue;
+        }
+        const uint64_t first = records.front().arg1;
+        for (size_t j = 0; j < records.size(); j++) {
+            test_err_if(not is_record(records[j], first + j), "snapshot returned an overwritten record");
+        }
+    }
+    done = true;
+    writer.join();
+}
+
+//! trace_collect() merges every thread's ring by time, and trace_dump() writes what trace_load() reads
+void check_collect_and_dump() {
+    TraceRing::local().record(TraceEvent::RouteAdd, 0x0a000000, 8, 3);
+    thread([] { TraceRing::local().record(TraceEvent::ArpMiss, 0x0a000001); }).join();
+    TraceRing::local().record(TraceEvent::SegmentTx, 1000, 536, 0x10);
+
+    const auto records = trace_collect();
+    test_err_if(records.size() != 3, "wrong number of records collected");
+    test_err_if(records[0].event != static_cast<uint16_t>(TraceEvent::RouteAdd) or
+                    records[1].event != static_cast<uint16_t>(TraceEvent::ArpMiss) or
+                    records[2].event != static_cast<uint16_t>(TraceEvent::SegmentTx),
+                "records not merged in time order");
+    test_err_if(records[1].thread == records[0].thread or records[2].thread != records[0].thread,
+                "wrong threads recorded");
+
+    FILE *tmp = tmpfile();
+    FileDescriptor file{SystemCall("dup", ::dup(fileno(tmp)))};
+    fclose(tmp);
+    trace_dump(file);
+    SystemCall("lseek", ::lseek(file.fd_num(), 0, SEEK_SET));
+    string contents;
+    while (not file.eof()) {
+        contents.append(file.read());
+    }
+
+    const auto loaded = trace_load(contents + "partial");
+    test_err_if(loaded.size() != records.size(), "wrong number of records loaded");
+    for (size_t i = 0; i < loaded.size(); i++) {
+        test_err_if(loaded[i].to_string() != records[i].to_string(), "loaded record differs");
+    }
+    const string line = loaded[0].to_string();
+    test_err_if(line.find("RouteAdd") == string::npos or line.find("prefix=10.0.0.0/8 interface=3") == string::npos,
+                "record decoded wrongly: " + line);
+
+    bool threw = false;
+    try {
+        trace_load("not a trace");
+    } catch (const runtime_error &) {
+        threw = true;
+    }
+    test_err_if(not threw, "loaded a file without the magic bytes");
+}
+
+int main() {
+    try {
+        check_wraparound();
+        check_concurrent_writer();
+        check_collect_and_dump();
+    } catch (const exception &e) {
+        cerr << "Exception: " << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,140 @@
+#include "socket.hh"
+#include "test_err_if.hh"
+#include "util.hh"
+
+#include <cerrno>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+string datagram_contents(const unsigned i) { return "datagram number " + to_string(i) + string(i % 50, 'y'); }
+
+//! A pair of UDP sockets bound to loopback, the first connected to the second
+struct SocketPair {
+    UDPSocket sender{}, receiver{};
+
+    SocketPair() {
+        receiver.bind(Address("127.0.0.1", 0));
+        sender.bind(Address("127.0.0.1", 0));
+        sender.connect(receiver.local_address());
+    }
+};
+
+//! Receive exactly `count` datagrams with recv_many
+vector<UDPSocket::received_packet> receive(UDPSocket &socket, const size_t count) {
+    vector<UDPSocket::received_packet> all, batch;
+    while (all.size() < count) {
+        socket.recv_many(batch, 16);
+        for (auto &datagram : batch) {
+            all.push_back(move(datagram));
+        }
+    }
+    return all;
+}
+
+//! Datagrams sent in a batch arrive whole, in order, and from the right address
+void check_batches() {
+    SocketPair sockets;
+
+    constexpr unsigned COUNT = 100;
+    vector<string> contents;
+    vector<BufferList> pieces;
+    for (unsigned i = 0; i < COUNT; i++) {
+        // a payload in several pieces goes out as one datagram
+        contents.push_back(datagram_contents(i));
+        pieces.emplace_back(contents[i].substr(0, 5));
+        pieces.back().append(BufferList(contents[i].substr(5)));
+    }
+    const vector<BufferViewList> payloads(pieces.begin(), pieces.end());
+
+    test_err_if(sockets.sender.send_many(payloads) != COUNT, "send_many didn't send everything");
+    const auto received = receive(sockets.receiver, COUNT);
+    for (unsigned i = 0; i < COUNT; i++) {
+        test_err_if(received[i].payload.str() != contents[i], "recv_many returned the wrong payload");
+        test_err_if(received[i].source_address != sockets.sender.local_address(),
+                    "recv_many returned the wrong source");
+        test_err_if(received[i].segment_size != 0, "recv_many reported coalescing that wasn't asked for");
+    }
+
+    // unconnected sockets work too, and a non-blocking receive with nothing waiting throws EAGAIN
+    UDPSocket unconnected;
+    test_err_if(unconnected.sendto_many(sockets.receiver.local_address(), {contents[0], contents[1]}) != 2,
+                "sendto_many didn't send everything");
+    const auto two = receive(sockets.receiver, 2);
+    test_err_if(two[0].payload.str() != contents[0] or two[1].payload.str() != contents[1], "sendto_many mixed up");
+
+    sockets.receiver.set_blocking(false);
+    vector<UDPSocket::received_packet> none;
+    try {
+        sockets.receiver.recv_many(none);
+        throw runtime_error("recv_many returned with nothing to receive");
+    } catch (const unix_error &e) {
+        test_err_if(e.code().value() != EAGAIN, "recv_many failed the wrong way");
+    }
+
+    // a datagram longer than its buffer comes back cut short and marked, along with the rest of the batch
+    sockets.receiver.set_blocking(true);
+    test_err_if(sockets.sender.send_many({contents[1], contents[COUNT - 1], contents[2]}) != 3,
+                "send_many didn't send everything");
+    test_err_if(sockets.receiver.recv_many(none, 4, contents[2].size()) != 3, "recv_many lost datagrams");
+    test_err_if(none[0].payload.str() != contents[1] or none[0].truncated, "short datagram mangled");
+    test_err_if(none[1].payload.str() != contents[COUNT - 1].substr(0, contents[2].size()) or not none[1].truncated,
+                "recv_many truncated a datagram silently");
+    test_err_if(none[2].payload.str() != contents[2] or none[2].truncated, "datagram after a truncated one mangled");
+}
+
+//! With GSO, one send becomes many datagrams; with GRO too, they may come back as one coalesced payload
+void check_segmentation() {
+    SocketPair sockets;
+    try {
+        sockets.sender.set_gso_segment_size(100);
+        sockets.receiver.set_gro(true);
+    } catch (const unix_error &e) {
+        cerr << "Skipping UDP GSO/GRO check: " << e.what() << "\n";
+        return;
+    }
+
+    string big;
+    for (unsigned i = 0; big.size() < 950; i++) {
+        big += datagram_contents(i);
+    }
+    big.resize(950);
+    sockets.sender.send(big);
+
+    // split whatever arrives back into datagrams
+    vector<string> segments;
+    while (segments.size() < 10) {
+        for (const auto &datagram : receive(sockets.receiver, 1)) {
+            const string payload{datagram.payload.str()};
+            const size_t size = datagram.segment_size ? datagram.segment_size : payload.size();
+            for (size_t offset = 0; offset < payload.size(); offset += size) {
+                segments.push_back(payload.substr(offset, size));
+            }
+        }
+    }
+
+    test_err_if(segments.size() != 10, "GSO made the wrong number of datagrams");
+    for (unsigned i = 0; i < 10; i++) {
+        test_err_if(segments[i] != big.substr(100 * i, 100), "GSO or GRO garbled a datagram");
+    }
+
+    sockets.sender.set_gso_segment_size(0);
+    sockets.sender.send(big);
+    const auto whole = receive(sockets.receiver, 1);
+    test_err_if(whole[0].payload.str() != big or whole[0].segment_size != 0, "GSO wasn't turned off");
+}
+
+int main() {
+    try {
+        check_batches();
+        check_segmentation();
+    } catch (const exception &e) {
+        cerr << "Exception: " << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}